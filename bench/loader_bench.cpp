@@ -0,0 +1,341 @@
+#include"renderer.h"
+#include"vkglTF.h"
+#include"stb_image_write.h"
+
+#include<iostream>
+#include<fstream>
+#include<filesystem>
+#include<random>
+#include<string>
+#include<iomanip>
+#include<cstring>
+#include<cstdlib>
+#include<algorithm>
+#ifdef _WIN32
+#include<windows.h>
+#include<psapi.h>
+#else
+#include<sys/resource.h>
+#include<unistd.h>
+#endif
+
+//generates a synthetic glTF of the requested shape,loads it into a device-only Renderer several times
+//and prints the per-stage LoadStats as JSON.
+//peak RSS covers the whole process,so it is only reported when the glTF comes from --in:
+//loader_bench --out dir --generate-only,then loader_bench --in dir/bench.gltf
+//runs without a display,e.g. on lavapipe:VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+using namespace vkglTF;
+
+#define CHILDREN_PER_NODE 8
+
+struct BenchOptions{
+    uint32_t nodes = 4096;
+    uint32_t meshes = 256;
+    uint32_t primitives = 2;
+    uint32_t vertices = 1024;
+    uint32_t materials = 16;
+    uint32_t textures = 8;
+    uint32_t textureSize = 512;
+    uint32_t iterations = 5;
+    std::string out;
+    //load this file instead of generating one
+    std::string in;
+    bool generateOnly = false;
+};
+
+static void printUsage()
+{
+    std::cerr<<"usage:loader_bench [--nodes N] [--meshes N] [--primitives N per mesh] [--vertices N per primitive]\n"
+    <<"                    [--materials N] [--textures N] [--texture-size N] [--iterations N] [--out dir] [--generate-only]\n"
+    <<"       loader_bench --in file.gltf [--iterations N]\n";
+}
+
+static bool parseOptions(int argc,char* argv[],BenchOptions& options)
+{
+    for(int i=1;i<argc;++i){
+        std::string arg = argv[i];
+        if(arg=="--out"&&i+1<argc){
+            options.out = argv[++i];
+            continue;
+        }
+        if(arg=="--in"&&i+1<argc){
+            options.in = argv[++i];
+            continue;
+        }
+        if(arg=="--generate-only"){
+            options.generateOnly = true;
+            continue;
+        }
+        uint32_t* value = nullptr;
+        if(arg=="--nodes") value = &options.nodes;
+        else if(arg=="--meshes") value = &options.meshes;
+        else if(arg=="--primitives") value = &options.primitives;
+        else if(arg=="--vertices") value = &options.vertices;
+        else if(arg=="--materials") value = &options.materials;
+        else if(arg=="--textures") value = &options.textures;
+        else if(arg=="--texture-size") value = &options.textureSize;
+        else if(arg=="--iterations") value = &options.iterations;
+        if(!value||i+1>=argc){
+            return false;
+        }
+        *value = (uint32_t)std::strtoul(argv[++i],nullptr,10);
+    }
+    //Scene has room for 128 materials,a primitive needs at least one triangle
+    options.materials = std::clamp(options.materials,1u,128u);
+    options.meshes = std::clamp(options.meshes,1u,std::max(options.nodes,1u));
+    options.vertices = std::max(options.vertices,3u);
+    options.primitives = std::max(options.primitives,1u);
+    options.iterations = std::max(options.iterations,1u);
+    if(options.generateOnly&&(options.out.empty()||!options.in.empty())){
+        return false;
+    }
+    return options.nodes>0;
+}
+
+//every primitive has its own positions,normals,uvs and a triangle strip as uint32 indices in one .bin.
+//node i is a child of node (i-1)/CHILDREN_PER_NODE and uses mesh i%meshes,textures are png noise.
+static std::filesystem::path writeglTF(const BenchOptions& options,const std::filesystem::path& dir)
+{
+    std::filesystem::create_directories(dir);
+    const uint32_t primitiveCount = options.meshes*options.primitives;
+    const uint32_t indexCount = (options.vertices-2)*3;
+    const size_t positionBytes = (size_t)options.vertices*12;
+    const size_t uvBytes = (size_t)options.vertices*8;
+    const size_t indexBytes = (size_t)indexCount*4;
+    const size_t primitiveBytes = positionBytes*2+uvBytes+indexBytes;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-1.0f,1.0f);
+    {
+        std::ofstream bin(dir/"bench.bin",std::ios::binary);
+        std::vector<char> data(primitiveBytes);
+        for(uint32_t p=0;p<primitiveCount;++p){
+            float* positions = (float*)data.data();
+            float* normals = (float*)(data.data()+positionBytes);
+            float* uvs = (float*)(data.data()+positionBytes*2);
+            uint32_t* indices = (uint32_t*)(data.data()+positionBytes*2+uvBytes);
+            for(uint32_t v=0;v<options.vertices;++v){
+                positions[v*3] = (float)(v/2);
+                positions[v*3+1] = (float)(v%2);
+                positions[v*3+2] = dist(rng)*0.1f;
+                normals[v*3] = 0.0f;
+                normals[v*3+1] = 0.0f;
+                normals[v*3+2] = 1.0f;
+                uvs[v*2] = (float)(v/2)/options.vertices;
+                uvs[v*2+1] = (float)(v%2);
+            }
+            for(uint32_t t=0;t<options.vertices-2;++t){
+                indices[t*3] = t;
+                indices[t*3+1] = t+1;
+                indices[t*3+2] = t+2;
+            }
+            bin.write(data.data(),data.size());
+        }
+    }
+    std::vector<unsigned char> pixels((size_t)options.textureSize*options.textureSize*4);
+    std::uniform_int_distribution<int> byteDist(0,255);
+    for(uint32_t t=0;t<options.textures;++t){
+        for(auto& pixel:pixels){
+            pixel = (unsigned char)byteDist(rng);
+        }
+        std::string name = (dir/("texture"+std::to_string(t)+".png")).string();
+        if(!stbi_write_png(name.c_str(),options.textureSize,options.textureSize,4,pixels.data(),options.textureSize*4)){
+            throw std::runtime_error("failed to write "+name);
+        }
+    }
+
+    std::string json;
+    json += "{\"asset\":{\"version\":\"2.0\",\"generator\":\"loader_bench\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[";
+    for(uint32_t i=0;i<options.nodes;++i){
+        json += i?",":"";
+        json += "{\"mesh\":"+std::to_string(i%options.meshes)+",\"translation\":[1,0,0]";
+        uint32_t firstChild = i*CHILDREN_PER_NODE+1;
+        if(firstChild<options.nodes){
+            json += ",\"children\":[";
+            for(uint32_t c=firstChild;c<firstChild+CHILDREN_PER_NODE&&c<options.nodes;++c){
+                json += (c>firstChild?",":"")+std::to_string(c);
+            }
+            json += "]";
+        }
+        json += "}";
+    }
+    //accessors 4p..4p+3 and bufferViews 4p..4p+3 belong to primitive p
+    json += "],\"meshes\":[";
+    for(uint32_t m=0;m<options.meshes;++m){
+        json += m?",":"";
+        json += "{\"primitives\":[";
+        for(uint32_t p=0;p<options.primitives;++p){
+            uint32_t a = (m*options.primitives+p)*4;
+            json += p?",":"";
+            json += "{\"attributes\":{\"POSITION\":"+std::to_string(a)+",\"NORMAL\":"+std::to_string(a+1)
+            +",\"TEXCOORD_0\":"+std::to_string(a+2)+"},\"indices\":"+std::to_string(a+3)
+            +",\"material\":"+std::to_string((m*options.primitives+p)%options.materials)+"}";
+        }
+        json += "]}";
+    }
+    json += "],\"accessors\":[";
+    std::string vertexCount = std::to_string(options.vertices);
+    std::string maxX = std::to_string(options.vertices/2);
+    for(uint32_t p=0;p<primitiveCount;++p){
+        json += p?",":"";
+        json += "{\"bufferView\":"+std::to_string(p*4)+",\"componentType\":5126,\"count\":"+vertexCount
+        +",\"type\":\"VEC3\",\"min\":[0,0,-0.1],\"max\":["+maxX+",1,0.1]},";
+        json += "{\"bufferView\":"+std::to_string(p*4+1)+",\"componentType\":5126,\"count\":"+vertexCount+",\"type\":\"VEC3\"},";
+        json += "{\"bufferView\":"+std::to_string(p*4+2)+",\"componentType\":5126,\"count\":"+vertexCount+",\"type\":\"VEC2\"},";
+        json += "{\"bufferView\":"+std::to_string(p*4+3)+",\"componentType\":5125,\"count\":"+std::to_string(indexCount)+",\"type\":\"SCALAR\"}";
+    }
+    json += "],\"bufferViews\":[";
+    for(uint32_t p=0;p<primitiveCount;++p){
+        size_t offset = p*primitiveBytes;
+        json += p?",":"";
+        json += "{\"buffer\":0,\"byteOffset\":"+std::to_string(offset)+",\"byteLength\":"+std::to_string(positionBytes)+"},";
+        json += "{\"buffer\":0,\"byteOffset\":"+std::to_string(offset+positionBytes)+",\"byteLength\":"+std::to_string(positionBytes)+"},";
+        json += "{\"buffer\":0,\"byteOffset\":"+std::to_string(offset+positionBytes*2)+",\"byteLength\":"+std::to_string(uvBytes)+"},";
+        json += "{\"buffer\":0,\"byteOffset\":"+std::to_string(offset+positionBytes*2+uvBytes)+",\"byteLength\":"+std::to_string(indexBytes)+"}";
+    }
+    json += "],\"materials\":[";
+    for(uint32_t m=0;m<options.materials;++m){
+        json += m?",":"";
+        json += "{\"pbrMetallicRoughness\":{\"baseColorFactor\":[1,1,1,1],\"metallicFactor\":0.5";
+        if(options.textures){
+            json += ",\"baseColorTexture\":{\"index\":"+std::to_string(m%options.textures)+"}";
+        }
+        json += "}}";
+    }
+    json += "]";
+    if(options.textures){
+        json += ",\"samplers\":[{\"magFilter\":9729,\"minFilter\":9987}],\"images\":[";
+        for(uint32_t t=0;t<options.textures;++t){
+            json += t?",":"";
+            json += "{\"uri\":\"texture"+std::to_string(t)+".png\"}";
+        }
+        json += "],\"textures\":[";
+        for(uint32_t t=0;t<options.textures;++t){
+            json += t?",":"";
+            json += "{\"sampler\":0,\"source\":"+std::to_string(t)+"}";
+        }
+        json += "]";
+    }
+    json += ",\"buffers\":[{\"byteLength\":"+std::to_string(primitiveBytes*primitiveCount)+",\"uri\":\"bench.bin\"}]}";
+    std::ofstream(dir/"bench.gltf",std::ios::binary)<<json;
+    return dir/"bench.gltf";
+}
+
+static double peakRSSMB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(),&counters,sizeof(counters));
+    return counters.PeakWorkingSetSize/(1024.0*1024.0);
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF,&usage);
+    return usage.ru_maxrss/1024.0;
+#endif
+}
+
+static double currentRSSMB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(),&counters,sizeof(counters));
+    return counters.WorkingSetSize/(1024.0*1024.0);
+#else
+    long pages = 0;
+    long resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm>>pages>>resident;
+    return resident*(double)sysconf(_SC_PAGESIZE)/(1024.0*1024.0);
+#endif
+}
+
+//MB per second of bytes moved in ms
+static double throughput(size_t bytes,double ms)
+{
+    return ms>0?bytes/(1024.0*1024.0)/(ms/1000.0):0.0;
+}
+
+int main(int argc,char* argv[])
+{
+    BenchOptions options;
+    if(!parseOptions(argc,argv,options)){
+        printUsage();
+        return 1;
+    }
+    std::filesystem::path path = options.in;
+    bool generated = options.in.empty();
+    if(generated){
+        std::filesystem::path dir = options.out.empty()?std::filesystem::temp_directory_path()/"loader_bench":std::filesystem::path(options.out);
+        try{
+            path = writeglTF(options,dir);
+        }
+        catch(std::exception& e){
+            std::cerr<<e.what()<<'\n';
+            return 1;
+        }
+        if(options.generateOnly){
+            std::cout<<path.string()<<'\n';
+            return 0;
+        }
+    }
+
+    LoadStats sum;
+    double rssBeforeLoad = 0;
+    double rssAfterLoad = 0;
+    size_t nodeCount = 0;
+    try{
+        Renderer renderer(RendererMode::eDeviceOnly);
+        rssBeforeLoad = currentRSSMB();
+        for(uint32_t it=0;it<options.iterations;++it){
+            Scene scene(&renderer);
+            scene.loadFile(path.string().c_str());
+            const LoadStats& stats = scene.loadStats;
+            sum.parse += stats.parse;
+            sum.buffers += stats.buffers;
+            sum.imageDecode += stats.imageDecode;
+            sum.textures += stats.textures;
+            sum.materials += stats.materials;
+            sum.nodes += stats.nodes;
+            sum.animations += stats.animations;
+            sum.bufferUploads += stats.bufferUploads;
+            sum.total += stats.total;
+            sum.jsonBytes = stats.jsonBytes;
+            sum.bufferBytes = stats.bufferBytes;
+            sum.imageBytes = stats.imageBytes;
+            sum.uploadBytes = stats.uploadBytes;
+            rssAfterLoad = currentRSSMB();
+            nodeCount = scene.transforms.size();
+        }
+    }
+    catch(std::exception& e){
+        std::cerr<<e.what()<<'\n';
+        return 1;
+    }
+    double n = options.iterations;
+    std::cout<<"{\n";
+    if(generated){
+        std::cout<<"  \"scene\":{\"nodes\":"<<options.nodes<<",\"meshes\":"<<options.meshes<<",\"primitivesPerMesh\":"<<options.primitives
+        <<",\"verticesPerPrimitive\":"<<options.vertices<<",\"materials\":"<<options.materials<<",\"textures\":"<<options.textures
+        <<",\"textureSize\":"<<options.textureSize<<"},\n";
+    }
+    else{
+        std::cout<<"  \"scene\":{\"path\":"<<std::quoted(path.generic_string())<<"},\n";
+    }
+    std::cout
+    <<"  \"iterations\":"<<options.iterations<<",\n"
+    <<"  \"bytes\":{\"json\":"<<sum.jsonBytes<<",\"buffers\":"<<sum.bufferBytes<<",\"images\":"<<sum.imageBytes<<",\"uploads\":"<<sum.uploadBytes<<"},\n"
+    <<"  \"ms\":{\"parse\":"<<sum.parse/n<<",\"buffers\":"<<sum.buffers/n<<",\"imageDecode\":"<<sum.imageDecode/n
+    <<",\"textures\":"<<sum.textures/n<<",\"materials\":"<<sum.materials/n<<",\"nodes\":"<<sum.nodes/n
+    <<",\"animations\":"<<sum.animations/n<<",\"bufferUploads\":"<<sum.bufferUploads/n<<",\"total\":"<<sum.total/n<<"},\n"
+    <<"  \"throughput\":{\"parseMBps\":"<<throughput(sum.jsonBytes,sum.parse/n)<<",\"buffersMBps\":"<<throughput(sum.bufferBytes,sum.buffers/n)
+    <<",\"imageDecodeMBps\":"<<throughput(sum.imageBytes,sum.imageDecode/n)<<",\"uploadMBps\":"<<throughput(sum.uploadBytes,sum.bufferUploads/n)
+    <<",\"nodesPerSecond\":"<<(sum.nodes>0?nodeCount/(sum.nodes/n/1000.0):0.0)<<"},\n"
+    <<"  \"memoryMB\":{";
+    //the generator's strings and pixels would dominate the peak
+    if(!generated){
+        std::cout<<"\"peakRSS\":"<<peakRSSMB()<<",";
+    }
+    std::cout<<"\"rssBeforeLoad\":"<<rssBeforeLoad<<",\"rssAfterLoad\":"<<rssAfterLoad<<"}\n"
+    <<"}\n";
+    return 0;
+}
@@ -0,0 +1,180 @@
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include"gltfparser.h"
+
+#include<iostream>
+#include<chrono>
+#include<cstdlib>
+#include<cstdint>
+#include<algorithm>
+#include<new>
+#include<string>
+
+//parses synthetic glTFs with large JSON,once with tinygltf's DOM loader and once with the SAX parser Scene uses.
+//peak heap is counted by the replaced operator new,on top of the JSON text itself.
+using namespace vkglTF;
+
+static size_t liveBytes = 0;
+static size_t peakBytes = 0;
+
+//kept in front of every block so delete can account for it.
+//delete goes through the header's pointer back to malloc's block,
+//and finds the header with integer arithmetic,so the compiler doesn't see free or a negative index on what new returned
+struct BlockHeader{
+    void* block;
+    size_t size;
+};
+static void* allocate(size_t size,size_t alignment)
+{
+    //the header fills the space up to the next aligned address
+    size_t align = std::max(alignment,(size_t)16);
+    void* block = std::malloc(size+sizeof(BlockHeader)+align);
+    if(!block){
+        throw std::bad_alloc();
+    }
+    uintptr_t p = ((uintptr_t)block+sizeof(BlockHeader)+align-1)&~(uintptr_t)(align-1);
+    BlockHeader* header = (BlockHeader*)(p-sizeof(BlockHeader));
+    header->block = block;
+    header->size = size;
+    liveBytes += size;
+    peakBytes = std::max(peakBytes,liveBytes);
+    return (void*)p;
+}
+static void deallocate(void* p)
+{
+    if(p){
+        BlockHeader* header = (BlockHeader*)((uintptr_t)p-sizeof(BlockHeader));
+        liveBytes -= header->size;
+        std::free(header->block);
+    }
+}
+void* operator new(size_t size)
+{
+    return allocate(size,16);
+}
+void* operator new(size_t size,std::align_val_t alignment)
+{
+    return allocate(size,(size_t)alignment);
+}
+void operator delete(void* p) noexcept
+{
+    deallocate(p);
+}
+void operator delete(void* p,size_t) noexcept
+{
+    deallocate(p);
+}
+void operator delete(void* p,std::align_val_t) noexcept
+{
+    deallocate(p);
+}
+void operator delete(void* p,size_t,std::align_val_t) noexcept
+{
+    deallocate(p);
+}
+
+//every node has its own mesh with one indexed primitive,accessors point into a single 16 byte buffer
+static std::string makeglTF(uint32_t nodeCount)
+{
+    std::string json;
+    json.reserve((size_t)nodeCount*700);
+    json += "{\"asset\":{\"version\":\"2.0\",\"generator\":\"parse_bench\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[";
+    for(uint32_t i=0;i<nodeCount;++i){
+        json += i?",":"";
+        json += "{\"name\":\"node"+std::to_string(i)+"\",\"mesh\":"+std::to_string(i);
+        json += ",\"translation\":[1.5,-2.25,0.125],\"rotation\":[0.0,0.0,0.0,1.0],\"scale\":[1.0,1.0,1.0]";
+        uint32_t firstChild = i*8+1;
+        if(firstChild<nodeCount){
+            json += ",\"children\":[";
+            for(uint32_t c=firstChild;c<firstChild+8&&c<nodeCount;++c){
+                json += (c>firstChild?",":"")+std::to_string(c);
+            }
+            json += "]";
+        }
+        json += ",\"extras\":{\"id\":"+std::to_string(i)+",\"tags\":[\"a\",\"b\"]}}";
+    }
+    json += "],\"meshes\":[";
+    for(uint32_t i=0;i<nodeCount;++i){
+        json += i?",":"";
+        json += "{\"primitives\":[{\"attributes\":{\"POSITION\":"+std::to_string(2*i)+"},\"indices\":"+std::to_string(2*i+1)
+        +",\"material\":"+std::to_string(i%16)+"}]}";
+    }
+    json += "],\"accessors\":[";
+    for(uint32_t i=0;i<nodeCount;++i){
+        json += i?",":"";
+        json += "{\"bufferView\":0,\"componentType\":5126,\"count\":1,\"type\":\"VEC3\",\"min\":[0,0,0],\"max\":[0,0,0]},";
+        json += "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5123,\"count\":1,\"type\":\"SCALAR\"}";
+    }
+    json += "],\"materials\":[";
+    for(uint32_t i=0;i<16;++i){
+        json += i?",":"";
+        json += "{\"pbrMetallicRoughness\":{\"baseColorFactor\":[1,0.5,0.25,1],\"metallicFactor\":0.5},\"doubleSided\":true}";
+    }
+    json += "],\"bufferViews\":[{\"buffer\":0,\"byteLength\":16}],";
+    json += "\"buffers\":[{\"byteLength\":16,\"uri\":\"data:application/octet-stream;base64,AAAAAAAAAAAAAAAAAAAAAA==\"}]}";
+    return json;
+}
+
+static double elapsed(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double,std::milli>(std::chrono::high_resolution_clock::now()-start).count();
+}
+
+template<class Model>
+static uint64_t checksum(Model& model)
+{
+    uint64_t sum = model.nodes.size()+model.meshes.size()+model.accessors.size();
+    for(auto& node:model.nodes){
+        sum += node.children.size()+node.mesh;
+    }
+    for(auto& accessor:model.accessors){
+        sum += accessor.type+accessor.componentType+accessor.byteOffset;
+    }
+    return sum;
+}
+
+int main()
+{
+    uint32_t nodeCounts[] = {10000,100000,300000};
+    for(uint32_t nodeCount:nodeCounts){
+        std::string json = makeglTF(nodeCount);
+        std::cout<<"nodes:"<<nodeCount<<" json:"<<json.size()/(1024.0*1024.0)<<"MB\n";
+        double times[2];
+        size_t peaks[2];
+        uint64_t sums[2];
+        {
+            size_t base = liveBytes;
+            peakBytes = liveBytes;
+            auto start = std::chrono::high_resolution_clock::now();
+            tinygltf::Model model;
+            tinygltf::TinyGLTF loader;
+            std::string err;
+            std::string warn;
+            if(!loader.LoadASCIIFromString(&model,&err,&warn,json.data(),json.size(),"")){
+                std::cerr<<"tinygltf failed:"<<err<<'\n';
+                return 1;
+            }
+            times[0] = elapsed(start);
+            peaks[0] = peakBytes-base;
+            sums[0] = checksum(model);
+        }
+        {
+            size_t base = liveBytes;
+            peakBytes = liveBytes;
+            auto start = std::chrono::high_resolution_clock::now();
+            glTF::Model model;
+            parseglTFJson(json.data(),json.size(),model);
+            times[1] = elapsed(start);
+            peaks[1] = peakBytes-base;
+            sums[1] = checksum(model);
+        }
+        if(sums[0]!=sums[1]){
+            std::cerr<<"models differ!\n";
+            return 1;
+        }
+        std::cout<<"  tinygltf: "<<times[0]<<"ms,peak "<<peaks[0]/(1024.0*1024.0)<<"MB\n";
+        std::cout<<"  sax:      "<<times[1]<<"ms,peak "<<peaks[1]/(1024.0*1024.0)<<"MB\n";
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include"vkglTF.h"
+#include"arena.h"
+
+#include<iostream>
+#include<chrono>
+
+//builds,traverses and unloads a synthetic scene graph of 1M primitives,
+//once with the arena layout Scene uses and once with individually allocated objects.
+using namespace vkglTF;
+
+#define PRIMITIVES_PER_MESH 4
+#define CHILDREN_PER_NODE 8
+
+//the layout Scene used before the arena:every object is its own allocation
+struct HeapMesh{
+    std::vector<Primitive*> primitives;
+    ~HeapMesh(){
+        for(Primitive* primitive:primitives){
+            delete primitive;
+        }
+    }
+};
+struct HeapNode{
+    HeapNode* parent = nullptr;
+    std::vector<HeapNode*> children;
+    HeapMesh* mesh = nullptr;
+    ~HeapNode(){
+        delete mesh;
+        for(HeapNode* child:children){
+            delete child;
+        }
+    }
+};
+
+struct ArenaScene{
+    Arena arena;
+    ArenaArray<Node> nodes;
+    ArenaArray<uint32_t> nodeChildren;
+    Pool<Mesh> meshes;
+    ArenaArray<Primitive> primitives;
+};
+
+static double elapsed(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double,std::milli>(std::chrono::high_resolution_clock::now()-start).count();
+}
+
+static void fillPrimitive(Primitive& primitive,uint32_t index)
+{
+    primitive.indexStart = index*36;
+    primitive.indexCount = 36;
+    primitive.useIndex = true;
+    primitive.material = {index%16,0};
+}
+
+//node i has the parent (i-1)/CHILDREN_PER_NODE,so children of a node are consecutive
+static HeapNode* buildHeap(uint32_t nodeCount)
+{
+    std::vector<HeapNode*> all(nodeCount);
+    uint32_t primitiveIndex = 0;
+    for(uint32_t i=0;i<nodeCount;++i){
+        HeapNode* node = new HeapNode();
+        node->mesh = new HeapMesh();
+        for(int p=0;p<PRIMITIVES_PER_MESH;++p){
+            Primitive* primitive = new Primitive();
+            fillPrimitive(*primitive,primitiveIndex++);
+            node->mesh->primitives.push_back(primitive);
+        }
+        if(i>0){
+            node->parent = all[(i-1)/CHILDREN_PER_NODE];
+            node->parent->children.push_back(node);
+        }
+        all[i] = node;
+    }
+    return all[0];
+}
+
+static void buildArena(ArenaScene& scene,uint32_t nodeCount)
+{
+    scene.nodes.allocate(scene.arena,nodeCount);
+    scene.nodeChildren.reserve(scene.arena,nodeCount-1);
+    scene.meshes.reserve(nodeCount);
+    scene.primitives.reserve(scene.arena,nodeCount*PRIMITIVES_PER_MESH);
+    for(uint32_t i=0;i<nodeCount;++i){
+        Node& node = scene.nodes[i];
+        node.parent = i>0?(int)((i-1)/CHILDREN_PER_NODE):-1;
+        node.mesh = scene.meshes.create();
+        Mesh& mesh = *scene.meshes.get(node.mesh);
+        mesh.node = i;
+        mesh.firstPrimitive = scene.primitives.size();
+        mesh.primitiveCount = PRIMITIVES_PER_MESH;
+        for(int p=0;p<PRIMITIVES_PER_MESH;++p){
+            fillPrimitive(scene.primitives.push(),mesh.firstPrimitive+p);
+        }
+        uint32_t firstChild = i*CHILDREN_PER_NODE+1;
+        uint32_t lastChild = std::min(firstChild+CHILDREN_PER_NODE,nodeCount);
+        node.firstChild = scene.nodeChildren.size();
+        node.childCount = firstChild<lastChild?lastChild-firstChild:0;
+        for(uint32_t child=firstChild;child<lastChild;++child){
+            scene.nodeChildren.push() = child;
+        }
+    }
+}
+
+static uint64_t traverseHeap(HeapNode* node)
+{
+    uint64_t indexCount = 0;
+    for(Primitive* primitive:node->mesh->primitives){
+        indexCount += primitive->indexCount;
+    }
+    for(HeapNode* child:node->children){
+        indexCount += traverseHeap(child);
+    }
+    return indexCount;
+}
+
+static uint64_t traverseArena(ArenaScene& scene,uint32_t node)
+{
+    uint64_t indexCount = 0;
+    Mesh& mesh = *scene.meshes.get(scene.nodes[node].mesh);
+    for(uint32_t p=0;p<mesh.primitiveCount;++p){
+        indexCount += scene.primitives[mesh.firstPrimitive+p].indexCount;
+    }
+    for(uint32_t c=0;c<scene.nodes[node].childCount;++c){
+        indexCount += traverseArena(scene,scene.nodeChildren[scene.nodes[node].firstChild+c]);
+    }
+    return indexCount;
+}
+
+int main()
+{
+    const uint32_t primitiveCount = 1000000;
+    const uint32_t nodeCount = primitiveCount/PRIMITIVES_PER_MESH;
+    const int iterations = 5;
+    double heapTimes[3] = {};
+    double arenaTimes[3] = {};
+    uint64_t checksum = 0;
+    ArenaScene arenaScene;
+    for(int it=0;it<iterations;++it){
+        auto start = std::chrono::high_resolution_clock::now();
+        HeapNode* root = buildHeap(nodeCount);
+        heapTimes[0] += elapsed(start);
+        start = std::chrono::high_resolution_clock::now();
+        checksum += traverseHeap(root);
+        heapTimes[1] += elapsed(start);
+        start = std::chrono::high_resolution_clock::now();
+        delete root;
+        heapTimes[2] += elapsed(start);
+
+        //the arena is reused across iterations like a scene reloaded in the viewer
+        start = std::chrono::high_resolution_clock::now();
+        buildArena(arenaScene,nodeCount);
+        arenaTimes[0] += elapsed(start);
+        start = std::chrono::high_resolution_clock::now();
+        checksum += traverseArena(arenaScene,0);
+        arenaTimes[1] += elapsed(start);
+        start = std::chrono::high_resolution_clock::now();
+        arenaScene.nodes.clear();
+        arenaScene.nodeChildren.clear();
+        arenaScene.meshes.clear();
+        arenaScene.primitives.clear();
+        arenaScene.arena.reset();
+        arenaTimes[2] += elapsed(start);
+    }
+    const char* phases[3] = {"load","traverse","unload"};
+    std::cout<<"primitives:"<<primitiveCount<<" nodes:"<<nodeCount<<" checksum:"<<checksum<<'\n';
+    for(int i=0;i<3;++i){
+        std::cout<<"  "<<phases[i]<<": new/delete "<<heapTimes[i]/iterations<<"ms,arena "<<arenaTimes[i]/iterations<<"ms\n";
+    }
+    std::cout<<"  arena reserved:"<<arenaScene.arena.getReservedBytes()/(1024.0*1024.0)<<"MB\n";
+    return 0;
+}
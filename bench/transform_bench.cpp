@@ -0,0 +1,68 @@
+#include"transform.h"
+#include"threadpool.h"
+
+#include<iostream>
+#include<chrono>
+#include<random>
+
+//builds a synthetic 4-ary hierarchy and reports nodes/ms for a full update
+//and for an animated frame where a tenth of the nodes changed.
+using namespace vkglTF;
+
+static void buildHierarchy(TransformHierarchy& hierarchy,uint32_t nodeCount)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-1.0f,1.0f);
+    hierarchy.clear();
+    for(uint32_t i=0;i<nodeCount;++i){
+        int parent = i==0?-1:(int)((i-1)/4);
+        glm::quat rotation = glm::normalize(glm::quat(1.0f+dist(rng),dist(rng),dist(rng),dist(rng)));
+        hierarchy.addNode(parent,glm::vec3(dist(rng),dist(rng),dist(rng)),rotation,glm::vec3(1.0f+0.1f*dist(rng)));
+    }
+    hierarchy.finalize();
+}
+
+static double timeUpdates(TransformHierarchy& hierarchy,ThreadPool* pool,float dirtyRatio,int iterations)
+{
+    std::mt19937 rng(4321);
+    std::uniform_real_distribution<float> dist(0.0f,1.0f);
+    std::vector<uint32_t> dirtyNodes;
+    for(uint32_t i=0;i<hierarchy.size();++i){
+        if(dist(rng)<dirtyRatio){
+            dirtyNodes.push_back(i);
+        }
+    }
+    double total = 0;
+    for(int it=0;it<iterations;++it){
+        for(uint32_t node:dirtyNodes){
+            hierarchy.setTranslation(node,hierarchy.translations[node]);
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        hierarchy.update(pool);
+        auto end = std::chrono::high_resolution_clock::now();
+        total += std::chrono::duration<double,std::milli>(end-start).count();
+    }
+    return total/iterations;
+}
+
+int main()
+{
+    uint32_t nodeCounts[] = {10000,100000,1000000};
+    ThreadPool pool;
+    TransformHierarchy hierarchy;
+    std::cout<<"threads:"<<pool.getThreadCount()<<'\n';
+    for(uint32_t nodeCount:nodeCounts){
+        buildHierarchy(hierarchy,nodeCount);
+        int iterations = nodeCount>=1000000?10:100;
+        //warm up caches and the workers
+        hierarchy.update(&pool);
+        double fullSingle = timeUpdates(hierarchy,nullptr,1.0f,iterations);
+        double fullPool = timeUpdates(hierarchy,&pool,1.0f,iterations);
+        double partialPool = timeUpdates(hierarchy,&pool,0.1f,iterations);
+        std::cout<<"nodes:"<<nodeCount<<" levels:"<<hierarchy.levelCount()<<'\n';
+        std::cout<<"  full update,1 thread:   "<<fullSingle<<"ms "<<nodeCount/fullSingle<<" nodes/ms\n";
+        std::cout<<"  full update,"<<pool.getThreadCount()<<" threads:  "<<fullPool<<"ms "<<nodeCount/fullPool<<" nodes/ms\n";
+        std::cout<<"  10% animated,"<<pool.getThreadCount()<<" threads: "<<partialPool<<"ms "<<nodeCount/partialPool<<" nodes/ms\n";
+    }
+    return 0;
+}
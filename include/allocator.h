@@ -0,0 +1,112 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+#include"vulkan/vulkan.hpp"
+
+#include<vector>
+#include<set>
+#include<mutex>
+#include<cstdint>
+
+//smallest buddy size class
+#define GPU_MIN_ALLOCATION_SIZE 256
+//size of the vkDeviceMemory blocks pools sub-allocate from
+#define GPU_BLOCK_SIZE (64ull<<20)
+//images at least this large always get their own vkDeviceMemory
+#define GPU_DEDICATED_IMAGE_SIZE (16ull<<20)
+
+enum class AllocationStrategy:uint8_t{
+    //long lived resources,rounded up to power of two size classes inside shared blocks
+    eBuddy,
+    //short lived resources like staging buffers,bump allocated and recycled once their block empties
+    eLinear,
+    //a vkDeviceMemory of its own
+    eDedicated,
+};
+//a range of device memory handed out by GpuAllocator
+struct GpuAllocation{
+    vk::DeviceMemory memory;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
+    //host visible memory stays mapped while allocated,mapped already points at offset
+    void* mapped = nullptr;
+    //owner inside the allocator,pool is -1 for dedicated allocations
+    int pool = -1;
+    int block = -1;
+    uint32_t order = 0;
+};
+struct GpuPoolStats{
+    uint32_t memoryType = 0;
+    AllocationStrategy strategy = AllocationStrategy::eBuddy;
+    bool image = false;
+    uint32_t blockCount = 0;
+    uint32_t allocationCount = 0;
+    vk::DeviceSize blockBytes = 0;
+    //bytes taken from blocks,including size class rounding and alignment
+    vk::DeviceSize usedBytes = 0;
+    //bytes the resources asked for
+    vk::DeviceSize requestedBytes = 0;
+    vk::DeviceSize largestFreeRange = 0;
+    //1-largestFreeRange/free bytes,0 means all free memory is one range
+    float fragmentation = 0;
+};
+struct GpuAllocatorStats{
+    std::vector<GpuPoolStats> pools;
+    uint32_t dedicatedCount = 0;
+    vk::DeviceSize dedicatedBytes = 0;
+    //live vkDeviceMemory objects,bounded by maxMemoryAllocationCount
+    uint32_t deviceMemoryCount = 0;
+    uint32_t maxDeviceMemoryCount = 0;
+};
+//sub-allocates buffers and images from large vkDeviceMemory blocks.
+//blocks are pooled per memory type,strategy and linear/optimal tiling,
+//so bufferImageGranularity never has to be considered inside a block.
+class GpuAllocator{
+public:
+    void init(vk::PhysicalDevice physicalDevice,vk::Device device);
+    //every allocation must have been freed
+    void cleanup();
+    //image is only used to tell optimal tiling resources apart and to bind dedicated allocations to them
+    GpuAllocation allocate(const vk::MemoryRequirements& requirements,vk::MemoryPropertyFlags props,
+                           AllocationStrategy strategy,vk::Image image = nullptr);
+    void free(GpuAllocation& allocation);
+    GpuAllocatorStats getStats();
+private:
+    struct Block{
+        vk::DeviceMemory memory;
+        char* mapped = nullptr;
+        uint32_t allocationCount = 0;
+        vk::DeviceSize usedBytes = 0;
+        vk::DeviceSize requestedBytes = 0;
+        //buddy:free offsets of every size class
+        std::vector<std::set<vk::DeviceSize>> freeLists;
+        //linear:first unused byte
+        vk::DeviceSize head = 0;
+    };
+    struct Pool{
+        uint32_t memoryType;
+        AllocationStrategy strategy;
+        bool image;
+        vk::DeviceSize blockSize;
+        uint32_t maxOrder;
+        //released blocks keep their slot with a null memory so block indices stay valid
+        std::vector<Block> blocks;
+    };
+    uint32_t findMemoryType(uint32_t memoryTypeBits,vk::MemoryPropertyFlags props);
+    int findPool(uint32_t memoryType,AllocationStrategy strategy,bool image);
+    int createBlock(Pool& pool);
+    void releaseBlock(Pool& pool,int block);
+    bool allocateBuddy(Pool& pool,int block,uint32_t order,GpuAllocation& allocation);
+    bool allocateLinear(Pool& pool,int block,const vk::MemoryRequirements& requirements,GpuAllocation& allocation);
+    GpuAllocation allocateDedicated(const vk::MemoryRequirements& requirements,uint32_t memoryType,vk::Image image);
+    vk::DeviceMemory allocateDeviceMemory(vk::DeviceSize size,uint32_t memoryType,void** mapped,vk::Image image = nullptr);
+private:
+    vk::Device device;
+    vk::PhysicalDeviceMemoryProperties memoryProperties;
+    uint32_t maxDeviceMemoryCount = 0;
+    std::mutex mutex;
+    std::vector<Pool> pools;
+    uint32_t deviceMemoryCount = 0;
+    uint32_t dedicatedCount = 0;
+    vk::DeviceSize dedicatedBytes = 0;
+};
+#endif
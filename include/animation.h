@@ -0,0 +1,68 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include"glm/glm.hpp"
+
+#include<vector>
+#include<string>
+#include<cstdint>
+
+namespace vkglTF{
+class ThreadPool;
+class TransformHierarchy;
+
+enum class Interpolation:uint8_t{
+    eLinear,
+    eStep,
+    eCubicSpline,
+};
+enum class AnimationPath:uint8_t{
+    eTranslation,
+    eRotation,
+    eScale,
+    eWeights,
+};
+struct AnimationSampler{
+    Interpolation interpolation = Interpolation::eLinear;
+    bool isRotation = false;
+    //keyframe times are times[timeOffset,timeOffset+keyCount)
+    uint32_t timeOffset = 0;
+    uint32_t keyCount = 0;
+    //every key takes stride floats in values(three times that for cubic spline: in tangent,value,out tangent),
+    //stride is padded to a multiple of 4 so keys can be loaded as whole SSE registers
+    uint32_t valueOffset = 0;
+    uint32_t stride = 4;
+    //sampled output is results[resultOffset,resultOffset+stride)
+    uint32_t resultOffset = 0;
+};
+struct AnimationChannel{
+    uint32_t sampler = 0;
+    AnimationPath path = AnimationPath::eTranslation;
+    //transform index for TRS paths,first morph weight for eWeights
+    uint32_t target = 0;
+    //morph weights written by an eWeights channel
+    uint32_t weightCount = 0;
+};
+class Animation{
+public:
+    //sample every sampler at time(seconds,wrapped into [start,end]) and write the result into the targeted transforms and morph weights
+    void evaluate(float time,TransformHierarchy& transforms,std::vector<float>& morphWeights,ThreadPool* pool = nullptr);
+    float duration() const {return end-start;}
+private:
+    void evaluateSampler(uint32_t samplerIndex,float time);
+public:
+    std::string name;
+    float start = 0;
+    float end = 0;
+    std::vector<float> times;
+    std::vector<float> values;
+    std::vector<AnimationSampler> samplers;
+    std::vector<AnimationChannel> channels;
+private:
+    //last keyframe segment of every sampler,playback usually moves forward so this avoids searching
+    std::vector<uint32_t> cursors;
+    std::vector<float> results;
+};
+}
+#endif
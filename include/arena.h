@@ -0,0 +1,95 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include<vector>
+#include<cstdint>
+#include<cstddef>
+#include<new>
+#include<stdexcept>
+#include<type_traits>
+
+namespace vkglTF{
+
+//default size of the blocks an Arena allocates from
+#define ARENA_BLOCK_SIZE (1<<20)
+
+//bump allocator for objects that live exactly as long as a scene.
+//objects are never destroyed one by one,reset() drops all of them at once,
+//so only trivially destructible types can be placed in it.
+class Arena{
+public:
+    Arena(size_t blockSize = ARENA_BLOCK_SIZE);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+public:
+    //count value initialized T's in contiguous memory
+    template<class T>
+    T* allocate(size_t count = 1){
+        static_assert(std::is_trivially_destructible_v<T>,"arena objects are never destroyed!");
+        if(count==0){
+            return nullptr;
+        }
+        T* objects = reinterpret_cast<T*>(allocateBytes(sizeof(T)*count,alignof(T)));
+        for(size_t i=0;i<count;++i){
+            new(objects+i) T();
+        }
+        return objects;
+    }
+    //drop every object,memory is kept as a single block large enough for everything allocated so far
+    void reset();
+    size_t getUsedBytes() const {return usedBytes;}
+    size_t getReservedBytes() const;
+private:
+    void* allocateBytes(size_t size,size_t alignment);
+private:
+    struct Block{
+        char* data;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t blockSize;
+    //first free byte of blocks.back()
+    size_t head = 0;
+    size_t usedBytes = 0;
+};
+
+//fixed capacity array placed in an Arena,objects refer to each other by their index in it
+template<class T>
+class ArenaArray{
+public:
+    //capacity value initialized elements,all of them in use
+    void allocate(Arena& arena,uint32_t count){
+        data = arena.allocate<T>(count);
+        capacity = this->count = count;
+    }
+    //room for capacity elements,filled with push()
+    void reserve(Arena& arena,uint32_t capacity){
+        data = arena.allocate<T>(capacity);
+        this->capacity = capacity;
+        count = 0;
+    }
+    T& push(){
+        if(count==capacity){
+            throw std::runtime_error("arena array is full!");
+        }
+        return data[count++];
+    }
+    //forget the elements,the memory itself goes away with Arena::reset()
+    void clear(){
+        data = nullptr;
+        count = capacity = 0;
+    }
+    uint32_t size() const {return count;}
+    T& operator[](uint32_t i){return data[i];}
+    const T& operator[](uint32_t i) const {return data[i];}
+    T* begin(){return data;}
+    T* end(){return data+count;}
+    const T* begin() const {return data;}
+    const T* end() const {return data+count;}
+private:
+    T* data = nullptr;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+};
+}
+#endif
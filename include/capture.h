@@ -0,0 +1,90 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#include"vulkan/vulkan.hpp"
+#include"allocator.h"
+
+#include<vector>
+#include<string>
+#include<mutex>
+#include<cstdint>
+
+class Renderer;
+namespace vkglTF{
+    class ThreadPool;
+}
+
+//readback buffers,frames are dropped instead of waited for when all of them are copying or encoding
+#define CAPTURE_RING_SIZE 8
+#define CAPTURE_ENCODER_THREADS 3
+
+enum class CaptureFormat{
+    //uncompressed,cheap enough to keep up with every frame at 1080p
+    eTga,
+    ePng,
+};
+struct CaptureOptions{
+    std::string directory = "captures";
+    CaptureFormat format = CaptureFormat::eTga;
+};
+struct CaptureStats{
+    //copies recorded
+    uint64_t captured = 0;
+    //frames skipped because no readback buffer was free
+    uint64_t dropped = 0;
+    uint64_t written = 0;
+    uint64_t failed = 0;
+    //smoothed time an encoder thread spends on one image,in ms
+    float encodeTime = 0;
+};
+
+//copies rendered images into a ring of host visible readback buffers from inside the frame's command buffer.
+//a copy is handed to the encoder threads once the fence of its frame has been waited on by render(),
+//framesInFlight frames later,so neither the copy nor the encoding ever stalls rendering.
+//encoders write straight from the mapped buffer and return it to the ring when done.
+class FrameCapture{
+public:
+    FrameCapture(Renderer* renderer,const CaptureOptions& options);
+    //encodes every copy still in flight,the device must be idle
+    ~FrameCapture();
+public:
+    //frame's fence has been waited on,so the copies recorded with it are complete
+    void collect(uint32_t frame);
+    //record a copy of image,which is in layout and is left in it,into a free readback buffer.
+    //outside of a render pass,frameNumber names the file
+    void record(vk::CommandBuffer commandBuffer,uint32_t frame,vk::Image image,vk::ImageLayout layout,uint64_t frameNumber);
+    //the device must be idle:encode every copy and wait for the encoders
+    void flush();
+    //recreate the readback buffers for the renderer's current image size,the device must be idle
+    void resize();
+    CaptureStats getStats();
+private:
+    void initSlots();
+    void destroySlots();
+    void encode(uint32_t slot);
+private:
+    enum class SlotState{
+        eFree,
+        //written by a frame in flight
+        eCopying,
+        eEncoding,
+    };
+    struct Slot{
+        vk::Buffer buffer;
+        GpuAllocation memory;
+        SlotState state = SlotState::eFree;
+        //frame in flight the copy was recorded in
+        uint32_t frame = 0;
+        uint64_t frameNumber = 0;
+    };
+    Renderer* renderer;
+    CaptureOptions options;
+    vk::Extent2D extent;
+    //the image is BGRA and swizzled by the encoders
+    bool swizzle = false;
+    vkglTF::ThreadPool* encoders;
+    //slot states and stats are shared with the encoder threads
+    std::mutex mutex;
+    std::vector<Slot> slots;
+    CaptureStats stats;
+};
+#endif
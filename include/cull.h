@@ -0,0 +1,133 @@
+#ifndef CULL_H
+#define CULL_H
+#include"vulkan/vulkan.hpp"
+#include"allocator.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include"glm/glm.hpp"
+
+#include<vector>
+
+class Renderer;
+struct CameraDetails;
+namespace vkglTF{
+    class Scene;
+}
+
+enum class CullPhase{
+    //everything frustum culling lets through,or with occlusion what the last frame's depth pyramid does not hide
+    eEarly,
+    //with occlusion,what eEarly hid but the depth pyramid of the early draws does not
+    eLate,
+};
+//written by cull.comp,read back once the frame's fence is signaled
+struct CullStats{
+    uint32_t drawCounts[2];
+    //triangles inside the frustum,what would be drawn without occlusion culling
+    uint32_t frustumTriangles;
+    //triangles drawn by both phases
+    uint32_t drawnTriangles;
+};
+
+//culls the scene's draw instances with a compute shader and writes the survivors as indexed indirect draws,
+//one set of buffers per frame in flight.
+//with drawIndirectCount the survivors are compacted per draw bucket and drawn through the count buffer,
+//otherwise every instance keeps its command and culled ones get an instanceCount of 0.
+//
+//frustum culling alone runs on the compute queue through dispatch().
+//occlusion culling is two phase and recorded into the graphics command buffer,since it reads the depth image:
+//recordCull(eEarly) tests against the depth pyramid of the last frame,the early draws are rendered,
+//recordPyramid() builds a new pyramid from their depth,and recordCull(eLate) draws what the early test hid wrongly.
+class CullPass{
+public:
+    CullPass(Renderer* renderer,vkglTF::Scene* scene);
+    ~CullPass();
+public:
+    //frustum cull against camera into frame's eEarly draws,modelMats copy frame has to be flushed already.
+    //the returned semaphore is signaled once the indirect commands are written
+    vk::Semaphore dispatch(uint32_t frame,const CameraDetails& camera);
+    //record culling of phase into a graphics command buffer,outside of a render pass
+    void recordCull(vk::CommandBuffer commandBuffer,uint32_t frame,const CameraDetails& camera,CullPhase phase);
+    //record building the depth pyramid from the renderer's depth image,outside of a render pass.
+    //the depth image is left in eDepthStencilAttachmentOptimal
+    void recordPyramid(vk::CommandBuffer commandBuffer,const CameraDetails& camera);
+    //record the draws of phase in one of the scene's drawBuckets,
+    //the bucket's pipeline and the scene's descriptors and buffers must be bound
+    void draw(vk::CommandBuffer commandBuffer,uint32_t frame,CullPhase phase,uint32_t bucket);
+    //draw calls draw() records for bucket,to balance recording across threads
+    uint32_t getDrawCallCount(uint32_t bucket) const;
+    //recreate the depth pyramid for the renderer's current depth image.
+    //frames in flight keep the old one,which the renderer destroys once they are done
+    void resize();
+    //stats of frame's last culling,valid once the graphics work of frame is done
+    const CullStats& getStats(uint32_t frame) const {return *frames[frame].statsMapped;}
+    uint32_t getInstanceCount() const {return instanceCount;}
+private:
+    void initPipelines();
+    void initFrames();
+    void initPyramid();
+    void destroyPyramid();
+    void writeFrameDescriptors();
+    //point frame's descriptor set at the current pyramid,once the frame's last use of it is done
+    void writePyramidDescriptor(uint32_t frame);
+    void recordDispatch(vk::CommandBuffer commandBuffer,uint32_t frame,const CameraDetails& camera,CullPhase phase,bool occlusion);
+    //the part of the depth image the renderer draws the scene into now
+    glm::vec2 getUVScale() const;
+private:
+    struct Frame{
+        //eEarly commands followed by eLate commands,instanceCount each
+        vk::Buffer commandsBuffer;
+        GpuAllocation commandsBufferMemory;
+        //CullStats followed by the per bucket draw counts,which are the count buffer.
+        //host visible,so stats can be read back
+        vk::Buffer statsBuffer;
+        GpuAllocation statsBufferMemory;
+        CullStats* statsMapped = nullptr;
+        //1 for every instance eEarly found in the frustum but occluded
+        vk::Buffer lateCandidatesBuffer;
+        GpuAllocation lateCandidatesBufferMemory;
+        //camera matrices and frustum planes
+        vk::Buffer uniformBuffer;
+        GpuAllocation uniformBufferMemory;
+        void* uniformMapped = nullptr;
+        vk::DescriptorSet descriptorSet;
+        //descriptorSet still points at a pyramid resize() retired
+        bool pyramidStale = false;
+        vk::CommandBuffer commandBuffer;
+        vk::Semaphore finished;
+    };
+    Renderer* renderer;
+    vkglTF::Scene* scene;
+    uint32_t instanceCount;
+    uint32_t bucketCount;
+    //of every frame's statsBuffer
+    uint32_t statsSize;
+    bool compact;
+
+    vk::DescriptorSetLayout descriptorSetLayout;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+    std::vector<Frame> frames;
+
+    //max depth pyramid,level 0 is the depth image scaled down to powers of two
+    vk::DescriptorSetLayout pyramidSetLayout;
+    vk::PipelineLayout pyramidPipelineLayout;
+    vk::Pipeline pyramidPipeline;
+    vk::Sampler pyramidSampler;
+    vk::Image pyramid;
+    GpuAllocation pyramidMemory;
+    vk::Extent2D pyramidExtent;
+    uint32_t pyramidLevels = 0;
+    //all levels,read by cull.comp
+    vk::ImageView pyramidView;
+    //one per level,written by pyramid.comp and read when building the next level
+    std::vector<vk::ImageView> pyramidLevelViews;
+    std::vector<vk::DescriptorSet> pyramidSets;
+    //the camera the pyramid was built with,invalid until the first build after a resize
+    glm::mat4 pyramidViewProj;
+    //getUVScale() when the pyramid was built
+    glm::vec2 pyramidUVScale = glm::vec2(1.0f);
+    bool pyramidValid = false;
+};
+#endif
@@ -0,0 +1,61 @@
+#ifndef DEFORM_H
+#define DEFORM_H
+#include"vulkan/vulkan.hpp"
+#include"allocator.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include"glm/glm.hpp"
+
+#include<array>
+#include<vector>
+
+class Renderer;
+namespace vkglTF{
+    class Scene;
+}
+
+//blends morph targets and skins the scene's vertices with a compute shader on the compute queue.
+//every slot owns a full copy of the vertex buffer,so deformation for the next frame
+//can run while the graphics queue still draws from the previous slots.
+//there is one slot more than frames in flight.
+class DeformPass{
+public:
+    DeformPass(Renderer* renderer,vkglTF::Scene* scene);
+    ~DeformPass();
+public:
+    //upload Scene::jointMatrices and Scene::morphWeights and submit deformation into the next slot,
+    //the returned semaphore is signaled once the slot's vertex buffer is ready
+    vk::Semaphore dispatch();
+    //vertex buffer written by the last dispatch
+    vk::Buffer getVertexBuffer() const;
+    bool hasDispatched() const {return dispatched;}
+private:
+    void initPipeline();
+    void initSlots();
+private:
+    struct Slot{
+        vk::Buffer vertexBuffer;
+        GpuAllocation vertexBufferMemory;
+        vk::Buffer jointBuffer;
+        GpuAllocation jointBufferMemory;
+        glm::mat4* jointsMapped = nullptr;
+        vk::Buffer weightBuffer;
+        GpuAllocation weightBufferMemory;
+        float* weightsMapped = nullptr;
+        vk::DescriptorSet descriptorSet;
+        vk::CommandBuffer commandBuffer;
+        vk::Fence fence;
+        vk::Semaphore finished;
+    };
+    Renderer* renderer;
+    vkglTF::Scene* scene;
+
+    vk::DescriptorSetLayout descriptorSetLayout;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+    std::vector<Slot> slots;
+    int curSlot = 0;
+    bool dispatched = false;
+};
+#endif
@@ -0,0 +1,187 @@
+#ifndef GLTFPARSER_H
+#define GLTFPARSER_H
+#include"tiny_gltf.h"
+
+#include<cstddef>
+#include<map>
+#include<string>
+#include<vector>
+
+namespace vkglTF{
+
+//the parts of a glTF document Scene reads.
+//names follow tinygltf,but names,extensions and extras are never stored,
+//so an accessor is a few dozen bytes instead of a tinygltf::Accessor's kilobyte.
+namespace glTF{
+
+struct Buffer{
+    std::string uri;
+    std::vector<unsigned char> data;
+};
+
+struct BufferView{
+    int buffer = -1;
+    size_t byteOffset = 0;
+    size_t byteLength = 0;
+    //0 means tightly packed
+    size_t byteStride = 0;
+};
+
+struct Accessor{
+    int bufferView = -1;
+    size_t byteOffset = 0;
+    int componentType = -1;
+    bool normalized = false;
+    size_t count = 0;
+    int type = -1;
+    struct Sparse{
+        int count = 0;
+        bool isSparse = false;
+        struct{
+            size_t byteOffset = 0;
+            int bufferView = -1;
+            int componentType = -1;
+        } indices;
+        struct{
+            int bufferView = -1;
+            size_t byteOffset = 0;
+        } values;
+    } sparse;
+    int ByteStride(const BufferView& bufferView) const {
+        if(bufferView.byteStride){
+            return (int)bufferView.byteStride;
+        }
+        return tinygltf::GetComponentSizeInBytes(componentType)*tinygltf::GetNumComponentsInType(type);
+    }
+};
+
+struct Image{
+    std::string uri;
+    std::string mimeType;
+    int bufferView = -1;
+    //decoded pixels,filled by decodeglTFImages
+    int width = -1;
+    int height = -1;
+    int component = -1;
+    std::vector<unsigned char> image;
+};
+
+struct Texture{
+    int source = -1;
+    int sampler = -1;
+};
+
+struct TextureInfo{
+    int index = -1;
+    int texCoord = 0;
+};
+struct NormalTextureInfo{
+    int index = -1;
+    int texCoord = 0;
+    double scale = 1.0;
+};
+struct OcclusionTextureInfo{
+    int index = -1;
+    int texCoord = 0;
+    double strength = 1.0;
+};
+
+struct PbrMetallicRoughness{
+    std::vector<double> baseColorFactor{1.0,1.0,1.0,1.0};
+    TextureInfo baseColorTexture;
+    double metallicFactor = 1.0;
+    double roughnessFactor = 1.0;
+    TextureInfo metallicRoughnessTexture;
+};
+
+struct Material{
+    std::vector<double> emissiveFactor{0.0,0.0,0.0};
+    std::string alphaMode{"OPAQUE"};
+    double alphaCutoff = 0.5;
+    bool doubleSided = false;
+    PbrMetallicRoughness pbrMetallicRoughness;
+    NormalTextureInfo normalTexture;
+    OcclusionTextureInfo occlusionTexture;
+    TextureInfo emissiveTexture;
+};
+
+struct Primitive{
+    std::map<std::string,int> attributes;
+    int material = -1;
+    int indices = -1;
+    int mode = -1;
+    std::vector<std::map<std::string,int>> targets;
+};
+
+struct Mesh{
+    std::vector<Primitive> primitives;
+    std::vector<double> weights;
+};
+
+struct Node{
+    int mesh = -1;
+    int skin = -1;
+    std::vector<int> children;
+    //either matrix or any of translation,rotation and scale are given
+    std::vector<double> matrix;
+    std::vector<double> translation;
+    std::vector<double> rotation;
+    std::vector<double> scale;
+    std::vector<double> weights;
+};
+
+struct Skin{
+    int inverseBindMatrices = -1;
+    int skeleton = -1;
+    std::vector<int> joints;
+};
+
+struct AnimationChannel{
+    int sampler = -1;
+    int target_node = -1;
+    std::string target_path;
+};
+struct AnimationSampler{
+    int input = -1;
+    int output = -1;
+    std::string interpolation{"LINEAR"};
+};
+struct Animation{
+    std::string name;
+    std::vector<AnimationChannel> channels;
+    std::vector<AnimationSampler> samplers;
+};
+
+struct Scene{
+    std::vector<int> nodes;
+};
+
+struct Model{
+    int defaultScene = -1;
+    std::vector<Scene> scenes;
+    std::vector<Node> nodes;
+    std::vector<Mesh> meshes;
+    std::vector<Accessor> accessors;
+    std::vector<BufferView> bufferViews;
+    std::vector<Buffer> buffers;
+    std::vector<Image> images;
+    std::vector<Texture> textures;
+    std::vector<Material> materials;
+    std::vector<Skin> skins;
+    std::vector<Animation> animations;
+};
+}
+
+//fill model from glTF JSON as it is tokenized,without building a json DOM first.
+//extensions and extras are skipped,buffers and images are left empty.
+void parseglTFJson(const char* text,size_t size,glTF::Model& model);
+//read and parse a .gltf file,returns the size of its JSON in bytes
+size_t parseglTFFile(const char* path,glTF::Model& model);
+//read every buffer,relative uris are resolved against the directory of path
+void loadglTFBuffers(const char* path,glTF::Model& model);
+//decode every image,the buffers have to be loaded already
+void decodeglTFImages(const char* path,glTF::Model& model);
+//all three steps above
+void loadglTFFile(const char* path,glTF::Model& model);
+}
+#endif
@@ -0,0 +1,76 @@
+#ifndef PACING_H
+#define PACING_H
+#include"vulkan/vulkan.hpp"
+
+#include<array>
+#include<chrono>
+#include<cstdint>
+
+class Renderer;
+
+//frames whose input time is kept until their present is measured
+#define PACING_LATENCY_HISTORY 16
+//the frame limiter sleeps until this long before the target and spins the rest,in ms
+#define PACING_SPIN_MARGIN 1.0
+
+struct PacingOptions{
+    //falls back to eFifo,which every surface supports
+    vk::PresentModeKHR presentMode = vk::PresentModeKHR::eMailbox;
+    //swapchain images,0 means minImageCount+1
+    uint32_t imageCount = 0;
+    //0 means unlimited
+    float fpsLimit = 0;
+    //with VK_KHR_present_wait,input for a frame is only sampled once at most this many earlier presents are pending.
+    //0 doesn't wait
+    uint32_t maxQueuedPresents = 1;
+};
+//smoothed,in ms
+struct PacingStats{
+    //from sampling input to the present call returning
+    float inputToPresentCall = 0;
+    //from sampling input to the image being presented,with present wait only.
+    //an upper bound,presents are noticed at most a frame late
+    float inputToPresented = 0;
+    //blocked by the limiter or present wait before sampling input
+    float pacingWait = 0;
+};
+
+//limits the frame rate and the number of queued presents,and measures input to present latency.
+//eWindowed only:tick() calls waitForFrameStart() before sampling input,render() brackets its present
+//with beforePresent() and afterPresent().
+class FramePacer{
+public:
+    FramePacer(Renderer* renderer);
+    ~FramePacer();
+public:
+    //wait for the frame limiter and present wait,then take the time input is sampled at
+    void waitForFrameStart();
+    //chain the frame's present id into presentInfo,which must be presented before the next call
+    void beforePresent(vk::PresentInfoKHR& presentInfo);
+    void afterPresent();
+    //present ids start over with a new swapchain
+    void swapchainRecreated();
+    const PacingStats& getStats() const {return stats;}
+    bool hasPresentWait() const {return presentWait;}
+private:
+    //note every present done by now,wait up to timeout ns for the one with id
+    bool waitForPresent(uint64_t id,uint64_t timeout);
+    void limitFrameRate();
+private:
+    Renderer* renderer;
+    bool presentWait;
+    vk::PresentIdKHR presentIdInfo;
+    //of the last present
+    uint64_t presentId = 0;
+    //every present up to this one has been noticed
+    uint64_t presentedId = 0;
+    std::array<std::chrono::high_resolution_clock::time_point,PACING_LATENCY_HISTORY> inputTimes;
+    std::chrono::high_resolution_clock::time_point inputTime;
+    std::chrono::high_resolution_clock::time_point nextFrameTime;
+    PacingStats stats;
+#ifdef _WIN32
+    //high resolution waitable timer,Sleep() has the granularity of the system timer
+    void* timer = nullptr;
+#endif
+};
+#endif
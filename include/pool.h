@@ -0,0 +1,103 @@
+#ifndef POOL_H
+#define POOL_H
+#include<vector>
+#include<cstdint>
+#include<utility>
+
+namespace vkglTF{
+
+//typed reference into a Pool.
+//the generation changes whenever the slot is released,so a handle kept
+//after its object went away resolves to nullptr instead of another object.
+template<class T>
+struct Handle{
+    static const uint32_t INVALID_INDEX = UINT32_MAX;
+    //slot of the object,stays the same for its whole lifetime
+    uint32_t index = INVALID_INDEX;
+    uint32_t generation = 0;
+    bool valid() const {return index!=INVALID_INDEX;}
+    bool operator==(const Handle& other) const {return index==other.index&&generation==other.generation;}
+    bool operator!=(const Handle& other) const {return !(*this==other);}
+};
+
+//objects are kept densely packed in creation order,releasing one moves the last object into its place.
+//handles go through a slot table,so they survive that move;pointers returned by get() do not
+//survive create or release.
+template<class T>
+class Pool{
+public:
+    void reserve(uint32_t capacity){
+        items.reserve(capacity);
+        denseToSlot.reserve(capacity);
+        slots.reserve(capacity);
+    }
+    //value initialized object,slots are handed out in order until something is released
+    Handle<T> create(){
+        uint32_t slot;
+        if(freeSlots.size()){
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else{
+            slot = slots.size();
+            slots.push_back({0,0});
+        }
+        slots[slot].dense = items.size();
+        items.emplace_back();
+        denseToSlot.push_back(slot);
+        return {slot,slots[slot].generation};
+    }
+    //stale handles are ignored
+    void release(Handle<T> handle){
+        if(!alive(handle)){
+            return;
+        }
+        Slot& slot = slots[handle.index];
+        uint32_t last = items.size()-1;
+        if(slot.dense!=last){
+            items[slot.dense] = std::move(items[last]);
+            denseToSlot[slot.dense] = denseToSlot[last];
+            slots[denseToSlot[last]].dense = slot.dense;
+        }
+        items.pop_back();
+        denseToSlot.pop_back();
+        slot.generation++;
+        freeSlots.push_back(handle.index);
+    }
+    bool alive(Handle<T> handle) const {
+        //a released slot's generation is ahead of every handle given out for it
+        return handle.index<slots.size()&&slots[handle.index].generation==handle.generation;
+    }
+    //nullptr for stale or invalid handles
+    T* get(Handle<T> handle){
+        return alive(handle)?&items[slots[handle.index].dense]:nullptr;
+    }
+    //handle of the object at a dense position
+    Handle<T> handleAt(uint32_t dense) const {
+        uint32_t slot = denseToSlot[dense];
+        return {slot,slots[slot].generation};
+    }
+    void clear(){
+        items.clear();
+        denseToSlot.clear();
+        slots.clear();
+        freeSlots.clear();
+    }
+    uint32_t size() const {return items.size();}
+    //dense access,for walking every live object in linear memory
+    T& operator[](uint32_t dense){return items[dense];}
+    T* data(){return items.data();}
+    typename std::vector<T>::iterator begin(){return items.begin();}
+    typename std::vector<T>::iterator end(){return items.end();}
+private:
+    struct Slot{
+        uint32_t dense;
+        uint32_t generation;
+    };
+    std::vector<T> items;
+    std::vector<uint32_t> denseToSlot;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+};
+}
+#endif
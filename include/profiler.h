@@ -0,0 +1,138 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include"vulkan/vulkan.hpp"
+#include"trace.h"
+
+#include<vector>
+#include<cstdint>
+
+class Renderer;
+
+//GPU zones one frame may record,each takes two timestamps
+#define PROFILER_MAX_ZONES 32
+//samples kept per zone for the graphs and percentiles
+#define PROFILER_HISTORY 240
+
+enum class ProfilerQueue{
+    eGraphics,
+    //only timed with host query reset,the graphics command buffer that would reset the queries runs after it
+    eCompute,
+};
+//the last PROFILER_HISTORY samples of one zone,in ms
+struct ProfilerZone{
+    const char* name;
+    bool gpu;
+    //ring,next is the oldest sample once full
+    std::vector<float> history;
+    uint32_t next = 0;
+    float last = 0;
+    float p50 = 0;
+    float p95 = 0;
+    float p99 = 0;
+};
+//pipeline statistics of a whole frame
+struct PipelineStatistics{
+    uint64_t inputPrimitives = 0;
+    uint64_t vertexInvocations = 0;
+    uint64_t clippingPrimitives = 0;
+    uint64_t fragmentInvocations = 0;
+    uint64_t computeInvocations = 0;
+};
+
+//timestamp and pipeline statistics queries around the stages of a frame,plus CPU scopes.
+//every frame in flight has its own query pools,which are read once render() has waited on the frame's fence,
+//so results are framesInFlight frames old but reading them never stalls.
+//zones are named by string literals and nest,a name may be used once per frame.
+//while Tracer is recording,every GPU zone is also added to the trace on its queue's track,
+//with timestamps converted into Tracer's clock by calibrate().
+class Profiler{
+public:
+    Profiler(Renderer* renderer,uint32_t framesInFlight);
+    ~Profiler();
+public:
+    //frame's fence has been waited on:read its queries into the zones and reset them
+    void collect(uint32_t frame);
+    //the first command of frame's graphics command buffer,before any zone but compute ones
+    void beginFrame(vk::CommandBuffer commandBuffer,uint32_t frame);
+    //the last command of frame's graphics command buffer
+    void endFrame(vk::CommandBuffer commandBuffer,uint32_t frame);
+    void beginZone(vk::CommandBuffer commandBuffer,uint32_t frame,const char* name,ProfilerQueue queue = ProfilerQueue::eGraphics);
+    void endZone(vk::CommandBuffer commandBuffer,uint32_t frame);
+    //outside of render passes,every draw and dispatch in between is counted
+    void beginStatistics(vk::CommandBuffer commandBuffer,uint32_t frame);
+    void endStatistics(vk::CommandBuffer commandBuffer,uint32_t frame);
+    //what secondary command buffers executed between beginStatistics and endStatistics inherit,empty without statistics
+    vk::QueryPipelineStatisticFlags getStatisticsFlags() const;
+    //a CPU sample
+    void addCpuSample(const char* name,float ms);
+    //GPU time of the last collected frame,0 without timestamps
+    float getGpuFrameTime() const {return gpuFrameTime;}
+    bool hasTimestamps() const {return graphicsTimestamps;}
+    //the "profiler" window
+    void drawUI();
+private:
+    ProfilerZone& getZone(const char* name,bool gpu);
+    void addSample(ProfilerZone& zone,float ms);
+    //find gpuOffset.with calibrated timestamps device and host clocks are sampled together,
+    //otherwise a timestamp is written and waited for,off by the submission latency
+    void calibrate();
+private:
+    struct FrameZone{
+        const char* name;
+        //of the begin timestamp,the end one follows it
+        uint32_t query;
+        ProfilerQueue queue;
+    };
+    struct Frame{
+        vk::QueryPool timestampPool;
+        vk::QueryPool statisticsPool;
+        std::vector<FrameZone> zones;
+        //indices into zones of the open ones
+        std::vector<int> openZones;
+        bool statisticsWritten = false;
+        //the frame zone around the whole command buffer
+        int frameZone = -1;
+    };
+    Renderer* renderer;
+    std::vector<Frame> frames;
+    bool graphicsTimestamps = false;
+    bool computeTimestamps = false;
+    bool statistics = false;
+    //queries are reset on the host in collect(),otherwise in beginFrame()
+    bool hostReset = false;
+    float timestampPeriod = 0;
+    uint64_t graphicsMask = 0;
+    uint64_t computeMask = 0;
+
+    //Tracer time of GPU tick 0,in ns
+    int64_t gpuOffset = 0;
+    //collected frames until calibrate() runs again while tracing
+    uint32_t calibrationCountdown = 0;
+    uint32_t graphicsTrack = 0;
+    uint32_t computeTrack = 0;
+
+    std::vector<ProfilerZone> zones;
+    float gpuFrameTime = 0;
+    PipelineStatistics lastStatistics;
+    bool paused = false;
+};
+
+//times its lifetime into profiler,which may be null,and into the trace while Tracer records
+class ProfileScope{
+public:
+    ProfileScope(Profiler* profiler,const char* name):profiler(profiler),name(name),start(Tracer::now()){}
+    ~ProfileScope(){
+        int64_t end = Tracer::now();
+        if(profiler){
+            profiler->addCpuSample(name,(end-start)/1000000.0f);
+        }
+        if(Tracer::enabled()){
+            Tracer::zone(name,start,end);
+        }
+    }
+private:
+    Profiler* profiler;
+    const char* name;
+    int64_t start;
+};
+#endif
@@ -0,0 +1,45 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+#include"vulkan/vulkan.hpp"
+
+#include<vector>
+#include<functional>
+#include<cstdint>
+
+class Renderer;
+
+//chunks one record() may split its draws into at most
+#define RECORDER_MAX_CHUNKS 32
+
+//records the draws of a subpass into secondary command buffers on the renderer's thread pool.
+//every frame in flight has a transient command pool per chunk,so a chunk allocates and records
+//without sharing a pool with any other thread,and the pools are reset in one call once the frame's fence is waited on.
+class DrawRecorder{
+public:
+    DrawRecorder(Renderer* renderer,uint32_t framesInFlight);
+    ~DrawRecorder();
+public:
+    //frame's fence has been waited on,its secondary command buffers can be recorded again
+    void reset(uint32_t frame);
+    //split draws [0,costs.size()) into up to chunkCount contiguous chunks of about equal cost
+    //and call recordRange(commandBuffer,begin,end) for every chunk in parallel,with a secondary command buffer
+    //that is begun inside inheritance's subpass and ended afterwards.
+    //returns the command buffers in draw order,for executeCommands in a subpass begun with eSecondaryCommandBuffers
+    std::vector<vk::CommandBuffer> record(uint32_t frame,uint32_t chunkCount,const vk::CommandBufferInheritanceInfo& inheritance,
+    const std::vector<uint32_t>& costs,const std::function<void(vk::CommandBuffer,uint32_t,uint32_t)>& recordRange);
+    //threads record() runs on at once,the calling thread included
+    uint32_t getThreadCount() const;
+private:
+    struct Chunk{
+        vk::CommandPool pool;
+        std::vector<vk::CommandBuffer> commandBuffers;
+        //handed out since the last reset
+        uint32_t used = 0;
+    };
+    struct Frame{
+        std::vector<Chunk> chunks;
+    };
+    Renderer* renderer;
+    std::vector<Frame> frames;
+};
+#endif
@@ -5,6 +5,13 @@
 #include"imgui_impl_sdl2.h"
 
 #include"vulkan/vulkan.hpp"
+#include"allocator.h"
+#include"cull.h"
+#include"capture.h"
+#include"profiler.h"
+#include"pacing.h"
+#include"recorder.h"
+#include"resolution.h"
 
 #define SDL_MAIN_HANDLED
 #include"SDL.h"
@@ -19,10 +26,25 @@
 
 #include<vector>
 #include<optional>
+#include<chrono>
+#include<string>
+#include<deque>
+#include<functional>
+
+#define MAX_FRAMES_IN_FLIGHT 4
+//driver pipeline cache,loaded at startup and saved at cleanup
+#define PIPELINE_CACHE_PATH "pipeline_cache.bin"
+#define DEFAULT_SCENE_PATH "assets/damagedHelmet/DamagedHelmet.gltf"
+//eHeadless renders into images of this format,and advances animations by a fixed step so runs are reproducible
+#define HEADLESS_FORMAT vk::Format::eR8G8B8A8Srgb
+#define HEADLESS_FRAME_TIME (1.0f/60.0f)
 
 namespace vkglTF{
     class Scene;
+    class ThreadPool;
 }
+class DeformPass;
+class ThumbnailBatch;
 struct CameraDetails{
     alignas(16) glm::vec3 cameraPosition;
     alignas(16) glm::vec3 viewDirection;
@@ -33,10 +55,64 @@ struct QueueFamiliyIndices{
     std::optional<uint32_t> graphicQueueFamily;
     std::optional<uint32_t> computeQueueFamily;
     std::optional<uint32_t> presentQueueFamily;
-    bool complete(){
-        return graphicQueueFamily.has_value()&&computeQueueFamily.has_value()&&presentQueueFamily.has_value();
+    bool complete(bool needPresent = true){
+        return graphicQueueFamily.has_value()&&computeQueueFamily.has_value()&&(presentQueueFamily.has_value()||!needPresent);
     }
 };
+enum class RendererMode{
+    eWindowed,
+    //instance,device,allocator,command and descriptor pools only:no SDL window,surface,swapchain or pipelines.
+    //enough to load scenes,e.g. for benchmarks on machines without a display
+    eDeviceOnly,
+    //everything eWindowed renders,but into offscreen images:no SDL window,surface,swapchain,present queue or UI.
+    //needs nothing a software ICD lacks,so it runs on machines without a GPU
+    eHeadless,
+};
+struct RendererOptions{
+    //clamped to 1..MAX_FRAMES_IN_FLIGHT
+    uint32_t framesInFlight = 2;
+    //empty starts eHeadless without a scene,setScene has to give it one before the first tick
+    std::string scenePath = DEFAULT_SCENE_PATH;
+    //of the offscreen images in eHeadless,the window decides it otherwise
+    vk::Extent2D extent = vk::Extent2D(800,800);
+    //capture every frame from the first one on,F12 toggles capturing with these options in eWindowed
+    bool captureFromStart = false;
+    CaptureOptions capture;
+    //eWindowed only
+    PacingOptions pacing;
+    //secondary command buffers the scene's draws are split into,recorded on that many threads at most.
+    //0 records them inline into the frame's command buffer
+    uint32_t recordThreads = 0;
+    DynamicResolutionOptions resolution;
+};
+//everything render() touches for one frame in flight
+struct FrameResources{
+    vk::CommandBuffer commandBuffer;
+    vk::Semaphore imageAvaliable;
+    vk::Fence inflightFence;
+};
+//smoothed over the last frames,in ms
+struct FrameTimings{
+    //from one render() to the next
+    float cpuFrame = 0;
+    //blocked on the fence of the frame being reused
+    float fenceWait = 0;
+    //from the fence wait to the submit
+    float record = 0;
+    //between the frame's first and last command on the GPU
+    float gpu = 0;
+    //recording the scene's draws,part of record
+    float sceneRecord = 0;
+};
+//pipeline creation since startup,to compare cold and warm starts
+struct PipelineCacheStats{
+    //a cache file matching this device and driver was loaded
+    bool warm = false;
+    size_t loadedBytes = 0;
+    uint32_t pipelineCount = 0;
+    //spent creating pipelines,in ms
+    float creationTime = 0;
+};
 struct SwapchainDetails{
     vk::SurfaceFormatKHR format;
     vk::SurfaceCapabilitiesKHR capabilities;
@@ -45,8 +121,15 @@ struct SwapchainDetails{
 };
 class Renderer{
     friend class vkglTF::Scene;
+    friend class DeformPass;
+    friend class CullPass;
+    friend class ThumbnailBatch;
+    friend class FrameCapture;
+    friend class Profiler;
+    friend class FramePacer;
+    friend class DrawRecorder;
 public:
-    Renderer();
+    Renderer(RendererMode mode = RendererMode::eWindowed,const RendererOptions& options = RendererOptions());
     ~Renderer();
 public:
     void init();
@@ -55,6 +138,27 @@ public:
 public:
     bool handleEvents();
     void render();
+    //eHeadless only,wait for the last rendered frame and write it as a PNG
+    void saveFrame(const char* path);
+    //eHeadless only,wait for the last rendered frame and copy it into pixels,tightly packed RGBA8 rows
+    void readFrame(std::vector<uint8_t>& pixels);
+    //eHeadless only,wait for the GPU and replace the scene,if any,by scene,which must be loaded and is owned by the renderer then.
+    //pipeline variants the new scene uses are created if earlier scenes didn't
+    void setScene(vkglTF::Scene* scene);
+    //place the camera so the scene's bounds fill the view
+    void frameScene();
+    vk::Extent2D getExtent() const {return swapchainDetails.extent;}
+    //copy every frame rendered from now on into the files of options,
+    //throws if the swapchain images can't be read back
+    void startCapture(const CaptureOptions& options);
+    //wait for the GPU and write every frame captured so far
+    void stopCapture();
+    bool isCapturing() const {return capture!=nullptr;}
+    const FrameTimings& getFrameTimings() const {return frameTimings;}
+    //see RendererOptions::recordThreads,clamped to RECORDER_MAX_CHUNKS
+    void setRecordThreads(uint32_t threads){options.recordThreads = std::min<uint32_t>(threads,RECORDER_MAX_CHUNKS);}
+    //threads recording secondary command buffers can run on at once
+    uint32_t getMaxRecordThreads() const {return recorder?recorder->getThreadCount():1;}
 private:
     //basic stuff
     void initSDL();
@@ -63,23 +167,51 @@ private:
     void initDebugMessenger();
     void initSurface();
     void initLogicalDevice();
+    void initPipelineCache();
     void initCommandPool();
     void initCommandBuffers();
     
     void initglTFScene();
+    //deform and cull passes of glTFScene,after initSceneTarget
+    void initScenePasses();
     
     //rendering stuff
     void initSwapchain();
+    //eHeadless stand in for the swapchain,one offscreen image per frame in flight
+    void initOffscreenImages();
     void initCamera();
-    void reinitSwapchain();
-    void initDepthResources();
+    //projectionMat from fovY,zNear,zFar and the current aspect ratio
+    void updateProjection();
+    //replace the swapchain and everything sized by it without waiting for the frames in flight,
+    //which keep the old ones until retired resources are destroyed.
+    //returns false if the window has no area,nothing is recreated then
+    bool reinitSwapchain();
+    //the next swapchain image,recreating the swapchain if it is out of date.empty if there is still none
+    std::optional<uint32_t> acquireImage(vk::Semaphore semaphore);
+    //destroy resources with destroy once the frames that may use them,the one being recorded included,are done
+    void retire(std::function<void()> destroy);
+    //destroy the retired resources whose frames are done,or all of them once the device is idle
+    void destroyRetired(bool all);
+    //scene color and depth images,which the scene render passes draw into at a scale of their size
+    void initSceneTarget();
+    void destroySceneTarget();
     void initDescriptorPool();
     void initRenderPass();
     void initFramebuffer();
+    //upscaleSet,reading the current scene target
+    void initUpscaleSet();
     void initSyncObjects();
+    void initProfiler();
     void initImGui();
+    //the ImGui windows of a frame
+    void buildUI();
     void initPipelineLayouts();
+    //defaultGraphicPipelineLayout,from glTFScene's set layouts
+    void initScenePipelineLayout();
+    //create the pipeline variants the scene's draw buckets use that don't exist yet
     void initPipelines();
+    //the fullscreen triangle of outputRenderPass and its sampler
+    void initUpscalePipeline();
 private:
     static void checkVkResult(VkResult result);
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugMessengerCallback(
@@ -97,18 +229,30 @@ private:
     uint32_t getDeviceExts(std::vector<const char*>& exts);
     void getDeviceFeatures(vk::PhysicalDeviceFeatures& features);
     void getSwapchainDetails();
-    vk::ImageView createImageView(vk::Image image,vk::Format format,vk::ImageAspectFlags aspectMask);
-    int getSuitableMemoryTypeIndex(uint32_t memoryTypeBits,vk::MemoryPropertyFlags props);
-    void createImage(vk::Image& image,vk::DeviceMemory& imageMemory,vk::Extent2D extent,vk::Format format,
-                    vk::ImageUsageFlags usages,vk::MemoryPropertyFlags memoryProps);
-    void createBuffer(vk::Buffer& buffer,vk::DeviceMemory& bufferMemory,int size,vk::BufferUsageFlags usages,vk::MemoryPropertyFlags memoryProps);
+    vk::ImageView createImageView(vk::Image image,vk::Format format,vk::ImageAspectFlags aspectMask,
+                                uint32_t baseMipLevel = 0,uint32_t levelCount = 1);
+    //memory comes from allocator,large images get a dedicated allocation
+    void createImage(vk::Image& image,GpuAllocation& imageMemory,vk::Extent2D extent,vk::Format format,
+                    vk::ImageUsageFlags usages,vk::MemoryPropertyFlags memoryProps,uint32_t mipLevels = 1);
+    //memory comes from allocator,staging buffers(eTransferSrc only) are allocated linearly
+    void createBuffer(vk::Buffer& buffer,GpuAllocation& bufferMemory,int size,vk::BufferUsageFlags usages,vk::MemoryPropertyFlags memoryProps);
+    //device local buffer filled with data through a staging buffer,eTransferDst is added to usages
+    void createDeviceLocalBuffer(vk::Buffer& buffer,GpuAllocation& bufferMemory,const void* data,int size,vk::BufferUsageFlags usages);
+    void destroyImage(vk::Image& image,GpuAllocation& imageMemory);
+    void destroyBuffer(vk::Buffer& buffer,GpuAllocation& bufferMemory);
     vk::ShaderModule createShaderModule(const char* path);
+    //through pipelineCache,timed into pipelineCacheStats.name is used in the error message
+    vk::Pipeline createGraphicsPipeline(const vk::GraphicsPipelineCreateInfo& createInfo,const char* name);
+    vk::Pipeline createComputePipeline(const vk::ComputePipelineCreateInfo& createInfo,const char* name);
+    //write pipelineCache to PIPELINE_CACHE_PATH and destroy it
+    void savePipelineCache();
 
     vk::CommandBuffer startOneShotCommandBuffer(vk::CommandPool cp);
     void finishOneShotCommandBuffer(vk::CommandPool cp,vk::CommandBuffer cb,vk::Queue q);
 private:
-    SDL_Window* sdlWindow;
+    SDL_Window* sdlWindow = nullptr;
     float lastSDLtime = 0.0f;
+    float deltaTime = 0.0f;
     bool windowMinimized = false;
     bool moveLeft=false;
     bool moveRight=false;
@@ -120,7 +264,22 @@ private:
     float rotationSpeed=0.1;
 
 private:
-    vkglTF::Scene* glTFScene;
+    RendererMode mode;
+    RendererOptions options;
+    vkglTF::Scene* glTFScene = nullptr;
+    vkglTF::ThreadPool* threadPool;
+    DeformPass* deformPass = nullptr;
+    //null if the scene has no indexed primitives
+    CullPass* cullPass = nullptr;
+    bool occlusionCulling = true;
+    //of the last completed frame
+    CullStats cullStats = {};
+    //null unless capturing
+    FrameCapture* capture = nullptr;
+    //null unless eWindowed
+    FramePacer* pacer = nullptr;
+    //resized,out of date,suboptimal or options.pacing changed:the swapchain is recreated before the next frame
+    bool swapchainDirty = false;
 private:
     vk::DispatchLoaderDynamic dld;
     vk::Instance vkInstance;
@@ -129,39 +288,107 @@ private:
     vk::PhysicalDevice pDevice;
     vk::Device lDevice;
     QueueFamiliyIndices queueFamilyIndices;
+    //optional device features,enabled when the physical device has them
+    bool drawIndirectCountSupported = false;
+    bool multiDrawIndirectSupported = false;
+    bool pipelineStatisticsSupported = false;
+    bool hostQueryResetSupported = false;
+    //secondary command buffers may run while a pipeline statistics query is active
+    bool inheritedQueriesSupported = false;
+    //VK_EXT_calibrated_timestamps with a host domain steady_clock uses
+    bool calibratedTimestampsSupported = false;
+    //VK_KHR_present_id and VK_KHR_present_wait,eWindowed only
+    bool presentWaitSupported = false;
     vk::Queue graphicQueue;
     vk::Queue computeQueue;
     vk::Queue presentQueue;
     vk::SwapchainKHR swapchain;
     SwapchainDetails swapchainDetails;
+    //of the surface,for the UI
+    std::vector<vk::PresentModeKHR> supportedPresentModes;
+    //the images can be copied from,capture needs it
+    bool swapchainReadable = false;
+    //in eHeadless the offscreen images,owned by the renderer then
     std::vector<vk::Image> swapchainImages;
+    std::vector<GpuAllocation> offscreenImageMemory;
     std::vector<vk::ImageView> swapchainImageViews;
     vk::CommandPool graphicCommandPool;
     vk::CommandPool computeCommandPool;
     vk::DescriptorPool descriptorPool;
+    GpuAllocator allocator;
+    //shared by every pipeline,imgui's included
+    vk::PipelineCache pipelineCache;
+    PipelineCacheStats pipelineCacheStats;
 
-    vk::CommandBuffer renderingCommandBuffers;
-
-    vk::RenderPass imguiRenderPass;
+    std::vector<FrameResources> frames;
 
     vk::PipelineLayout defaultGraphicPipelineLayout;
-    vk::Pipeline defaultGraphicPipeline;
+    //indexed by pipeline variant,null for variants the scene doesn't use
+    std::vector<vk::Pipeline> graphicPipelines;
+    //the scene passes draw into the scene target,which the output pass then upscales into the swapchain image.
+    //the frame without occlusion culling
     vk::RenderPass defaultGraphicRenderPass;
+    //with occlusion culling,the early draws are kept for the depth pyramid,
+    //then the late pass loads them and adds the late draws
+    vk::RenderPass earlyGraphicRenderPass;
+    vk::RenderPass lateGraphicRenderPass;
 
-    std::vector<vk::Framebuffer> imguiFrameBuffers;
-    std::vector<vk::Framebuffer> defaultGraphicFrameBuffers;
+    //the only pass over the swapchain image:the upscaled scene,then the ui on top at native resolution.
+    //the image is left in its final layout
+    vk::RenderPass outputRenderPass;
 
-    vk::Semaphore imageAvaliable;
-    vk::Semaphore renderingFinished;
-    vk::Fence inflightFence;
+    //scene color and depth,used with every scene render pass
+    vk::Framebuffer sceneFramebuffer;
+    //per swapchain image,used with outputRenderPass
+    std::vector<vk::Framebuffer> frameBuffers;
+
+    //per swapchain image,the presentation engine may still wait on it when a frame in flight comes around again
+    std::vector<vk::Semaphore> renderingFinished;
+    //fence of the frame that last rendered into each swapchain image
+    std::vector<vk::Fence> imagesInFlight;
+    struct RetiredResources{
+        //the last frame that may use them
+        uint64_t frame;
+        std::function<void()> destroy;
+    };
+    //oldest first
+    std::deque<RetiredResources> retired;
+    //timestamp and pipeline statistics queries of every frame,null in eDeviceOnly
+    Profiler* profiler = nullptr;
+    //secondary command buffers of the scene's draws,null in eDeviceOnly
+    DrawRecorder* recorder = nullptr;
 
+    //the scene target,the scene draws into the renderExtent corner of sceneExtent
+    vk::Image sceneColorImage;
+    GpuAllocation sceneColorImageMemory;
+    vk::ImageView sceneColorImageView;
     vk::Image depthImage;
-    vk::DeviceMemory depthImageMemory;
+    GpuAllocation depthImageMemory;
     vk::ImageView depthImageView;
+    vk::Extent2D sceneExtent;
+    vk::Extent2D renderExtent;
+    //the scene color format can be sampled with linear filtering
+    bool sceneFilterLinear = false;
+    //samples the renderExtent corner of the scene color over the whole swapchain image
+    vk::DescriptorSetLayout upscaleSetLayout;
+    vk::PipelineLayout upscalePipelineLayout;
+    vk::Pipeline upscalePipeline;
+    vk::Sampler upscaleSampler;
+    //the scene color view,allocated with the scene target and retired with it
+    vk::DescriptorSet upscaleSet;
+    ResolutionController resolution;
 private:
-    int curFrame = 0;
-    int maxInFlightFrame = 2;
+    uint32_t curFrame = 0;
+    //swapchain or offscreen image the last render() drew into
+    uint32_t lastImage = 0;
+    uint64_t renderedFrames = 0;
+    uint32_t framesInFlight;
+    std::chrono::high_resolution_clock::time_point lastFrameStart;
+    FrameTimings frameTimings;
 
     CameraDetails camera;
+    float fovY = glm::radians(45.0f);
+    float zNear = 0.01f;
+    float zFar = 1000.0f;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+#include<cstdint>
+
+//the controller aims this far below the budget,so frames near it don't go over
+#define RESOLUTION_HEADROOM 0.9f
+//gpu times within this fraction of the target leave the scale alone
+#define RESOLUTION_DEADBAND 0.05f
+//largest scale change of one adjustment
+#define RESOLUTION_MAX_STEP 0.1f
+
+struct DynamicResolutionOptions{
+    //eWindowed only,timestamps make eHeadless frames depend on the machine otherwise
+    bool enabled = false;
+    //gpu time of a frame,in ms
+    float gpuBudget = 1000.0f/60.0f;
+    //of the swapchain extent on each axis
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+};
+
+//picks the scene's render scale from measured gpu frame times.
+//the cost of a frame is taken to be proportional to its pixels,so the scale follows the square root of budget/time.
+//measurements are a few frames old,so after an adjustment the frames rendered before it are waited out
+class ResolutionController{
+public:
+    ResolutionController(const DynamicResolutionOptions& options):options(options),scale(options.maxScale){}
+public:
+    //gpuTime of the frame latency frames ago,in ms.returns the scale to render the next frame at
+    float update(float gpuTime,uint32_t latency);
+    //keep the scale at maxScale
+    void reset(){scale = options.maxScale;cooldown = 0;}
+    float getScale() const {return scale;}
+    DynamicResolutionOptions& getOptions() {return options;}
+private:
+    DynamicResolutionOptions options;
+    float scale;
+    //frames until a measurement reflects the last adjustment
+    uint32_t cooldown = 0;
+};
+#endif
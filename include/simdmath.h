@@ -0,0 +1,94 @@
+#ifndef SIMDMATH_H
+#define SIMDMATH_H
+#if defined(_M_X64)||defined(_M_IX86)||defined(__SSE2__)
+#define VKGLTF_SSE
+#include<immintrin.h>
+#endif
+
+//small 4x4 helpers working on raw column major float[16],as glm stores its mat4.
+//AVX is used when the compiler is allowed to(/arch:AVX2 or -mavx),SSE2 otherwise.
+namespace vkglTF::simd{
+
+//out = a*b,out must not alias a or b
+inline void mulMat4(const float* a,const float* b,float* out)
+{
+#if defined(__AVX__)
+    __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a));
+    __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a+4));
+    __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a+8));
+    __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a+12));
+    for(int j=0;j<16;j+=8){
+        //two columns of b per iteration
+        __m256 bb = _mm256_loadu_ps(b+j);
+        __m256 r = _mm256_mul_ps(a0,_mm256_permute_ps(bb,_MM_SHUFFLE(0,0,0,0)));
+        r = _mm256_add_ps(r,_mm256_mul_ps(a1,_mm256_permute_ps(bb,_MM_SHUFFLE(1,1,1,1))));
+        r = _mm256_add_ps(r,_mm256_mul_ps(a2,_mm256_permute_ps(bb,_MM_SHUFFLE(2,2,2,2))));
+        r = _mm256_add_ps(r,_mm256_mul_ps(a3,_mm256_permute_ps(bb,_MM_SHUFFLE(3,3,3,3))));
+        _mm256_storeu_ps(out+j,r);
+    }
+#elif defined(VKGLTF_SSE)
+    __m128 a0 = _mm_loadu_ps(a);
+    __m128 a1 = _mm_loadu_ps(a+4);
+    __m128 a2 = _mm_loadu_ps(a+8);
+    __m128 a3 = _mm_loadu_ps(a+12);
+    for(int j=0;j<16;j+=4){
+        __m128 bj = _mm_loadu_ps(b+j);
+        __m128 r = _mm_mul_ps(a0,_mm_shuffle_ps(bj,bj,_MM_SHUFFLE(0,0,0,0)));
+        r = _mm_add_ps(r,_mm_mul_ps(a1,_mm_shuffle_ps(bj,bj,_MM_SHUFFLE(1,1,1,1))));
+        r = _mm_add_ps(r,_mm_mul_ps(a2,_mm_shuffle_ps(bj,bj,_MM_SHUFFLE(2,2,2,2))));
+        r = _mm_add_ps(r,_mm_mul_ps(a3,_mm_shuffle_ps(bj,bj,_MM_SHUFFLE(3,3,3,3))));
+        _mm_storeu_ps(out+j,r);
+    }
+#else
+    for(int j=0;j<4;++j){
+        for(int i=0;i<4;++i){
+            out[j*4+i] = a[i]*b[j*4]+a[4+i]*b[j*4+1]+a[8+i]*b[j*4+2]+a[12+i]*b[j*4+3];
+        }
+    }
+#endif
+}
+
+//out = T*R*S,q is a quaternion stored as x,y,z,w
+inline void composeTRS(const float* t,const float* q,const float* s,float* out)
+{
+#if defined(VKGLTF_SSE)
+    __m128 quat = _mm_loadu_ps(q);
+    __m128 quat2 = _mm_add_ps(quat,quat);
+    alignas(16) float x2[4];
+    alignas(16) float y2[4];
+    alignas(16) float z2[4];
+    //2x*(x,y,z,w),2y*(x,y,z,w),2z*(x,y,z,w)
+    _mm_store_ps(x2,_mm_mul_ps(_mm_shuffle_ps(quat,quat,_MM_SHUFFLE(0,0,0,0)),quat2));
+    _mm_store_ps(y2,_mm_mul_ps(_mm_shuffle_ps(quat,quat,_MM_SHUFFLE(1,1,1,1)),quat2));
+    _mm_store_ps(z2,_mm_mul_ps(_mm_shuffle_ps(quat,quat,_MM_SHUFFLE(2,2,2,2)),quat2));
+    float xx = x2[0],xy = x2[1],xz = x2[2],xw = x2[3];
+    float yy = y2[1],yz = y2[2],yw = y2[3];
+    float zz = z2[2],zw = z2[3];
+    __m128 col0 = _mm_setr_ps(1.0f-yy-zz,xy+zw,xz-yw,0.0f);
+    __m128 col1 = _mm_setr_ps(xy-zw,1.0f-xx-zz,yz+xw,0.0f);
+    __m128 col2 = _mm_setr_ps(xz+yw,yz-xw,1.0f-xx-yy,0.0f);
+    _mm_storeu_ps(out,_mm_mul_ps(col0,_mm_set1_ps(s[0])));
+    _mm_storeu_ps(out+4,_mm_mul_ps(col1,_mm_set1_ps(s[1])));
+    _mm_storeu_ps(out+8,_mm_mul_ps(col2,_mm_set1_ps(s[2])));
+    _mm_storeu_ps(out+12,_mm_setr_ps(t[0],t[1],t[2],1.0f));
+#else
+    float x = q[0],y = q[1],z = q[2],w = q[3];
+    float xx = 2*x*x,xy = 2*x*y,xz = 2*x*z,xw = 2*x*w;
+    float yy = 2*y*y,yz = 2*y*z,yw = 2*y*w;
+    float zz = 2*z*z,zw = 2*z*w;
+    float m[16] = {
+        1.0f-yy-zz,xy+zw,xz-yw,0.0f,
+        xy-zw,1.0f-xx-zz,yz+xw,0.0f,
+        xz+yw,yz-xw,1.0f-xx-yy,0.0f,
+        t[0],t[1],t[2],1.0f
+    };
+    for(int i=0;i<4;++i){
+        out[i] = m[i]*s[0];
+        out[4+i] = m[4+i]*s[1];
+        out[8+i] = m[8+i]*s[2];
+        out[12+i] = m[12+i];
+    }
+#endif
+}
+}
+#endif
@@ -0,0 +1,39 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+#include<vector>
+#include<deque>
+#include<cstdint>
+
+namespace vkglTF{
+
+class ThreadPool{
+public:
+    //threadCount is the number of worker threads,0 means hardware_concurrency-1
+    ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+public:
+    //workers plus the calling thread
+    uint32_t getThreadCount() const;
+    //split [0,count) into chunks of grainSize and run fn(begin,end) on them,
+    //the calling thread takes chunks too and returns once every chunk is done.
+    void parallelFor(uint32_t count,uint32_t grainSize,const std::function<void(uint32_t,uint32_t)>& fn);
+    void submit(std::function<void()> job);
+    //wait until every submitted job is done
+    void wait();
+private:
+    void workerLoop();
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvaliable;
+    std::condition_variable jobsFinished;
+    uint32_t runningJobs = 0;
+    bool stopping = false;
+};
+}
+#endif
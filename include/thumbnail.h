@@ -0,0 +1,63 @@
+#ifndef THUMBNAIL_H
+#define THUMBNAIL_H
+#include<vector>
+#include<string>
+#include<future>
+#include<deque>
+#include<cstdint>
+
+class Renderer;
+namespace vkglTF{
+    class Scene;
+}
+
+//frames rendered per asset before the readback,so deformation and the occlusion pyramid have settled
+#define THUMBNAIL_FRAMES 3
+//PNGs being encoded at once,the oldest is waited for before another readback
+#define THUMBNAIL_MAX_PENDING_WRITES 2
+
+//in ms,summed over every asset
+struct ThumbnailStats{
+    uint32_t rendered = 0;
+    uint32_t failed = 0;
+    //the render thread waiting for the reading of the next asset
+    double readWait = 0;
+    //Scene::upload and Renderer::setScene
+    double upload = 0;
+    double render = 0;
+    double readback = 0;
+    //the render thread waiting for PNG writes
+    double writeWait = 0;
+    double total = 0;
+    double assetsPerSecond() const {return total>0?rendered*1000.0/total:0.0;}
+};
+
+//renders one PNG per glTF file with a single eHeadless renderer,so the device,pipelines and pipeline cache are reused.
+//the renderer's own scene isn't rendered,it can be started without one(an empty RendererOptions::scenePath).
+//reading asset N+1(parse,buffers,image decode) runs on another thread while asset N is uploaded and rendered,
+//and PNGs are encoded on other threads while the next asset renders.
+//uploads stay on the render thread,they share the graphics queue and command pool with rendering.
+class ThumbnailBatch{
+public:
+    ThumbnailBatch(Renderer* renderer,uint32_t framesPerAsset = THUMBNAIL_FRAMES);
+    ~ThumbnailBatch();
+public:
+    //write outDir/<path without extension,separators as '_'>.png for every path.
+    //assets that fail to load are reported and skipped
+    const ThumbnailStats& run(const std::vector<std::string>& paths,const std::string& outDir);
+private:
+    //readFile on a new scene,runs on another thread
+    vkglTF::Scene* readScene(const std::string& path);
+    //wait for the oldest PNG write,a failed one counts as a failed asset
+    void waitWrite();
+private:
+    struct PendingWrite{
+        std::string path;
+        std::future<bool> written;
+    };
+    Renderer* renderer;
+    uint32_t framesPerAsset;
+    ThumbnailStats stats;
+    std::deque<PendingWrite> pendingWrites;
+};
+#endif
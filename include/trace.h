@@ -0,0 +1,48 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include<atomic>
+#include<chrono>
+#include<cstdint>
+
+//events a thread or GPU track keeps at most,later ones are dropped and counted
+#define TRACE_MAX_EVENTS_PER_TRACK (1u<<20)
+
+//records CPU zones of every thread and GPU zones of every queue into a Chrome trace event file,
+//which chrome://tracing and Perfetto open.
+//times are steady_clock nanoseconds,GPU timestamps are converted into them by the profiler.
+//while not started a zone costs one relaxed atomic load.
+//names must be string literals or otherwise outlive the trace.
+class Tracer{
+public:
+    static void start();
+    //stop recording and write everything recorded to path,returns false if it can't be written
+    static bool stop(const char* path);
+    static bool enabled(){return active.load(std::memory_order_relaxed);}
+    static int64_t now(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    //name of the calling thread in the trace
+    static void setThreadName(const char* name);
+    //a zone of the calling thread from begin to end
+    static void zone(const char* name,int64_t begin,int64_t end);
+    //a named timeline without a thread,e.g. a GPU queue.returns its id for trackZone
+    static uint32_t getTrack(const char* name);
+    static void trackZone(uint32_t track,const char* name,int64_t begin,int64_t end);
+private:
+    static std::atomic<bool> active;
+};
+
+//a zone of the calling thread over the scope's lifetime
+class TraceScope{
+public:
+    TraceScope(const char* name):name(name),begin(Tracer::enabled()?Tracer::now():0){}
+    ~TraceScope(){
+        if(begin&&Tracer::enabled()){
+            Tracer::zone(name,begin,Tracer::now());
+        }
+    }
+private:
+    const char* name;
+    int64_t begin;
+};
+#endif
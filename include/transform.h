@@ -0,0 +1,54 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include"glm/glm.hpp"
+#include"glm/gtc/matrix_transform.hpp"
+#include"glm/gtc/type_ptr.hpp"
+
+#include<vector>
+#include<cstdint>
+
+namespace vkglTF{
+class ThreadPool;
+
+//node transforms flattened into arrays.after finalize() nodes are stored level by level,
+//so a whole level can be updated in parallel once the level above it is done.
+class TransformHierarchy{
+public:
+    enum Flags:uint8_t{
+        eLocalDirty = 1,
+        eUseMatrix = 2,
+        eGlobalChanged = 4,
+    };
+public:
+    uint32_t addNode(int parent,const glm::vec3& translation,const glm::quat& rotation,const glm::vec3& scale);
+    uint32_t addNode(int parent,const glm::mat4& matrix);
+    //sort nodes by depth,returns the new index of every node added so far
+    std::vector<uint32_t> finalize();
+    void clear();
+    //recompute dirty locals and every global below them,level by level
+    void update(ThreadPool* pool = nullptr);
+
+    void setTranslation(uint32_t node,const glm::vec3& translation);
+    void setRotation(uint32_t node,const glm::quat& rotation);
+    void setScale(uint32_t node,const glm::vec3& scale);
+
+    uint32_t size() const {return parents.size();}
+    uint32_t levelCount() const {return levelOffsets.size()?levelOffsets.size()-1:0;}
+    bool globalChanged(uint32_t node) const {return flags[node]&eGlobalChanged;}
+    const glm::mat4& getGlobal(uint32_t node) const {return globals[node];}
+private:
+    void updateRange(uint32_t begin,uint32_t end);
+public:
+    std::vector<int> parents;
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> globals;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> levelOffsets;
+};
+}
+#endif
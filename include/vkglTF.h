@@ -1,7 +1,8 @@
 #ifndef VKGLTF_H
 #define VKGLTF
 #include"vulkan/vulkan.hpp"
-#include"tiny_gltf.h"
+#include"gltfparser.h"
+#include"allocator.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -9,6 +10,13 @@
 #include"glm/gtc/matrix_transform.hpp"
 #include"glm/gtc/type_ptr.hpp"
 
+#include"transform.h"
+#include"animation.h"
+#include"arena.h"
+#include"pool.h"
+
+#include<mutex>
+
 class Renderer;
 namespace vkglTF{
 
@@ -79,12 +87,19 @@ struct Vertex{
         return attributes;
     }
 };
+struct Texture;
+struct Material;
+struct Mesh;
+typedef Handle<Texture> TextureHandle;
+typedef Handle<Material> MaterialHandle;
+typedef Handle<Mesh> MeshHandle;
+
 struct Texture{
     //vk stuff
     int index;
     vk::Image textureImage;
     vk::ImageView textureImageView;
-    vk::DeviceMemory imageMemory;
+    GpuAllocation imageMemory;
     vk::Sampler imageSampler;
     vk::DescriptorImageInfo desriptorImageInfo;
 
@@ -103,19 +118,39 @@ struct MaterialProperties{
     alignas(4) int texCoord_normal=-1;
     alignas(4) int texCoord_occlusion=-1;
     alignas(4) int texCoord_emissive=-1;
+    //only read by PIPELINE_VARIANT_ALPHA_MASK pipelines
+    alignas(4) float alphaCutoff=0.5f;
 };
+enum class AlphaMode{
+    eOpaque,
+    eMask,
+    eBlend,
+};
+//material state baked into a graphics pipeline,as specialization constants of fragshader.frag
+//and fixed function state.the alpha mode is the high bits,so variants sort opaque,masked,blended
+#define PIPELINE_VARIANT_DOUBLE_SIDED 1
+#define PIPELINE_VARIANT_BASE_COLOR_TEXTURE 2
+#define PIPELINE_VARIANT_ALPHA_SHIFT 2
+#define PIPELINE_VARIANT_ALPHA_MASK (1<<PIPELINE_VARIANT_ALPHA_SHIFT)
+#define PIPELINE_VARIANT_ALPHA_BLEND (2<<PIPELINE_VARIANT_ALPHA_SHIFT)
+#define PIPELINE_VARIANT_COUNT 12
+//textures,materials and meshes live in the Scene's pools and are referenced by handle,
+//the node graph lives in Scene::arena and refers to itself by index
 struct Material{ 
+    //slot in materialDescriptorSet,equal to the handle's index
     int index;
-    Texture* baseColorTexture;
-    Texture* metallicRoughnessTexture;
-    Texture* normalTexture;
-    Texture* occlusionTexture;
-    Texture* emissiveTexture;
+    TextureHandle baseColorTexture;
+    TextureHandle metallicRoughnessTexture;
+    TextureHandle normalTexture;
+    TextureHandle occlusionTexture;
+    TextureHandle emissiveTexture;
 
     MaterialProperties properties;
+    AlphaMode alphaMode = AlphaMode::eOpaque;
+    bool doubleSided = false;
 
     vk::Buffer uniformMaterialBuffer;
-    vk::DeviceMemory uniformMaterialBufferMemory;
+    GpuAllocation uniformMaterialBufferMemory;
     vk::DescriptorBufferInfo descriptorBufferInfo;
 
     vk::DescriptorSet desriptorSet;
@@ -128,69 +163,280 @@ struct Primitive{
 
     bool useIndex = false;
 
-    Material* material=nullptr;
+    MaterialHandle material;
+    //rest pose bounds in the space of the primitive's mesh
+    glm::vec3 boundsMin = {};
+    glm::vec3 boundsMax = {};
 };
+//only what building a draw list reads,so walking Scene::meshes stays in a few cache lines per mesh
 struct Mesh{
-    struct Node* parent=nullptr;
-    std::vector<Primitive*> primitives;
-    ~Mesh();
+    //primitives are Scene::primitives[firstPrimitive,firstPrimitive+primitiveCount)
+    uint32_t firstPrimitive = 0;
+    uint32_t primitiveCount = 0;
+    int modelMatID = -1;
+    uint32_t node = 0;
 };
 struct Node{
-    Node* parent=nullptr;
-    std::vector<Node*> children;
-    Mesh* mesh=nullptr;
+    int parent = -1;
+    //children are Scene::nodeChildren[firstChild,firstChild+childCount)
+    uint32_t firstChild = 0;
+    uint32_t childCount = 0;
+    MeshHandle mesh;
 
     glm::vec3 translation={};
     glm::quat rotation={};
     glm::vec3 scale={1,1,1};
 
-    glm::mat4 local_transform;
-    glm::mat4 global_transform;
-
-    ~Node();
+    //index into Scene::transforms,which holds the local and global matrices
+    uint32_t transformIndex=0;
 };
 struct ModelMatrix{
     alignas(16) glm::mat4 model;
 };
+//a skinned and/or morphed vertex,matches DeformVertex in deform.comp.
+//the rest pose is read from the scene's vertex buffer at vertexIndex.
+struct DeformVertex{
+    uint32_t vertexIndex;
+    //morph deltas of this vertex are morphDeltas[morphOffset,morphOffset+morphCount)
+    uint32_t morphOffset = 0;
+    uint32_t morphCount = 0;
+    uint32_t padding = 0;
+    //absolute indices into Scene::jointMatrices,weights are all zero for unskinned vertices
+    glm::uvec4 joints = {};
+    glm::vec4 weights = {};
+};
+//one non zero morph target delta,quantized to half floats
+struct MorphDelta{
+    //absolute index into Scene::morphWeights
+    uint32_t weightIndex;
+    //packHalf2x16 of position.xy,(position.z,normal.x),normal.yz
+    uint32_t positionXY;
+    uint32_t positionZNormalX;
+    uint32_t normalYZ;
+};
+//an indexed primitive as the culling shader sees it,matches DrawInstance in cull.comp
+struct DrawInstance{
+    //bounds in the space of modelMats[modelMatID]
+    alignas(16) glm::vec3 boundsMin = {};
+    uint32_t indexStart = 0;
+    alignas(16) glm::vec3 boundsMax = {};
+    uint32_t indexCount = 0;
+    uint32_t modelMatID = 0;
+    //DRAW_INSTANCE_* bits
+    uint32_t flags = 0;
+    //index into Scene::drawBuckets
+    uint32_t bucket = 0;
+    //the bucket's firstInstance,compacted commands of the bucket are written from there
+    uint32_t bucketStart = 0;
+};
+//draw instances sharing a pipeline variant,drawInstances are sorted by variant and then by material,
+//so every bucket is a contiguous range and is drawn with one pipeline bind
+struct DrawBucket{
+    uint32_t pipelineVariant = 0;
+    uint32_t firstInstance = 0;
+    uint32_t instanceCount = 0;
+};
+//skinned and morphed primitives leave their rest pose bounds,so they are never culled
+#define DRAW_INSTANCE_NEVER_CULL 1
+struct Skin{
+    //glTF node indices,resolved through Scene::nodeTransforms
+    std::vector<int> joints;
+    std::vector<glm::mat4> inverseBindMatrices;
+};
+//a mesh node using a skin,its joint matrices start at jointOffset
+struct SkinInstance{
+    int skin;
+    uint32_t meshTransform;
+    uint32_t jointOffset;
+};
+//morph weights of a mesh node are morphWeights[weightOffset,weightOffset+weightCount)
+struct MorphInstance{
+    uint32_t weightOffset = 0;
+    uint32_t weightCount = 0;
+};
+//milliseconds spent in every stage of Scene::loadFile,and the amount of data the stages went through
+struct LoadStats{
+    double parse = 0;
+    //reading the .bin files
+    double buffers = 0;
+    double imageDecode = 0;
+    //creating and uploading texture images
+    double textures = 0;
+    //descriptor set layouts and sets,material uniform buffers
+    double materials = 0;
+    //loadNode,loadMesh and loadPrimitive,plus the transform hierarchy
+    double nodes = 0;
+    //skins and animations
+    double animations = 0;
+    //vertex,index,deform and modelMat buffers
+    double bufferUploads = 0;
+    //readFile and upload,without any time between the two
+    double total = 0;
+    size_t jsonBytes = 0;
+    size_t bufferBytes = 0;
+    //decoded pixels
+    size_t imageBytes = 0;
+    //contents of vertex,index,deform and modelMat buffers
+    size_t uploadBytes = 0;
+};
+//what a Scene keeps in CPU memory once loadFile has uploaded everything
+enum class Residency{
+    //vertices,indexs,deformVertices,morphDeltas and the glTF document are dropped,
+    //only counts and bounds stay
+    eGpuOnly,
+    //everything is kept for CPU side queries
+    eKeepCpuCopies,
+};
 class Scene{
 public:
-    Scene(Renderer* renderer);
+    Scene(Renderer* renderer,Residency residency = Residency::eGpuOnly);
     ~Scene();
     bool loaded = false;
+    //readFile followed by upload
     void loadFile(const char* path);
+    //the first half of loadFile:parse the JSON,read the buffers and decode the images.
+    //touches neither the renderer nor Vulkan,so it may run on another thread than the one rendering
+    void readFile(const char* path);
+    //the second half of loadFile:create and upload everything the renderer needs,after readFile
+    void upload();
     void cleanup();
+    //propagate changed node transforms into modelMats,returns true if any modelMat changed
+    bool updateTransforms(ThreadPool* pool = nullptr);
+    //advance the active animation and propagate it into modelMats,jointMatrices and morphWeights,returns false if nothing is playing
+    bool updateAnimations(float deltaTime,ThreadPool* pool = nullptr);
+    //bring copy of modelMatsBuffer up to date with modelMats,the GPU must not be reading that copy
+    void flushModelMats(uint32_t copy);
+    //byte offset of a copy of modelMatsBuffer,the dynamic offset of modelMatsDescriptorSet
+    uint32_t getModelMatsOffset(uint32_t copy) const {return (uint32_t)(copy*modelMatsStride);}
+    //recompute jointMatrices from the current transforms
+    void updateJointMatrices();
+    //queue a texture or material for release,callable from any thread.
+    //handles to it go stale once processReleases ran,materials using a released texture stop sampling it
+    //and primitives using a released material fall back to the default material.
+    void releaseTexture(TextureHandle texture);
+    void releaseMaterial(MaterialHandle material);
+    bool hasPendingReleases();
+    //destroy queued textures and materials,the GPU must not be using the scene
+    void processReleases();
+    //the parsed document,empty once loaded unless residency is eKeepCpuCopies
+    const glTF::Model& getglTFModel() const {return glTFmodel;}
 private:
-    Texture* loadTexture(tinygltf::Texture& glTFtexture,int index);
-    Material* loadMaterial(tinygltf::Material& glTFmaterial,int index);
+    void uploadMaterialProperties(Material& material);
+    void loadTexture(glTF::Texture& glTFtexture,int index);
+    void loadMaterial(glTF::Material& glTFmaterial,int index);
+    uint32_t getPipelineVariant(MaterialHandle material);
+    //sort drawInstances into drawBuckets
+    void buildDrawBuckets();
 
-    Node* loadNode(tinygltf::Node& glTFnode,Node* parent);
-    Mesh* loadMesh(tinygltf::Mesh& glTFmesh,Node* parent);
-    Primitive* loadPrimitive(tinygltf::Primitive& glTFprimitivem,int modelMatID);
+    void loadNode(glTF::Node& glTFnode,int index,int parent);
+    MeshHandle loadMesh(glTF::Mesh& glTFmesh,int node,int jointOffset,int weightOffset);
+    void loadPrimitive(glTF::Primitive& glTFprimitivem,int modelMatID,int jointOffset,int weightOffset);
+    void loadSkin(glTF::Skin& glTFskin,Skin& skin);
+    void loadAnimation(glTF::Animation& glTFanimation,Animation& animation);
 public:
-    std::vector<Texture*> textures;
-    std::vector<Material*> materials;
-    std::vector<Node*> rtNodes;
+    Pool<Texture> textures;
+    Pool<Material> materials;
+    Pool<Mesh> meshes;
+    //handles of the glTF textures and materials,by glTF index
+    std::vector<TextureHandle> glTFTextures;
+    std::vector<MaterialHandle> glTFMaterials;
+    //the node graph is placed contiguously in arena,unloading drops it with a single reset
+    Arena arena;
+    //indexed like the glTF nodes,nodes outside the default scene stay default
+    ArenaArray<Node> nodes;
+    ArenaArray<uint32_t> nodeChildren;
+    ArenaArray<Primitive> primitives;
+    std::vector<uint32_t> rtNodes;
+    Residency residency;
+    //filled by readFile and upload
+    LoadStats loadStats;
+    //CPU copies of the geometry,empty after loadFile unless residency is eKeepCpuCopies
     std::vector<uint32_t> indexs;
     std::vector<Vertex> vertices;
+    //element counts of the uploaded buffers,valid whatever the residency
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    uint32_t deformVertexCount = 0;
+    uint32_t morphDeltaCount = 0;
+    uint32_t drawInstanceCount = 0;
+    //world space bounds of every primitive in the rest pose
+    glm::vec3 boundsMin = {};
+    glm::vec3 boundsMax = {};
     std::vector<ModelMatrix> modelMats;
+    //the transform node of every modelMat
+    std::vector<uint32_t> modelMatNodes;
+    std::vector<uint32_t> changedModelMats;
+    //per copy of modelMatsBuffer,matrices changed while other copies were flushed
+    std::vector<std::vector<uint32_t>> staleModelMats;
+    TransformHierarchy transforms;
+    //transform index of every glTF node,-1 for nodes outside the default scene
+    std::vector<int> nodeTransforms;
+
+    std::vector<Skin> skins;
+    std::vector<SkinInstance> skinInstances;
+    std::vector<glm::mat4> jointMatrices;
+
+    //morph instance of every glTF node,weightCount is 0 for nodes without morph targets
+    std::vector<MorphInstance> nodeMorphs;
+    //CPU copy,see indexs
+    std::vector<MorphDelta> morphDeltas;
+    std::vector<float> morphWeights;
+
+    //CPU copy,see indexs
+    std::vector<DeformVertex> deformVertices;
+    //one per indexed primitive,CPU copy,see indexs
+    std::vector<DrawInstance> drawInstances;
+    //kept whatever the residency
+    std::vector<DrawBucket> drawBuckets;
+
+    std::vector<Animation> animations;
+    int activeAnimation = -1;
+    bool animationPlaying = true;
+    float animationTime = 0;
+    float animationUpdateTime = 0;
+private:
+    //per draw instance while loading,pipeline variant in the high and material slot+1 in the low 32 bits
+    std::vector<uint64_t> drawInstanceKeys;
+private:
+    std::mutex releaseMutex;
+    std::vector<TextureHandle> pendingTextureReleases;
+    std::vector<MaterialHandle> pendingMaterialReleases;
 private:
-    tinygltf::Model glTFmodel;
+    //dropped after loadFile unless residency is eKeepCpuCopies
+    glTF::Model glTFmodel;
 private:
     Renderer* renderer;
 public:
     vk::DescriptorSetLayout materialDescriptorSetLayout;
     vk::DescriptorSet materialDescriptorSet;
+    //bound in the slots of released materials
+    vk::Buffer defaultMaterialBuffer;
+    GpuAllocation defaultMaterialBufferMemory;
 
     vk::DescriptorSetLayout modelMatsDescriptorSetLayout;
     vk::DescriptorSet modelMatsDescriptorSet;
     vk::Buffer modelMatsBuffer;
-    vk::DeviceMemory modelMatsBufferMemory;
+    GpuAllocation modelMatsBufferMemory;
+    //modelMats is host visible and stays mapped,so animated matrices are written in place.
+    //it holds a copy per frame in flight,modelMatsStride bytes apart
+    ModelMatrix* modelMatsMapped = nullptr;
+    uint32_t modelMatsCopyCount = 1;
+    vk::DeviceSize modelMatsStride = 0;
 
     vk::Buffer vertexBuffer;
-    vk::DeviceMemory vertexBufferMemory;
+    GpuAllocation vertexBufferMemory;
 
     vk::Buffer indexBuffer;
-    vk::DeviceMemory indexBufferMemory;
+    GpuAllocation indexBufferMemory;
+
+    //only created when drawInstances is not empty
+    vk::Buffer drawInstanceBuffer;
+    GpuAllocation drawInstanceBufferMemory;
+
+    vk::Buffer deformVertexBuffer;
+    GpuAllocation deformVertexBufferMemory;
+    vk::Buffer morphDeltaBuffer;
+    GpuAllocation morphDeltaBufferMemory;
 };
 }
 #endif
\ No newline at end of file
@@ -1,5 +1,12 @@
 #version 450
 #define MAX_MATERIAL_COUNT 128
+//vkglTF::AlphaMode
+#define ALPHA_OPAQUE 0
+#define ALPHA_MASK 1
+#define ALPHA_BLEND 2
+//set per pipeline variant,so opaque materials and materials without textures skip the branches
+layout(constant_id=0) const int ALPHA_MODE = ALPHA_OPAQUE;
+layout(constant_id=1) const bool BASE_COLOR_TEXTURE = true;
 layout(location=1) in vec3 inNormal;
 layout(location=2) in vec3 inTangent;
 layout(location=3) in vec2 inUV0;
@@ -18,6 +25,7 @@ layout(set=1,binding=0) uniform MaterialProperties{
     int texCoord_normal;
     int texCoord_occlusion;
     int texCoord_emissive;
+    float alphaCutoff;
 } mateiralProps[MAX_MATERIAL_COUNT];
 layout(set=1,binding=1) uniform sampler2D baseColorTextures[MAX_MATERIAL_COUNT];
 layout(set=1,binding=2) uniform sampler2D metallicRoughnessTextures[MAX_MATERIAL_COUNT];
@@ -29,12 +37,22 @@ layout(location=0) out vec4 outColor;
 void main(){
     vec2 uv[2] = {inUV0,inUV1};
     vec4 color;
-    if(mateiralProps[inMaterialID].texCoord_baseColor>-1){
+    //released textures still reset texCoord_baseColor
+    if(BASE_COLOR_TEXTURE&&mateiralProps[inMaterialID].texCoord_baseColor>-1){
         color = texture(baseColorTextures[inMaterialID],uv[mateiralProps[inMaterialID].texCoord_baseColor]);
     }
     else{
         color = mateiralProps[inMaterialID].basColorFactor;
     }
+    if(ALPHA_MODE==ALPHA_MASK){
+        if(color.a<mateiralProps[inMaterialID].alphaCutoff){
+            discard;
+        }
+        color.a = 1.0;
+    }
+    else if(ALPHA_MODE==ALPHA_OPAQUE){
+        color.a = 1.0;
+    }
     //color = vec4(inNormal/2+0.5,1);
     outColor = color;
 }
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 450
+layout(location=0) in vec2 inUV;
+layout(location=0) out vec4 outColor;
+
+layout(set=0,binding=0) uniform sampler2D sceneColor;
+layout(push_constant) uniform PC{
+    //renderExtent/sceneExtent,the scene only covers that corner of the target
+    vec2 uvScale;
+    //the last texel center of the corner,so filtering doesn't reach into the clear color around it
+    vec2 uvMax;
+};
+void main(){
+    outColor = texture(sceneColor,min(inUV*uvScale,uvMax));
+}
@@ -0,0 +1,310 @@
+#include"allocator.h"
+
+#include<algorithm>
+#include<stdexcept>
+
+static uint32_t ceilLog2(vk::DeviceSize value)
+{
+    uint32_t result = 0;
+    while((vk::DeviceSize(1)<<result)<value){
+        ++result;
+    }
+    return result;
+}
+
+static vk::DeviceSize alignUp(vk::DeviceSize value,vk::DeviceSize alignment)
+{
+    return (value+alignment-1)/alignment*alignment;
+}
+
+void GpuAllocator::init(vk::PhysicalDevice physicalDevice,vk::Device device)
+{
+    this->device = device;
+    memoryProperties = physicalDevice.getMemoryProperties();
+    maxDeviceMemoryCount = physicalDevice.getProperties().limits.maxMemoryAllocationCount;
+}
+
+void GpuAllocator::cleanup()
+{
+    for(auto& pool:pools){
+        for(auto& block:pool.blocks){
+            if(block.memory){
+                device.freeMemory(block.memory);
+            }
+        }
+    }
+    pools.clear();
+    deviceMemoryCount = 0;
+}
+
+GpuAllocation GpuAllocator::allocate(const vk::MemoryRequirements& requirements,vk::MemoryPropertyFlags props,
+                                     AllocationStrategy strategy,vk::Image image)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits,props);
+    int poolIndex = strategy==AllocationStrategy::eDedicated?-1:findPool(memoryType,strategy,bool(image));
+    //anything taking more than half a block would mostly waste it
+    if(poolIndex<0||std::max(requirements.size,requirements.alignment)>pools[poolIndex].blockSize/2){
+        return allocateDedicated(requirements,memoryType,image);
+    }
+    Pool& pool = pools[poolIndex];
+    GpuAllocation allocation;
+    allocation.pool = poolIndex;
+    allocation.size = requirements.size;
+    if(pool.strategy==AllocationStrategy::eBuddy){
+        //a size class aligned to its own size also satisfies any smaller alignment
+        vk::DeviceSize size = std::max({requirements.size,requirements.alignment,(vk::DeviceSize)GPU_MIN_ALLOCATION_SIZE});
+        uint32_t order = ceilLog2((size+GPU_MIN_ALLOCATION_SIZE-1)/GPU_MIN_ALLOCATION_SIZE);
+        bool allocated = false;
+        for(int i=0;i<pool.blocks.size()&&!allocated;++i){
+            allocated = pool.blocks[i].memory&&allocateBuddy(pool,i,order,allocation);
+        }
+        if(!allocated){
+            allocateBuddy(pool,createBlock(pool),order,allocation);
+        }
+    }
+    else{
+        bool allocated = false;
+        for(int i=0;i<pool.blocks.size()&&!allocated;++i){
+            allocated = pool.blocks[i].memory&&allocateLinear(pool,i,requirements,allocation);
+        }
+        if(!allocated){
+            allocateLinear(pool,createBlock(pool),requirements,allocation);
+        }
+    }
+    Block& block = pool.blocks[allocation.block];
+    block.allocationCount++;
+    block.requestedBytes += requirements.size;
+    allocation.memory = block.memory;
+    allocation.mapped = block.mapped?block.mapped+allocation.offset:nullptr;
+    return allocation;
+}
+
+void GpuAllocator::free(GpuAllocation& allocation)
+{
+    if(!allocation.memory){
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if(allocation.pool<0){
+        device.freeMemory(allocation.memory);
+        deviceMemoryCount--;
+        dedicatedCount--;
+        dedicatedBytes -= allocation.size;
+        allocation = {};
+        return;
+    }
+    Pool& pool = pools[allocation.pool];
+    Block& block = pool.blocks[allocation.block];
+    block.allocationCount--;
+    block.requestedBytes -= allocation.size;
+    if(pool.strategy==AllocationStrategy::eBuddy){
+        vk::DeviceSize offset = allocation.offset;
+        uint32_t order = allocation.order;
+        block.usedBytes -= vk::DeviceSize(GPU_MIN_ALLOCATION_SIZE)<<order;
+        //merge with free buddies as far up as possible
+        while(order<pool.maxOrder){
+            vk::DeviceSize buddy = offset^(vk::DeviceSize(GPU_MIN_ALLOCATION_SIZE)<<order);
+            auto it = block.freeLists[order].find(buddy);
+            if(it==block.freeLists[order].end()){
+                break;
+            }
+            block.freeLists[order].erase(it);
+            offset = std::min(offset,buddy);
+            ++order;
+        }
+        block.freeLists[order].insert(offset);
+    }
+    else if(block.allocationCount==0){
+        //every transient allocation of the block is gone,start over from its beginning
+        block.head = 0;
+        block.usedBytes = 0;
+    }
+    if(block.allocationCount==0){
+        releaseBlock(pool,allocation.block);
+    }
+    allocation = {};
+}
+
+GpuAllocatorStats GpuAllocator::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    GpuAllocatorStats stats;
+    for(auto& pool:pools){
+        GpuPoolStats poolStats;
+        poolStats.memoryType = pool.memoryType;
+        poolStats.strategy = pool.strategy;
+        poolStats.image = pool.image;
+        for(auto& block:pool.blocks){
+            if(!block.memory){
+                continue;
+            }
+            poolStats.blockCount++;
+            poolStats.allocationCount += block.allocationCount;
+            poolStats.blockBytes += pool.blockSize;
+            poolStats.usedBytes += block.usedBytes;
+            poolStats.requestedBytes += block.requestedBytes;
+            vk::DeviceSize largest = 0;
+            if(pool.strategy==AllocationStrategy::eBuddy){
+                for(int order=pool.maxOrder;order>=0;--order){
+                    if(block.freeLists[order].size()){
+                        largest = vk::DeviceSize(GPU_MIN_ALLOCATION_SIZE)<<order;
+                        break;
+                    }
+                }
+            }
+            else{
+                largest = pool.blockSize-block.head;
+            }
+            poolStats.largestFreeRange = std::max(poolStats.largestFreeRange,largest);
+        }
+        vk::DeviceSize freeBytes = poolStats.blockBytes-poolStats.usedBytes;
+        poolStats.fragmentation = freeBytes?1.0f-float(poolStats.largestFreeRange)/float(freeBytes):0.0f;
+        stats.pools.push_back(poolStats);
+    }
+    stats.dedicatedCount = dedicatedCount;
+    stats.dedicatedBytes = dedicatedBytes;
+    stats.deviceMemoryCount = deviceMemoryCount;
+    stats.maxDeviceMemoryCount = maxDeviceMemoryCount;
+    return stats;
+}
+
+uint32_t GpuAllocator::findMemoryType(uint32_t memoryTypeBits,vk::MemoryPropertyFlags props)
+{
+    for(uint32_t i=0;i<memoryProperties.memoryTypeCount;++i){
+        vk::MemoryType type = memoryProperties.memoryTypes[i];
+        if((type.propertyFlags&props)==props&&((1<<i)&memoryTypeBits)){
+            return i;
+        }
+    }
+    throw std::runtime_error("failed to find a suitable memory type!");
+}
+
+int GpuAllocator::findPool(uint32_t memoryType,AllocationStrategy strategy,bool image)
+{
+    for(int i=0;i<pools.size();++i){
+        if(pools[i].memoryType==memoryType&&pools[i].strategy==strategy&&pools[i].image==image){
+            return i;
+        }
+    }
+    Pool pool;
+    pool.memoryType = memoryType;
+    pool.strategy = strategy;
+    pool.image = image;
+    //small heaps(host visible device local memory on some GPUs) get smaller blocks
+    vk::DeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+    uint32_t maxOrder = ceilLog2(GPU_BLOCK_SIZE/GPU_MIN_ALLOCATION_SIZE);
+    while(maxOrder>0&&(vk::DeviceSize(GPU_MIN_ALLOCATION_SIZE)<<maxOrder)>heapSize/8){
+        --maxOrder;
+    }
+    pool.maxOrder = maxOrder;
+    pool.blockSize = vk::DeviceSize(GPU_MIN_ALLOCATION_SIZE)<<maxOrder;
+    pools.push_back(pool);
+    return pools.size()-1;
+}
+
+int GpuAllocator::createBlock(Pool& pool)
+{
+    int index = 0;
+    while(index<pool.blocks.size()&&pool.blocks[index].memory){
+        ++index;
+    }
+    if(index==pool.blocks.size()){
+        pool.blocks.emplace_back();
+    }
+    Block& block = pool.blocks[index];
+    void* mapped = nullptr;
+    block.memory = allocateDeviceMemory(pool.blockSize,pool.memoryType,&mapped);
+    block.mapped = reinterpret_cast<char*>(mapped);
+    if(pool.strategy==AllocationStrategy::eBuddy){
+        block.freeLists.assign(pool.maxOrder+1,{});
+        block.freeLists[pool.maxOrder].insert(0);
+    }
+    return index;
+}
+
+void GpuAllocator::releaseBlock(Pool& pool,int block)
+{
+    //one empty block per pool is kept around,so load/unload loops don't allocate every time
+    int liveBlocks = 0;
+    for(auto& b:pool.blocks){
+        liveBlocks += b.memory?1:0;
+    }
+    if(liveBlocks<2){
+        return;
+    }
+    device.freeMemory(pool.blocks[block].memory);
+    deviceMemoryCount--;
+    pool.blocks[block] = Block();
+}
+
+bool GpuAllocator::allocateBuddy(Pool& pool,int blockIndex,uint32_t order,GpuAllocation& allocation)
+{
+    Block& block = pool.blocks[blockIndex];
+    uint32_t freeOrder = order;
+    while(freeOrder<=pool.maxOrder&&block.freeLists[freeOrder].empty()){
+        ++freeOrder;
+    }
+    if(freeOrder>pool.maxOrder){
+        return false;
+    }
+    //lowest offset first keeps the block packed towards its beginning
+    vk::DeviceSize offset = *block.freeLists[freeOrder].begin();
+    block.freeLists[freeOrder].erase(block.freeLists[freeOrder].begin());
+    //split down to the wanted size class,the upper halves become free
+    while(freeOrder>order){
+        --freeOrder;
+        block.freeLists[freeOrder].insert(offset+(vk::DeviceSize(GPU_MIN_ALLOCATION_SIZE)<<freeOrder));
+    }
+    block.usedBytes += vk::DeviceSize(GPU_MIN_ALLOCATION_SIZE)<<order;
+    allocation.block = blockIndex;
+    allocation.order = order;
+    allocation.offset = offset;
+    return true;
+}
+
+bool GpuAllocator::allocateLinear(Pool& pool,int blockIndex,const vk::MemoryRequirements& requirements,GpuAllocation& allocation)
+{
+    Block& block = pool.blocks[blockIndex];
+    vk::DeviceSize offset = alignUp(block.head,requirements.alignment);
+    if(offset+requirements.size>pool.blockSize){
+        return false;
+    }
+    block.usedBytes += offset+requirements.size-block.head;
+    block.head = offset+requirements.size;
+    allocation.block = blockIndex;
+    allocation.offset = offset;
+    return true;
+}
+
+GpuAllocation GpuAllocator::allocateDedicated(const vk::MemoryRequirements& requirements,uint32_t memoryType,vk::Image image)
+{
+    GpuAllocation allocation;
+    allocation.memory = allocateDeviceMemory(requirements.size,memoryType,&allocation.mapped,image);
+    allocation.size = requirements.size;
+    dedicatedCount++;
+    dedicatedBytes += requirements.size;
+    return allocation;
+}
+
+vk::DeviceMemory GpuAllocator::allocateDeviceMemory(vk::DeviceSize size,uint32_t memoryType,void** mapped,vk::Image image)
+{
+    if(deviceMemoryCount>=maxDeviceMemoryCount){
+        throw std::runtime_error("too many device memory allocations!");
+    }
+    vk::MemoryAllocateInfo allocateInfo;
+    allocateInfo.setAllocationSize(size);
+    allocateInfo.setMemoryTypeIndex(memoryType);
+    vk::MemoryDedicatedAllocateInfo dedicatedInfo;
+    if(image){
+        dedicatedInfo.setImage(image);
+        allocateInfo.setPNext(&dedicatedInfo);
+    }
+    vk::DeviceMemory memory = device.allocateMemory(allocateInfo);
+    deviceMemoryCount++;
+    *mapped = nullptr;
+    if(memoryProperties.memoryTypes[memoryType].propertyFlags&vk::MemoryPropertyFlagBits::eHostVisible){
+        *mapped = device.mapMemory(memory,0,size);
+    }
+    return memory;
+}
@@ -0,0 +1,203 @@
+#include"animation.h"
+#include"transform.h"
+#include"threadpool.h"
+#include"simdmath.h"
+
+#include<cmath>
+#include<cstring>
+namespace vkglTF{
+
+//samplers per worker chunk
+#define ANIMATION_GRAIN_SIZE 256
+
+//out = a+(b-a)*t over count floats,count is a multiple of 4
+static inline void lerpKeys(const float* a,const float* b,float t,float* out,uint32_t count)
+{
+#if defined(VKGLTF_SSE)
+    __m128 vt = _mm_set1_ps(t);
+    for(uint32_t i=0;i<count;i+=4){
+        __m128 va = _mm_loadu_ps(a+i);
+        __m128 vb = _mm_loadu_ps(b+i);
+        _mm_storeu_ps(out+i,_mm_add_ps(va,_mm_mul_ps(_mm_sub_ps(vb,va),vt)));
+    }
+#else
+    for(uint32_t i=0;i<count;++i){
+        out[i] = a[i]+(b[i]-a[i])*t;
+    }
+#endif
+}
+
+//glTF cubic hermite spline,tangents are scaled by the segment length here
+static inline void hermiteKeys(const float* v0,const float* outTangent0,const float* v1,const float* inTangent1,
+                               float t,float segment,float* out,uint32_t count)
+{
+    float t2 = t*t;
+    float t3 = t2*t;
+    float h00 = 2*t3-3*t2+1;
+    float h10 = (t3-2*t2+t)*segment;
+    float h01 = -2*t3+3*t2;
+    float h11 = (t3-t2)*segment;
+#if defined(VKGLTF_SSE)
+    __m128 w00 = _mm_set1_ps(h00);
+    __m128 w10 = _mm_set1_ps(h10);
+    __m128 w01 = _mm_set1_ps(h01);
+    __m128 w11 = _mm_set1_ps(h11);
+    for(uint32_t i=0;i<count;i+=4){
+        __m128 r = _mm_mul_ps(_mm_loadu_ps(v0+i),w00);
+        r = _mm_add_ps(r,_mm_mul_ps(_mm_loadu_ps(outTangent0+i),w10));
+        r = _mm_add_ps(r,_mm_mul_ps(_mm_loadu_ps(v1+i),w01));
+        r = _mm_add_ps(r,_mm_mul_ps(_mm_loadu_ps(inTangent1+i),w11));
+        _mm_storeu_ps(out+i,r);
+    }
+#else
+    for(uint32_t i=0;i<count;++i){
+        out[i] = v0[i]*h00+outTangent0[i]*h10+v1[i]*h01+inTangent1[i]*h11;
+    }
+#endif
+}
+
+static inline void normalizeQuat(float* q)
+{
+#if defined(VKGLTF_SSE)
+    __m128 v = _mm_loadu_ps(q);
+    __m128 d = _mm_mul_ps(v,v);
+    d = _mm_add_ps(d,_mm_shuffle_ps(d,d,_MM_SHUFFLE(2,3,0,1)));
+    d = _mm_add_ps(d,_mm_shuffle_ps(d,d,_MM_SHUFFLE(1,0,3,2)));
+    _mm_storeu_ps(q,_mm_div_ps(v,_mm_sqrt_ps(d)));
+#else
+    float length = std::sqrt(q[0]*q[0]+q[1]*q[1]+q[2]*q[2]+q[3]*q[3]);
+    for(int i=0;i<4;++i){
+        q[i] /= length;
+    }
+#endif
+}
+
+//shortest path slerp,falls back to a normalized lerp when the quaternions are nearly parallel
+static inline void slerpQuat(const float* a,const float* b,float t,float* out)
+{
+    float cosTheta = a[0]*b[0]+a[1]*b[1]+a[2]*b[2]+a[3]*b[3];
+    float sign = 1.0f;
+    if(cosTheta<0){
+        cosTheta = -cosTheta;
+        sign = -1.0f;
+    }
+    float wa,wb;
+    if(cosTheta>0.9995f){
+        wa = 1.0f-t;
+        wb = t*sign;
+    }
+    else{
+        float theta = std::acos(cosTheta);
+        float invSin = 1.0f/std::sin(theta);
+        wa = std::sin((1.0f-t)*theta)*invSin;
+        wb = std::sin(t*theta)*invSin*sign;
+    }
+#if defined(VKGLTF_SSE)
+    __m128 r = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a),_mm_set1_ps(wa)),_mm_mul_ps(_mm_loadu_ps(b),_mm_set1_ps(wb)));
+    _mm_storeu_ps(out,r);
+#else
+    for(int i=0;i<4;++i){
+        out[i] = a[i]*wa+b[i]*wb;
+    }
+#endif
+    normalizeQuat(out);
+}
+
+void Animation::evaluate(float time,TransformHierarchy& transforms,std::vector<float>& morphWeights,ThreadPool* pool)
+{
+    if(samplers.empty()){
+        return;
+    }
+    if(cursors.size()!=samplers.size()){
+        cursors.assign(samplers.size(),0);
+        results.assign(samplers.back().resultOffset+samplers.back().stride,0.0f);
+    }
+    float length = duration();
+    float localTime = length>0?start+std::fmod(time,length):start;
+    if(pool&&samplers.size()>ANIMATION_GRAIN_SIZE){
+        pool->parallelFor(samplers.size(),ANIMATION_GRAIN_SIZE,[&](uint32_t begin,uint32_t end){
+            for(uint32_t i=begin;i<end;++i){
+                evaluateSampler(i,localTime);
+            }
+        });
+    }
+    else{
+        for(uint32_t i=0;i<samplers.size();++i){
+            evaluateSampler(i,localTime);
+        }
+    }
+    //several channels may target one node,so results are written back on this thread
+    for(auto& channel:channels){
+        const float* r = results.data()+samplers[channel.sampler].resultOffset;
+        switch(channel.path){
+            case AnimationPath::eTranslation:
+                transforms.setTranslation(channel.target,glm::vec3(r[0],r[1],r[2]));
+                break;
+            case AnimationPath::eRotation:
+                transforms.setRotation(channel.target,glm::quat(r[3],r[0],r[1],r[2]));
+                break;
+            case AnimationPath::eScale:
+                transforms.setScale(channel.target,glm::vec3(r[0],r[1],r[2]));
+                break;
+            case AnimationPath::eWeights:
+                std::memcpy(morphWeights.data()+channel.target,r,channel.weightCount*sizeof(float));
+                break;
+        }
+    }
+}
+
+void Animation::evaluateSampler(uint32_t samplerIndex,float time)
+{
+    const AnimationSampler& sampler = samplers[samplerIndex];
+    const float* keyTimes = times.data()+sampler.timeOffset;
+    const float* keyValues = values.data()+sampler.valueOffset;
+    float* out = results.data()+sampler.resultOffset;
+    uint32_t stride = sampler.stride;
+    //cubic spline keys are stored as in tangent,value,out tangent
+    uint32_t keyStride = sampler.interpolation==Interpolation::eCubicSpline?3*stride:stride;
+    uint32_t valueInKey = sampler.interpolation==Interpolation::eCubicSpline?stride:0;
+    uint32_t last = sampler.keyCount-1;
+
+    if(sampler.keyCount==1||time<=keyTimes[0]){
+        std::memcpy(out,keyValues+valueInKey,stride*sizeof(float));
+        return;
+    }
+    if(time>=keyTimes[last]){
+        std::memcpy(out,keyValues+last*keyStride+valueInKey,stride*sizeof(float));
+        return;
+    }
+    uint32_t k = cursors[samplerIndex];
+    if(k>=last||time<keyTimes[k]){
+        //looped or jumped backwards
+        k = 0;
+    }
+    while(time>=keyTimes[k+1]){
+        ++k;
+    }
+    cursors[samplerIndex] = k;
+
+    float segment = keyTimes[k+1]-keyTimes[k];
+    float t = (time-keyTimes[k])/segment;
+    const float* key0 = keyValues+k*keyStride;
+    const float* key1 = key0+keyStride;
+    switch(sampler.interpolation){
+        case Interpolation::eStep:
+            std::memcpy(out,key0,stride*sizeof(float));
+            break;
+        case Interpolation::eLinear:
+            if(sampler.isRotation){
+                slerpQuat(key0,key1,t,out);
+            }
+            else{
+                lerpKeys(key0,key1,t,out,stride);
+            }
+            break;
+        case Interpolation::eCubicSpline:
+            hermiteKeys(key0+stride,key0+2*stride,key1+stride,key1,t,segment,out,stride);
+            if(sampler.isRotation){
+                normalizeQuat(out);
+            }
+            break;
+    }
+}
+}
@@ -0,0 +1,55 @@
+#include"arena.h"
+
+#include<algorithm>
+namespace vkglTF{
+
+Arena::Arena(size_t blockSize):blockSize(blockSize)
+{
+
+}
+
+Arena::~Arena()
+{
+    for(auto& block:blocks){
+        delete[] block.data;
+    }
+}
+
+void Arena::reset()
+{
+    if(blocks.size()>1){
+        //the next scene of the same size fits into one block
+        size_t total = getReservedBytes();
+        for(auto& block:blocks){
+            delete[] block.data;
+        }
+        blocks.clear();
+        blocks.push_back({new char[total],total});
+    }
+    head = 0;
+    usedBytes = 0;
+}
+
+size_t Arena::getReservedBytes() const
+{
+    size_t total = 0;
+    for(auto& block:blocks){
+        total += block.size;
+    }
+    return total;
+}
+
+void* Arena::allocateBytes(size_t size,size_t alignment)
+{
+    size_t offset = (head+alignment-1)&~(alignment-1);
+    if(blocks.empty()||offset+size>blocks.back().size){
+        //new[] memory is aligned for any fundamental type
+        size_t newSize = std::max(blockSize,size);
+        blocks.push_back({new char[newSize],newSize});
+        offset = 0;
+    }
+    head = offset+size;
+    usedBytes += size;
+    return blocks.back().data+offset;
+}
+}
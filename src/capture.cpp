@@ -0,0 +1,205 @@
+#include"capture.h"
+#include"renderer.h"
+#include"threadpool.h"
+#include"stb_image_write.h"
+#include"trace.h"
+
+#include<filesystem>
+#include<chrono>
+#include<cstring>
+#include<cstdio>
+#include<iostream>
+
+FrameCapture::FrameCapture(Renderer* renderer,const CaptureOptions& options):renderer(renderer),options(options)
+{
+    vk::Format format = renderer->swapchainDetails.format.format;
+    bool rgba = format==vk::Format::eR8G8B8A8Srgb||format==vk::Format::eR8G8B8A8Unorm;
+    bool bgra = format==vk::Format::eB8G8R8A8Srgb||format==vk::Format::eB8G8R8A8Unorm;
+    if(!rgba&&!bgra){
+        throw std::runtime_error("capture needs 8 bit RGBA or BGRA images!");
+    }
+    swizzle = bgra;
+    std::filesystem::create_directories(options.directory);
+    encoders = new vkglTF::ThreadPool(CAPTURE_ENCODER_THREADS);
+    initSlots();
+}
+
+FrameCapture::~FrameCapture()
+{
+    flush();
+    delete encoders;
+    destroySlots();
+    std::cout<<stats.written<<" frames captured into "<<options.directory<<","<<stats.dropped<<" dropped,"
+    <<stats.failed<<" failed to write\n";
+}
+
+void FrameCapture::initSlots()
+{
+    extent = renderer->swapchainDetails.extent;
+    vk::DeviceSize size = vk::DeviceSize(extent.width)*extent.height*4;
+    slots = std::vector<Slot>(CAPTURE_RING_SIZE);
+    for(auto& slot:slots){
+        vk::BufferCreateInfo bufferInfo;
+        bufferInfo.setSize(size);
+        bufferInfo.setUsage(vk::BufferUsageFlagBits::eTransferDst);
+        bufferInfo.setSharingMode(vk::SharingMode::eExclusive);
+        slot.buffer = renderer->lDevice.createBuffer(bufferInfo);
+        vk::MemoryRequirements requirements = renderer->lDevice.getBufferMemoryRequirements(slot.buffer);
+        //the encoders read every byte,uncached memory would make that many times slower.
+        //dedicated,power of two size classes would nearly double a 1080p image
+        try{
+            slot.memory = renderer->allocator.allocate(requirements,
+            vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent|vk::MemoryPropertyFlagBits::eHostCached,
+            AllocationStrategy::eDedicated);
+        }
+        catch(std::runtime_error){
+            slot.memory = renderer->allocator.allocate(requirements,
+            vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent,AllocationStrategy::eDedicated);
+        }
+        renderer->lDevice.bindBufferMemory(slot.buffer,slot.memory.memory,slot.memory.offset);
+    }
+}
+
+void FrameCapture::destroySlots()
+{
+    for(auto& slot:slots){
+        renderer->destroyBuffer(slot.buffer,slot.memory);
+    }
+    slots.clear();
+}
+
+void FrameCapture::collect(uint32_t frame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for(uint32_t i=0;i<slots.size();++i){
+        if(slots[i].state==SlotState::eCopying&&slots[i].frame==frame){
+            slots[i].state = SlotState::eEncoding;
+            encoders->submit([this,i](){encode(i);});
+        }
+    }
+}
+
+void FrameCapture::record(vk::CommandBuffer commandBuffer,uint32_t frame,vk::Image image,vk::ImageLayout layout,uint64_t frameNumber)
+{
+    Slot* slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto& candidate:slots){
+            if(candidate.state==SlotState::eFree){
+                slot = &candidate;
+                break;
+            }
+        }
+        if(!slot){
+            ++stats.dropped;
+            return;
+        }
+        slot->state = SlotState::eCopying;
+        slot->frame = frame;
+        slot->frameNumber = frameNumber;
+        ++stats.captured;
+    }
+    vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor,0,1,0,1);
+    vk::ImageMemoryBarrier imageBarrier;
+    imageBarrier.setImage(image);
+    imageBarrier.setSubresourceRange(range);
+    imageBarrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    imageBarrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    imageBarrier.setOldLayout(layout);
+    imageBarrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+    imageBarrier.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+    imageBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,vk::PipelineStageFlagBits::eTransfer,
+    vk::DependencyFlags(0),{},{},imageBarrier);
+
+    vk::BufferImageCopy region;
+    region.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor,0,0,1));
+    region.setImageExtent(vk::Extent3D(extent.width,extent.height,1));
+    commandBuffer.copyImageToBuffer(image,vk::ImageLayout::eTransferSrcOptimal,slot->buffer,region);
+
+    //back to what the render pass left,presenting needs no access but the layout
+    imageBarrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+    imageBarrier.setNewLayout(layout);
+    imageBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
+    imageBarrier.setDstAccessMask(vk::AccessFlags());
+    vk::BufferMemoryBarrier bufferBarrier;
+    bufferBarrier.setBuffer(slot->buffer);
+    bufferBarrier.setOffset(0);
+    bufferBarrier.setSize(VK_WHOLE_SIZE);
+    bufferBarrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    bufferBarrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    bufferBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    bufferBarrier.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,vk::PipelineStageFlagBits::eHost|vk::PipelineStageFlagBits::eBottomOfPipe,
+    vk::DependencyFlags(0),{},bufferBarrier,imageBarrier);
+}
+
+void FrameCapture::encode(uint32_t slotIndex)
+{
+    TraceScope scope("encode capture");
+    auto start = std::chrono::high_resolution_clock::now();
+    Slot& slot = slots[slotIndex];
+    const uint8_t* pixels = reinterpret_cast<const uint8_t*>(slot.memory.mapped);
+    //stb_image_write takes RGBA only
+    thread_local std::vector<uint8_t> swizzled;
+    if(swizzle){
+        size_t size = size_t(extent.width)*extent.height*4;
+        swizzled.resize(size);
+        for(size_t i=0;i<size;i+=4){
+            swizzled[i] = pixels[i+2];
+            swizzled[i+1] = pixels[i+1];
+            swizzled[i+2] = pixels[i];
+            swizzled[i+3] = pixels[i+3];
+        }
+        pixels = swizzled.data();
+    }
+    char name[32];
+    std::snprintf(name,sizeof(name),"frame_%06llu.%s",(unsigned long long)slot.frameNumber,
+    options.format==CaptureFormat::ePng?"png":"tga");
+    std::string path = (std::filesystem::path(options.directory)/name).string();
+    int written = 0;
+    if(options.format==CaptureFormat::ePng){
+        written = stbi_write_png(path.c_str(),extent.width,extent.height,4,pixels,extent.width*4);
+    }
+    else{
+        written = stbi_write_tga(path.c_str(),extent.width,extent.height,4,pixels);
+    }
+    float ms = std::chrono::duration<float,std::milli>(std::chrono::high_resolution_clock::now()-start).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    slot.state = SlotState::eFree;
+    if(written){
+        ++stats.written;
+    }
+    else{
+        ++stats.failed;
+    }
+    stats.encodeTime = stats.encodeTime>0?stats.encodeTime*0.95f+ms*0.05f:ms;
+}
+
+void FrameCapture::flush()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(uint32_t i=0;i<slots.size();++i){
+            if(slots[i].state==SlotState::eCopying){
+                slots[i].state = SlotState::eEncoding;
+                encoders->submit([this,i](){encode(i);});
+            }
+        }
+    }
+    encoders->wait();
+}
+
+void FrameCapture::resize()
+{
+    flush();
+    destroySlots();
+    initSlots();
+}
+
+CaptureStats FrameCapture::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
@@ -0,0 +1,485 @@
+#include"cull.h"
+#include"renderer.h"
+#include"vkglTF.h"
+
+#include<array>
+#include<cmath>
+
+static_assert(sizeof(vkglTF::DrawInstance)==48,"DrawInstance must match its std430 layout in cull.comp!");
+static_assert(sizeof(vk::DrawIndexedIndirectCommand)==20,"DrawCommand in cull.comp must match VkDrawIndexedIndirectCommand!");
+static_assert(sizeof(CullStats)==16,"CullStats must match its std430 layout in cull.comp,bucketCounts follows it!");
+
+#define CULL_BINDING_COUNT 7
+#define PYRAMID_FORMAT vk::Format::eR32Sfloat
+
+//matches CullUniforms in cull.comp
+struct CullUniforms{
+    glm::mat4 viewProj;
+    glm::mat4 pyramidViewProj;
+    //left,right,bottom,top,near,far,normals point inside
+    glm::vec4 planes[6];
+    glm::vec2 pyramidSize;
+    float pyramidLevels;
+    float padding;
+    //part of the depth image the scene covered when the pyramid was built and this frame,per axis
+    glm::vec2 pyramidUVScale;
+    glm::vec2 uvScale;
+};
+struct CullPushConstants{
+    uint32_t instanceCount;
+    uint32_t compact;
+    uint32_t phase;
+    uint32_t occlusion;
+    uint32_t bucketCount;
+};
+
+static uint32_t previousPow2(uint32_t value)
+{
+    uint32_t result = 1;
+    while(result*2<=value){
+        result *= 2;
+    }
+    return result;
+}
+
+CullPass::CullPass(Renderer* renderer,vkglTF::Scene* scene):renderer(renderer),scene(scene)
+{
+    instanceCount = scene->drawInstanceCount;
+    bucketCount = scene->drawBuckets.size();
+    //CullStats followed by the per bucket draw counts of both phases
+    statsSize = sizeof(CullStats)+2*bucketCount*sizeof(uint32_t);
+    compact = renderer->drawIndirectCountSupported;
+    initPipelines();
+    initPyramid();
+    initFrames();
+    writeFrameDescriptors();
+}
+
+CullPass::~CullPass()
+{
+    vk::Device device = renderer->lDevice;
+    destroyPyramid();
+    for(auto& frame:frames){
+        device.destroySemaphore(frame.finished);
+        device.freeCommandBuffers(renderer->computeCommandPool,frame.commandBuffer);
+        device.freeDescriptorSets(renderer->descriptorPool,frame.descriptorSet);
+        renderer->destroyBuffer(frame.commandsBuffer,frame.commandsBufferMemory);
+        renderer->destroyBuffer(frame.statsBuffer,frame.statsBufferMemory);
+        renderer->destroyBuffer(frame.lateCandidatesBuffer,frame.lateCandidatesBufferMemory);
+        renderer->destroyBuffer(frame.uniformBuffer,frame.uniformBufferMemory);
+    }
+    device.destroySampler(pyramidSampler);
+    device.destroyPipeline(pyramidPipeline);
+    device.destroyPipelineLayout(pyramidPipelineLayout);
+    device.destroyDescriptorSetLayout(pyramidSetLayout);
+    device.destroyPipeline(pipeline);
+    device.destroyPipelineLayout(pipelineLayout);
+    device.destroyDescriptorSetLayout(descriptorSetLayout);
+}
+
+vk::Semaphore CullPass::dispatch(uint32_t frameIndex,const CameraDetails& camera)
+{
+    Frame& frame = frames[frameIndex];
+    //the frame's graphics work waited for the last dispatch into these buffers and is done
+    frame.commandBuffer.reset();
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    frame.commandBuffer.begin(beginInfo);
+    renderer->profiler->beginZone(frame.commandBuffer,frameIndex,"frustum cull",ProfilerQueue::eCompute);
+    recordDispatch(frame.commandBuffer,frameIndex,camera,CullPhase::eEarly,false);
+    renderer->profiler->endZone(frame.commandBuffer,frameIndex);
+    frame.commandBuffer.end();
+
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBuffers(frame.commandBuffer);
+    submitInfo.setSignalSemaphores(frame.finished);
+    renderer->computeQueue.submit(submitInfo);
+    return frame.finished;
+}
+
+void CullPass::recordCull(vk::CommandBuffer commandBuffer,uint32_t frameIndex,const CameraDetails& camera,CullPhase phase)
+{
+    recordDispatch(commandBuffer,frameIndex,camera,phase,true);
+    vk::MemoryBarrier barrier;
+    barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+    barrier.setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,vk::PipelineStageFlagBits::eDrawIndirect,
+    vk::DependencyFlags(0),barrier,{},{});
+}
+
+void CullPass::recordDispatch(vk::CommandBuffer commandBuffer,uint32_t frameIndex,const CameraDetails& camera,CullPhase phase,bool occlusion)
+{
+    Frame& frame = frames[frameIndex];
+    if(phase==CullPhase::eEarly){
+        CullUniforms uniforms;
+        uniforms.viewProj = camera.projectionMat*camera.viewMat;
+        uniforms.pyramidViewProj = pyramidViewProj;
+        //rows of the clip matrix,depth is 0..1
+        glm::mat4 clip = glm::transpose(uniforms.viewProj);
+        uniforms.planes[0] = clip[3]+clip[0];
+        uniforms.planes[1] = clip[3]-clip[0];
+        uniforms.planes[2] = clip[3]+clip[1];
+        uniforms.planes[3] = clip[3]-clip[1];
+        uniforms.planes[4] = clip[2];
+        uniforms.planes[5] = clip[3]-clip[2];
+        for(auto& plane:uniforms.planes){
+            plane /= glm::length(glm::vec3(plane));
+        }
+        uniforms.pyramidSize = glm::vec2(pyramidExtent.width,pyramidExtent.height);
+        uniforms.pyramidLevels = (float)pyramidLevels;
+        uniforms.pyramidUVScale = pyramidUVScale;
+        uniforms.uvScale = getUVScale();
+        memcpy(frame.uniformMapped,&uniforms,sizeof(uniforms));
+
+        commandBuffer.fillBuffer(frame.statsBuffer,0,statsSize,0);
+        vk::BufferMemoryBarrier barrier;
+        barrier.setBuffer(frame.statsBuffer);
+        barrier.setSize(statsSize);
+        barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+        barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(0),{},barrier,{});
+    }
+    CullPushConstants pushConstants;
+    pushConstants.instanceCount = instanceCount;
+    pushConstants.compact = compact;
+    pushConstants.phase = phase==CullPhase::eEarly?0:1;
+    //the early phase has nothing to test against until a pyramid was built
+    pushConstants.occlusion = occlusion&&(phase==CullPhase::eLate||pyramidValid);
+    pushConstants.bucketCount = bucketCount;
+    if(frame.pyramidStale){
+        writePyramidDescriptor(frameIndex);
+    }
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute,pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,pipelineLayout,0,frame.descriptorSet,{});
+    commandBuffer.pushConstants<CullPushConstants>(pipelineLayout,vk::ShaderStageFlagBits::eCompute,0,pushConstants);
+    commandBuffer.dispatch((instanceCount+63)/64,1,1);
+}
+
+void CullPass::recordPyramid(vk::CommandBuffer commandBuffer,const CameraDetails& camera)
+{
+    vk::ImageMemoryBarrier depthBarrier;
+    depthBarrier.setImage(renderer->depthImage);
+    depthBarrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth|vk::ImageAspectFlagBits::eStencil,0,1,0,1));
+    depthBarrier.setOldLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+    depthBarrier.setNewLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+    depthBarrier.setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+    depthBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    //culling of earlier frames is done reading the old pyramid before it is overwritten
+    vk::ImageMemoryBarrier pyramidBarrier;
+    pyramidBarrier.setImage(pyramid);
+    pyramidBarrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor,0,pyramidLevels,0,1));
+    pyramidBarrier.setOldLayout(pyramidValid?vk::ImageLayout::eGeneral:vk::ImageLayout::eUndefined);
+    pyramidBarrier.setNewLayout(vk::ImageLayout::eGeneral);
+    pyramidBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+    pyramidBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eLateFragmentTests|vk::PipelineStageFlagBits::eComputeShader,
+    vk::PipelineStageFlagBits::eComputeShader,vk::DependencyFlags(0),{},{},{depthBarrier,pyramidBarrier});
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute,pyramidPipeline);
+    for(uint32_t level=0;level<pyramidLevels;++level){
+        glm::uvec2 size(std::max(pyramidExtent.width>>level,1u),std::max(pyramidExtent.height>>level,1u));
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,pyramidPipelineLayout,0,pyramidSets[level],{});
+        commandBuffer.pushConstants<glm::uvec2>(pyramidPipelineLayout,vk::ShaderStageFlagBits::eCompute,0,size);
+        commandBuffer.dispatch((size.x+7)/8,(size.y+7)/8,1);
+        //the next level and the late phase read this one
+        pyramidBarrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor,level,1,0,1));
+        pyramidBarrier.setOldLayout(vk::ImageLayout::eGeneral);
+        pyramidBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+        pyramidBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(0),{},{},pyramidBarrier);
+    }
+
+    depthBarrier.setOldLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+    depthBarrier.setNewLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+    depthBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+    depthBarrier.setDstAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentRead|vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,vk::PipelineStageFlagBits::eEarlyFragmentTests,
+    vk::DependencyFlags(0),{},{},depthBarrier);
+    pyramidViewProj = camera.projectionMat*camera.viewMat;
+    pyramidUVScale = getUVScale();
+    pyramidValid = true;
+}
+
+void CullPass::draw(vk::CommandBuffer commandBuffer,uint32_t frameIndex,CullPhase phase,uint32_t bucket)
+{
+    Frame& frame = frames[frameIndex];
+    const vkglTF::DrawBucket& drawBucket = scene->drawBuckets[bucket];
+    uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+    uint32_t phaseIndex = phase==CullPhase::eEarly?0:1;
+    vk::DeviceSize offset = (phaseIndex*instanceCount+drawBucket.firstInstance)*stride;
+    if(compact){
+        vk::DeviceSize countOffset = sizeof(CullStats)+(phaseIndex*bucketCount+bucket)*sizeof(uint32_t);
+        commandBuffer.drawIndexedIndirectCount(frame.commandsBuffer,offset,frame.statsBuffer,countOffset,drawBucket.instanceCount,stride);
+    }
+    else if(renderer->multiDrawIndirectSupported){
+        commandBuffer.drawIndexedIndirect(frame.commandsBuffer,offset,drawBucket.instanceCount,stride);
+    }
+    else{
+        for(uint32_t i=0;i<drawBucket.instanceCount;++i){
+            commandBuffer.drawIndexedIndirect(frame.commandsBuffer,offset+i*stride,1,stride);
+        }
+    }
+}
+
+glm::vec2 CullPass::getUVScale() const
+{
+    return glm::vec2(float(renderer->renderExtent.width)/renderer->sceneExtent.width,
+    float(renderer->renderExtent.height)/renderer->sceneExtent.height);
+}
+
+uint32_t CullPass::getDrawCallCount(uint32_t bucket) const
+{
+    if(compact||renderer->multiDrawIndirectSupported){
+        return 1;
+    }
+    return scene->drawBuckets[bucket].instanceCount;
+}
+
+void CullPass::resize()
+{
+    //frames in flight cull against the old pyramid and build into it
+    vk::Image oldPyramid = pyramid;
+    GpuAllocation oldMemory = pyramidMemory;
+    vk::ImageView oldView = pyramidView;
+    std::vector<vk::ImageView> oldLevelViews = pyramidLevelViews;
+    std::vector<vk::DescriptorSet> oldSets = pyramidSets;
+    renderer->retire([renderer = renderer,oldPyramid,oldMemory,oldView,oldLevelViews,oldSets]()mutable{
+        renderer->lDevice.freeDescriptorSets(renderer->descriptorPool,oldSets);
+        for(auto view:oldLevelViews){
+            renderer->lDevice.destroyImageView(view);
+        }
+        renderer->lDevice.destroyImageView(oldView);
+        renderer->destroyImage(oldPyramid,oldMemory);
+    });
+    pyramidSets.clear();
+    pyramidLevelViews.clear();
+    initPyramid();
+    //their descriptor sets may be bound by frames in flight,each is rewritten when its frame is recorded next
+    for(auto& frame:frames){
+        frame.pyramidStale = true;
+    }
+}
+
+void CullPass::writePyramidDescriptor(uint32_t frameIndex)
+{
+    Frame& frame = frames[frameIndex];
+    vk::DescriptorImageInfo imageInfo(pyramidSampler,pyramidView,vk::ImageLayout::eGeneral);
+    vk::WriteDescriptorSet write;
+    write.setDescriptorCount(1);
+    write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    write.setDstArrayElement(0);
+    write.setDstBinding(6);
+    write.setDstSet(frame.descriptorSet);
+    write.setImageInfo(imageInfo);
+    renderer->lDevice.updateDescriptorSets(write,{});
+    frame.pyramidStale = false;
+}
+
+void CullPass::initPipelines()
+{
+    {
+        std::array<vk::DescriptorSetLayoutBinding,CULL_BINDING_COUNT> bindings;
+        for(int i=0;i<CULL_BINDING_COUNT;++i){
+            bindings[i].setBinding(i);
+            bindings[i].setDescriptorCount(1);
+            bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+            bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        }
+        bindings[5].setDescriptorType(vk::DescriptorType::eUniformBuffer);
+        bindings[6].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        vk::DescriptorSetLayoutCreateInfo setLayoutInfo;
+        setLayoutInfo.setBindings(bindings);
+        descriptorSetLayout = renderer->lDevice.createDescriptorSetLayout(setLayoutInfo);
+
+        vk::PushConstantRange range;
+        range.setOffset(0);
+        range.setSize(sizeof(CullPushConstants));
+        range.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        vk::PipelineLayoutCreateInfo layoutInfo;
+        layoutInfo.setSetLayouts(descriptorSetLayout);
+        layoutInfo.setPushConstantRanges(range);
+        pipelineLayout = renderer->lDevice.createPipelineLayout(layoutInfo);
+
+        vk::ShaderModule shaderModule = renderer->createShaderModule("shaders/spv/cull.spv");
+        vk::PipelineShaderStageCreateInfo stage;
+        stage.setModule(shaderModule);
+        stage.setPName("main");
+        stage.setStage(vk::ShaderStageFlagBits::eCompute);
+        vk::ComputePipelineCreateInfo createInfo;
+        createInfo.setLayout(pipelineLayout);
+        createInfo.setStage(stage);
+        pipeline = renderer->createComputePipeline(createInfo,"cull pipeline");
+        renderer->lDevice.destroyShaderModule(shaderModule);
+    }
+    {
+        std::array<vk::DescriptorSetLayoutBinding,2> bindings;
+        bindings[0].setBinding(0);
+        bindings[0].setDescriptorCount(1);
+        bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        bindings[0].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        bindings[1].setBinding(1);
+        bindings[1].setDescriptorCount(1);
+        bindings[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+        bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        vk::DescriptorSetLayoutCreateInfo setLayoutInfo;
+        setLayoutInfo.setBindings(bindings);
+        pyramidSetLayout = renderer->lDevice.createDescriptorSetLayout(setLayoutInfo);
+
+        vk::PushConstantRange range;
+        range.setOffset(0);
+        range.setSize(sizeof(glm::uvec2));
+        range.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        vk::PipelineLayoutCreateInfo layoutInfo;
+        layoutInfo.setSetLayouts(pyramidSetLayout);
+        layoutInfo.setPushConstantRanges(range);
+        pyramidPipelineLayout = renderer->lDevice.createPipelineLayout(layoutInfo);
+
+        vk::ShaderModule shaderModule = renderer->createShaderModule("shaders/spv/pyramid.spv");
+        vk::PipelineShaderStageCreateInfo stage;
+        stage.setModule(shaderModule);
+        stage.setPName("main");
+        stage.setStage(vk::ShaderStageFlagBits::eCompute);
+        vk::ComputePipelineCreateInfo createInfo;
+        createInfo.setLayout(pyramidPipelineLayout);
+        createInfo.setStage(stage);
+        pyramidPipeline = renderer->createComputePipeline(createInfo,"depth pyramid pipeline");
+        renderer->lDevice.destroyShaderModule(shaderModule);
+    }
+    //texelFetch in pyramid.comp ignores filtering,cull.comp picks a level where a box covers at most 2x2 texels
+    vk::SamplerCreateInfo samplerInfo;
+    samplerInfo.setMagFilter(vk::Filter::eNearest);
+    samplerInfo.setMinFilter(vk::Filter::eNearest);
+    samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+    samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+    samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+    samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+    samplerInfo.setMinLod(0.0f);
+    samplerInfo.setMaxLod(VK_LOD_CLAMP_NONE);
+    pyramidSampler = renderer->lDevice.createSampler(samplerInfo);
+}
+
+void CullPass::initFrames()
+{
+    int commandsSize = 2*instanceCount*sizeof(vk::DrawIndexedIndirectCommand);
+    int lateCandidatesSize = instanceCount*sizeof(uint32_t);
+    frames.resize(renderer->framesInFlight);
+    for(uint32_t i=0;i<frames.size();++i){
+        Frame& frame = frames[i];
+        renderer->createBuffer(frame.commandsBuffer,frame.commandsBufferMemory,commandsSize,
+        vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eIndirectBuffer,vk::MemoryPropertyFlagBits::eDeviceLocal);
+        renderer->createBuffer(frame.statsBuffer,frame.statsBufferMemory,statsSize,
+        vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eIndirectBuffer|vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
+        frame.statsMapped = reinterpret_cast<CullStats*>(frame.statsBufferMemory.mapped);
+        *frame.statsMapped = CullStats{};
+        renderer->createBuffer(frame.lateCandidatesBuffer,frame.lateCandidatesBufferMemory,lateCandidatesSize,
+        vk::BufferUsageFlagBits::eStorageBuffer,vk::MemoryPropertyFlagBits::eDeviceLocal);
+        renderer->createBuffer(frame.uniformBuffer,frame.uniformBufferMemory,sizeof(CullUniforms),
+        vk::BufferUsageFlagBits::eUniformBuffer,vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
+        frame.uniformMapped = frame.uniformBufferMemory.mapped;
+
+        vk::DescriptorSetAllocateInfo allocateInfo;
+        allocateInfo.setDescriptorPool(renderer->descriptorPool);
+        allocateInfo.setDescriptorSetCount(1);
+        allocateInfo.setSetLayouts(descriptorSetLayout);
+        frame.descriptorSet = renderer->lDevice.allocateDescriptorSets(allocateInfo)[0];
+
+        vk::CommandBufferAllocateInfo commandBufferInfo;
+        commandBufferInfo.setCommandBufferCount(1);
+        commandBufferInfo.setCommandPool(renderer->computeCommandPool);
+        commandBufferInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+        frame.commandBuffer = renderer->lDevice.allocateCommandBuffers(commandBufferInfo)[0];
+
+        vk::SemaphoreCreateInfo semaphoreInfo;
+        frame.finished = renderer->lDevice.createSemaphore(semaphoreInfo);
+    }
+}
+
+void CullPass::writeFrameDescriptors()
+{
+    int instancesSize = instanceCount*sizeof(vkglTF::DrawInstance);
+    int commandsSize = 2*instanceCount*sizeof(vk::DrawIndexedIndirectCommand);
+    int lateCandidatesSize = instanceCount*sizeof(uint32_t);
+    for(uint32_t i=0;i<frames.size();++i){
+        Frame& frame = frames[i];
+        //the frame's copy of the model matrices
+        std::array<vk::DescriptorBufferInfo,CULL_BINDING_COUNT-1> bufferInfos = {
+            vk::DescriptorBufferInfo(scene->drawInstanceBuffer,0,instancesSize),
+            vk::DescriptorBufferInfo(scene->modelMatsBuffer,scene->getModelMatsOffset(i),scene->modelMats.size()*sizeof(vkglTF::ModelMatrix)),
+            vk::DescriptorBufferInfo(frame.commandsBuffer,0,commandsSize),
+            vk::DescriptorBufferInfo(frame.statsBuffer,0,statsSize),
+            vk::DescriptorBufferInfo(frame.lateCandidatesBuffer,0,lateCandidatesSize),
+            vk::DescriptorBufferInfo(frame.uniformBuffer,0,sizeof(CullUniforms)),
+        };
+        vk::DescriptorImageInfo imageInfo(pyramidSampler,pyramidView,vk::ImageLayout::eGeneral);
+        std::array<vk::WriteDescriptorSet,CULL_BINDING_COUNT> writes;
+        for(int b=0;b<CULL_BINDING_COUNT;++b){
+            writes[b].setDescriptorCount(1);
+            writes[b].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+            writes[b].setDstArrayElement(0);
+            writes[b].setDstBinding(b);
+            writes[b].setDstSet(frame.descriptorSet);
+            if(b<CULL_BINDING_COUNT-1){
+                writes[b].setBufferInfo(bufferInfos[b]);
+            }
+        }
+        writes[5].setDescriptorType(vk::DescriptorType::eUniformBuffer);
+        writes[6].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        writes[6].setImageInfo(imageInfo);
+        renderer->lDevice.updateDescriptorSets(writes,{});
+    }
+}
+
+void CullPass::initPyramid()
+{
+    vk::Extent2D depthExtent = renderer->sceneExtent;
+    pyramidExtent = vk::Extent2D(previousPow2(depthExtent.width),previousPow2(depthExtent.height));
+    pyramidLevels = (uint32_t)std::log2(std::max(pyramidExtent.width,pyramidExtent.height))+1;
+    renderer->createImage(pyramid,pyramidMemory,pyramidExtent,PYRAMID_FORMAT,
+    vk::ImageUsageFlagBits::eSampled|vk::ImageUsageFlagBits::eStorage,vk::MemoryPropertyFlagBits::eDeviceLocal,pyramidLevels);
+    pyramidView = renderer->createImageView(pyramid,PYRAMID_FORMAT,vk::ImageAspectFlagBits::eColor,0,pyramidLevels);
+    //the pyramid stays in eGeneral,it is written as storage image and sampled.
+    //the first build moves it out of eUndefined,nothing samples it before that since pyramidValid is false
+
+    pyramidLevelViews.resize(pyramidLevels);
+    pyramidSets.resize(pyramidLevels);
+    std::vector<vk::DescriptorSetLayout> setLayouts(pyramidLevels,pyramidSetLayout);
+    vk::DescriptorSetAllocateInfo allocateInfo;
+    allocateInfo.setDescriptorPool(renderer->descriptorPool);
+    allocateInfo.setSetLayouts(setLayouts);
+    pyramidSets = renderer->lDevice.allocateDescriptorSets(allocateInfo);
+    for(uint32_t level=0;level<pyramidLevels;++level){
+        pyramidLevelViews[level] = renderer->createImageView(pyramid,PYRAMID_FORMAT,vk::ImageAspectFlagBits::eColor,level,1);
+        //level 0 is reduced from the depth image,every other level from the one above
+        vk::DescriptorImageInfo sourceInfo(pyramidSampler,renderer->depthImageView,vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+        if(level>0){
+            sourceInfo = vk::DescriptorImageInfo(pyramidSampler,pyramidLevelViews[level-1],vk::ImageLayout::eGeneral);
+        }
+        vk::DescriptorImageInfo destinationInfo(nullptr,pyramidLevelViews[level],vk::ImageLayout::eGeneral);
+        std::array<vk::WriteDescriptorSet,2> writes;
+        writes[0].setDstSet(pyramidSets[level]);
+        writes[0].setDstBinding(0);
+        writes[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        writes[0].setImageInfo(sourceInfo);
+        writes[1].setDstSet(pyramidSets[level]);
+        writes[1].setDstBinding(1);
+        writes[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+        writes[1].setImageInfo(destinationInfo);
+        renderer->lDevice.updateDescriptorSets(writes,{});
+    }
+    pyramidValid = false;
+}
+
+void CullPass::destroyPyramid()
+{
+    renderer->lDevice.freeDescriptorSets(renderer->descriptorPool,pyramidSets);
+    for(auto view:pyramidLevelViews){
+        renderer->lDevice.destroyImageView(view);
+    }
+    renderer->lDevice.destroyImageView(pyramidView);
+    renderer->destroyImage(pyramid,pyramidMemory);
+    pyramidSets.clear();
+    pyramidLevelViews.clear();
+}
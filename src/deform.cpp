@@ -0,0 +1,168 @@
+#include"deform.h"
+#include"renderer.h"
+#include"vkglTF.h"
+
+#include<algorithm>
+
+static_assert(sizeof(vkglTF::Vertex)==15*sizeof(float),"VERTEX_STRIDE in deform.comp must match vkglTF::Vertex!");
+static_assert(sizeof(vkglTF::DeformVertex)==48,"DeformVertex must match its std430 layout in deform.comp!");
+static_assert(sizeof(vkglTF::MorphDelta)==16,"MorphDelta must match its std430 layout in deform.comp!");
+
+#define DEFORM_BINDING_COUNT 6
+
+DeformPass::DeformPass(Renderer* renderer,vkglTF::Scene* scene):renderer(renderer),scene(scene)
+{
+    initPipeline();
+    initSlots();
+}
+
+DeformPass::~DeformPass()
+{
+    vk::Device device = renderer->lDevice;
+    for(auto& slot:slots){
+        device.destroyFence(slot.fence);
+        device.destroySemaphore(slot.finished);
+        device.freeCommandBuffers(renderer->computeCommandPool,slot.commandBuffer);
+        renderer->destroyBuffer(slot.jointBuffer,slot.jointBufferMemory);
+        renderer->destroyBuffer(slot.weightBuffer,slot.weightBufferMemory);
+        renderer->destroyBuffer(slot.vertexBuffer,slot.vertexBufferMemory);
+    }
+    device.destroyPipeline(pipeline);
+    device.destroyPipelineLayout(pipelineLayout);
+    device.destroyDescriptorSetLayout(descriptorSetLayout);
+}
+
+vk::Semaphore DeformPass::dispatch()
+{
+    curSlot = (curSlot+1)%slots.size();
+    Slot& slot = slots[curSlot];
+    //the slot was last drawn from framesInFlight frames ago,render() has waited for that frame
+    auto waitFenceResult = renderer->lDevice.waitForFences(slot.fence,true,std::numeric_limits<uint64_t>::max());
+    renderer->lDevice.resetFences(slot.fence);
+    memcpy(slot.jointsMapped,scene->jointMatrices.data(),scene->jointMatrices.size()*sizeof(glm::mat4));
+    memcpy(slot.weightsMapped,scene->morphWeights.data(),scene->morphWeights.size()*sizeof(float));
+
+    uint32_t deformVertexCount = scene->deformVertexCount;
+    slot.commandBuffer.reset();
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    slot.commandBuffer.begin(beginInfo);
+    slot.commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute,pipeline);
+    slot.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,pipelineLayout,0,slot.descriptorSet,{});
+    slot.commandBuffer.pushConstants<uint32_t>(pipelineLayout,vk::ShaderStageFlagBits::eCompute,0,deformVertexCount);
+    slot.commandBuffer.dispatch((deformVertexCount+63)/64,1,1);
+    slot.commandBuffer.end();
+
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBuffers(slot.commandBuffer);
+    submitInfo.setSignalSemaphores(slot.finished);
+    renderer->computeQueue.submit(submitInfo,slot.fence);
+    dispatched = true;
+    return slot.finished;
+}
+
+vk::Buffer DeformPass::getVertexBuffer() const
+{
+    return slots[curSlot].vertexBuffer;
+}
+
+void DeformPass::initPipeline()
+{
+    std::array<vk::DescriptorSetLayoutBinding,DEFORM_BINDING_COUNT> bindings;
+    for(int i=0;i<DEFORM_BINDING_COUNT;++i){
+        bindings[i].setBinding(i);
+        bindings[i].setDescriptorCount(1);
+        bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+        bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    }
+    vk::DescriptorSetLayoutCreateInfo setLayoutInfo;
+    setLayoutInfo.setBindings(bindings);
+    descriptorSetLayout = renderer->lDevice.createDescriptorSetLayout(setLayoutInfo);
+
+    vk::PushConstantRange range;
+    range.setOffset(0);
+    range.setSize(sizeof(uint32_t));
+    range.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    vk::PipelineLayoutCreateInfo layoutInfo;
+    layoutInfo.setSetLayouts(descriptorSetLayout);
+    layoutInfo.setPushConstantRanges(range);
+    pipelineLayout = renderer->lDevice.createPipelineLayout(layoutInfo);
+
+    vk::ShaderModule shaderModule = renderer->createShaderModule("shaders/spv/deform.spv");
+    vk::PipelineShaderStageCreateInfo stage;
+    stage.setModule(shaderModule);
+    stage.setPName("main");
+    stage.setStage(vk::ShaderStageFlagBits::eCompute);
+    vk::ComputePipelineCreateInfo createInfo;
+    createInfo.setLayout(pipelineLayout);
+    createInfo.setStage(stage);
+    pipeline = renderer->createComputePipeline(createInfo,"deform pipeline");
+    renderer->lDevice.destroyShaderModule(shaderModule);
+}
+
+void DeformPass::initSlots()
+{
+    int vertexSize = scene->vertexCount*sizeof(vkglTF::Vertex);
+    int deformVertexSize = scene->deformVertexCount*sizeof(vkglTF::DeformVertex);
+    int morphDeltaSize = scene->morphDeltaCount*sizeof(vkglTF::MorphDelta);
+    //morph only scenes have no joints and skin only scenes no weights,storage buffers can't be empty
+    int jointSize = std::max<int>(scene->jointMatrices.size(),1)*sizeof(glm::mat4);
+    int weightSize = std::max<int>(scene->morphWeights.size(),1)*sizeof(float);
+    slots.resize(renderer->framesInFlight+1);
+    for(auto& slot:slots){
+        renderer->createBuffer(slot.vertexBuffer,slot.vertexBufferMemory,vertexSize,
+        vk::BufferUsageFlagBits::eVertexBuffer|vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal);
+        //undeformed vertices and attributes the shader does not touch come from the scene's vertex buffer
+        vk::CommandBuffer cb = renderer->startOneShotCommandBuffer(renderer->graphicCommandPool);
+        vk::BufferCopy region;
+        region.setSize(vertexSize);
+        region.setSrcOffset(0);
+        region.setDstOffset(0);
+        cb.copyBuffer(scene->vertexBuffer,slot.vertexBuffer,region);
+        renderer->finishOneShotCommandBuffer(renderer->graphicCommandPool,cb,renderer->graphicQueue);
+
+        renderer->createBuffer(slot.jointBuffer,slot.jointBufferMemory,jointSize,vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
+        slot.jointsMapped = reinterpret_cast<glm::mat4*>(slot.jointBufferMemory.mapped);
+        renderer->createBuffer(slot.weightBuffer,slot.weightBufferMemory,weightSize,vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
+        slot.weightsMapped = reinterpret_cast<float*>(slot.weightBufferMemory.mapped);
+
+        vk::DescriptorSetAllocateInfo allocateInfo;
+        allocateInfo.setDescriptorPool(renderer->descriptorPool);
+        allocateInfo.setDescriptorSetCount(1);
+        allocateInfo.setSetLayouts(descriptorSetLayout);
+        slot.descriptorSet = renderer->lDevice.allocateDescriptorSets(allocateInfo)[0];
+        std::array<vk::DescriptorBufferInfo,DEFORM_BINDING_COUNT> bufferInfos = {
+            vk::DescriptorBufferInfo(scene->deformVertexBuffer,0,deformVertexSize),
+            vk::DescriptorBufferInfo(slot.jointBuffer,0,jointSize),
+            vk::DescriptorBufferInfo(slot.vertexBuffer,0,vertexSize),
+            vk::DescriptorBufferInfo(scene->vertexBuffer,0,vertexSize),
+            vk::DescriptorBufferInfo(scene->morphDeltaBuffer,0,morphDeltaSize),
+            vk::DescriptorBufferInfo(slot.weightBuffer,0,weightSize),
+        };
+        std::array<vk::WriteDescriptorSet,DEFORM_BINDING_COUNT> writes;
+        for(int i=0;i<DEFORM_BINDING_COUNT;++i){
+            writes[i].setBufferInfo(bufferInfos[i]);
+            writes[i].setDescriptorCount(1);
+            writes[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+            writes[i].setDstArrayElement(0);
+            writes[i].setDstBinding(i);
+            writes[i].setDstSet(slot.descriptorSet);
+        }
+        renderer->lDevice.updateDescriptorSets(writes,{});
+
+        vk::CommandBufferAllocateInfo commandBufferInfo;
+        commandBufferInfo.setCommandBufferCount(1);
+        commandBufferInfo.setCommandPool(renderer->computeCommandPool);
+        commandBufferInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+        slot.commandBuffer = renderer->lDevice.allocateCommandBuffers(commandBufferInfo)[0];
+
+        vk::FenceCreateInfo fenceInfo;
+        fenceInfo.setFlags(vk::FenceCreateFlagBits::eSignaled);
+        slot.fence = renderer->lDevice.createFence(fenceInfo);
+        vk::SemaphoreCreateInfo semaphoreInfo;
+        slot.finished = renderer->lDevice.createSemaphore(semaphoreInfo);
+    }
+}
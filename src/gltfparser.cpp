@@ -0,0 +1,571 @@
+#include"gltfparser.h"
+#include"json.hpp"
+
+#include<fstream>
+#include<stdexcept>
+#include<string>
+#include<vector>
+namespace vkglTF{
+
+namespace{
+
+using json = nlohmann::json;
+
+enum class Context{
+    eSkip,
+    eRoot,
+    //arrays of objects
+    eScenes,eNodes,eMeshes,ePrimitives,eTargets,eAccessors,eBufferViews,eBuffers,
+    eImages,eTextures,eMaterials,eSkins,eAnimations,eChannels,eAnimationSamplers,
+    //objects
+    eScene,eNode,eMesh,ePrimitive,eAttributes,eAccessor,eSparse,eSparseIndices,eSparseValues,
+    eBufferView,eBuffer,eImage,eTexture,eMaterial,ePbr,eTextureInfo,eSkin,eAnimation,
+    eChannel,eChannelTarget,eAnimationSampler,
+    //arrays of numbers
+    eInts,eDoubles,
+};
+
+struct Frame{
+    Context context;
+    //filled by eInts,eDoubles and eAttributes
+    std::vector<int>* ints = nullptr;
+    std::vector<double>* doubles = nullptr;
+    std::map<std::string,int>* attributes = nullptr;
+    //eTextureInfo,factor is the scale or strength of normal and occlusion textures
+    int* textureIndex = nullptr;
+    int* texCoord = nullptr;
+    double* factor = nullptr;
+};
+
+static int accessorType(const std::string& type)
+{
+    if(type=="SCALAR") return TINYGLTF_TYPE_SCALAR;
+    if(type=="VEC2") return TINYGLTF_TYPE_VEC2;
+    if(type=="VEC3") return TINYGLTF_TYPE_VEC3;
+    if(type=="VEC4") return TINYGLTF_TYPE_VEC4;
+    if(type=="MAT2") return TINYGLTF_TYPE_MAT2;
+    if(type=="MAT3") return TINYGLTF_TYPE_MAT3;
+    if(type=="MAT4") return TINYGLTF_TYPE_MAT4;
+    throw std::runtime_error("bad accessor type!");
+}
+
+//the parser's SAX interface.every object or array it enters pushes a Frame,
+//values are stored by looking at the innermost frame and the last key seen.
+class SaxHandler{
+public:
+    SaxHandler(glTF::Model& model):model(model){}
+public:
+    bool null(){return true;}
+    bool boolean(bool val){return number(val?1.0:0.0);}
+    bool number_integer(json::number_integer_t val){return number((double)val);}
+    bool number_unsigned(json::number_unsigned_t val){return number((double)val);}
+    bool number_float(json::number_float_t val,const json::string_t&){return number(val);}
+    bool binary(json::binary_t&){return true;}
+    bool key(json::string_t& val){
+        currentKey.swap(val);
+        return true;
+    }
+    bool string(json::string_t& val);
+    bool start_object(size_t);
+    bool end_object(){
+        stack.pop_back();
+        return true;
+    }
+    bool start_array(size_t);
+    bool end_array(){
+        stack.pop_back();
+        return true;
+    }
+    bool parse_error(size_t,const std::string&,const json::exception& ex){
+        error = ex.what();
+        return false;
+    }
+public:
+    std::string error;
+private:
+    bool number(double val);
+    void pushTextureInfo(int& index,int& texCoord,double* factor){
+        Frame frame{Context::eTextureInfo};
+        frame.textureIndex = &index;
+        frame.texCoord = &texCoord;
+        frame.factor = factor;
+        stack.push_back(frame);
+    }
+    void pushInts(std::vector<int>& ints){
+        Frame frame{Context::eInts};
+        frame.ints = &ints;
+        stack.push_back(frame);
+    }
+    //replaces defaults such as baseColorFactor
+    void pushDoubles(std::vector<double>& doubles){
+        doubles.clear();
+        Frame frame{Context::eDoubles};
+        frame.doubles = &doubles;
+        stack.push_back(frame);
+    }
+    void pushAttributes(std::map<std::string,int>& attributes){
+        Frame frame{Context::eAttributes};
+        frame.attributes = &attributes;
+        stack.push_back(frame);
+    }
+    void push(Context context){
+        stack.push_back({context});
+    }
+private:
+    glTF::Model& model;
+    std::vector<Frame> stack;
+    std::string currentKey;
+};
+
+bool SaxHandler::start_object(size_t)
+{
+    if(stack.empty()){
+        push(Context::eRoot);
+        return true;
+    }
+    switch(stack.back().context){
+        case Context::eScenes:
+            model.scenes.emplace_back();
+            push(Context::eScene);
+            break;
+        case Context::eNodes:
+            model.nodes.emplace_back();
+            push(Context::eNode);
+            break;
+        case Context::eMeshes:
+            model.meshes.emplace_back();
+            push(Context::eMesh);
+            break;
+        case Context::ePrimitives:
+            model.meshes.back().primitives.emplace_back();
+            push(Context::ePrimitive);
+            break;
+        case Context::eTargets:{
+            auto& targets = model.meshes.back().primitives.back().targets;
+            targets.emplace_back();
+            pushAttributes(targets.back());
+            break;
+        }
+        case Context::eAccessors:
+            model.accessors.emplace_back();
+            push(Context::eAccessor);
+            break;
+        case Context::eBufferViews:
+            model.bufferViews.emplace_back();
+            push(Context::eBufferView);
+            break;
+        case Context::eBuffers:
+            model.buffers.emplace_back();
+            push(Context::eBuffer);
+            break;
+        case Context::eImages:
+            model.images.emplace_back();
+            push(Context::eImage);
+            break;
+        case Context::eTextures:
+            model.textures.emplace_back();
+            push(Context::eTexture);
+            break;
+        case Context::eMaterials:
+            model.materials.emplace_back();
+            push(Context::eMaterial);
+            break;
+        case Context::eSkins:
+            model.skins.emplace_back();
+            push(Context::eSkin);
+            break;
+        case Context::eAnimations:
+            model.animations.emplace_back();
+            push(Context::eAnimation);
+            break;
+        case Context::eChannels:
+            model.animations.back().channels.emplace_back();
+            push(Context::eChannel);
+            break;
+        case Context::eAnimationSamplers:
+            model.animations.back().samplers.emplace_back();
+            push(Context::eAnimationSampler);
+            break;
+        case Context::ePrimitive:
+            if(currentKey=="attributes"){
+                pushAttributes(model.meshes.back().primitives.back().attributes);
+                return true;
+            }
+            push(Context::eSkip);
+            break;
+        case Context::eAccessor:
+            if(currentKey=="sparse"){
+                model.accessors.back().sparse.isSparse = true;
+                push(Context::eSparse);
+                return true;
+            }
+            push(Context::eSkip);
+            break;
+        case Context::eSparse:
+            if(currentKey=="indices"){
+                push(Context::eSparseIndices);
+            }
+            else if(currentKey=="values"){
+                push(Context::eSparseValues);
+            }
+            else{
+                push(Context::eSkip);
+            }
+            break;
+        case Context::eMaterial:{
+            glTF::Material& material = model.materials.back();
+            if(currentKey=="pbrMetallicRoughness"){
+                push(Context::ePbr);
+            }
+            else if(currentKey=="normalTexture"){
+                pushTextureInfo(material.normalTexture.index,material.normalTexture.texCoord,&material.normalTexture.scale);
+            }
+            else if(currentKey=="occlusionTexture"){
+                pushTextureInfo(material.occlusionTexture.index,material.occlusionTexture.texCoord,&material.occlusionTexture.strength);
+            }
+            else if(currentKey=="emissiveTexture"){
+                pushTextureInfo(material.emissiveTexture.index,material.emissiveTexture.texCoord,nullptr);
+            }
+            else{
+                push(Context::eSkip);
+            }
+            break;
+        }
+        case Context::ePbr:{
+            glTF::PbrMetallicRoughness& pbr = model.materials.back().pbrMetallicRoughness;
+            if(currentKey=="baseColorTexture"){
+                pushTextureInfo(pbr.baseColorTexture.index,pbr.baseColorTexture.texCoord,nullptr);
+            }
+            else if(currentKey=="metallicRoughnessTexture"){
+                pushTextureInfo(pbr.metallicRoughnessTexture.index,pbr.metallicRoughnessTexture.texCoord,nullptr);
+            }
+            else{
+                push(Context::eSkip);
+            }
+            break;
+        }
+        case Context::eChannel:
+            push(currentKey=="target"?Context::eChannelTarget:Context::eSkip);
+            break;
+        default:
+            //asset,extensions,extras and anything else Scene does not read
+            push(Context::eSkip);
+            break;
+    }
+    return true;
+}
+
+bool SaxHandler::start_array(size_t)
+{
+    if(stack.empty()){
+        error = "the top level value is not an object";
+        return false;
+    }
+    switch(stack.back().context){
+        case Context::eRoot:
+            if(currentKey=="scenes") push(Context::eScenes);
+            else if(currentKey=="nodes") push(Context::eNodes);
+            else if(currentKey=="meshes") push(Context::eMeshes);
+            else if(currentKey=="accessors") push(Context::eAccessors);
+            else if(currentKey=="bufferViews") push(Context::eBufferViews);
+            else if(currentKey=="buffers") push(Context::eBuffers);
+            else if(currentKey=="images") push(Context::eImages);
+            else if(currentKey=="textures") push(Context::eTextures);
+            else if(currentKey=="materials") push(Context::eMaterials);
+            else if(currentKey=="skins") push(Context::eSkins);
+            else if(currentKey=="animations") push(Context::eAnimations);
+            else push(Context::eSkip);
+            break;
+        case Context::eScene:
+            if(currentKey=="nodes") pushInts(model.scenes.back().nodes);
+            else push(Context::eSkip);
+            break;
+        case Context::eNode:{
+            glTF::Node& node = model.nodes.back();
+            if(currentKey=="children") pushInts(node.children);
+            else if(currentKey=="matrix") pushDoubles(node.matrix);
+            else if(currentKey=="translation") pushDoubles(node.translation);
+            else if(currentKey=="rotation") pushDoubles(node.rotation);
+            else if(currentKey=="scale") pushDoubles(node.scale);
+            else if(currentKey=="weights") pushDoubles(node.weights);
+            else push(Context::eSkip);
+            break;
+        }
+        case Context::eMesh:
+            if(currentKey=="primitives") push(Context::ePrimitives);
+            else if(currentKey=="weights") pushDoubles(model.meshes.back().weights);
+            else push(Context::eSkip);
+            break;
+        case Context::ePrimitive:
+            if(currentKey=="targets") push(Context::eTargets);
+            else push(Context::eSkip);
+            break;
+        case Context::eMaterial:
+            if(currentKey=="emissiveFactor") pushDoubles(model.materials.back().emissiveFactor);
+            else push(Context::eSkip);
+            break;
+        case Context::ePbr:
+            if(currentKey=="baseColorFactor") pushDoubles(model.materials.back().pbrMetallicRoughness.baseColorFactor);
+            else push(Context::eSkip);
+            break;
+        case Context::eSkin:
+            if(currentKey=="joints") pushInts(model.skins.back().joints);
+            else push(Context::eSkip);
+            break;
+        case Context::eAnimation:
+            if(currentKey=="channels") push(Context::eChannels);
+            else if(currentKey=="samplers") push(Context::eAnimationSamplers);
+            else push(Context::eSkip);
+            break;
+        default:
+            push(Context::eSkip);
+            break;
+    }
+    return true;
+}
+
+bool SaxHandler::number(double val)
+{
+    const std::string& k = currentKey;
+    int i = (int)val;
+    if(stack.empty()){
+        error = "the top level value is not an object";
+        return false;
+    }
+    Frame& frame = stack.back();
+    switch(frame.context){
+        case Context::eInts:
+            frame.ints->push_back(i);
+            break;
+        case Context::eDoubles:
+            frame.doubles->push_back(val);
+            break;
+        case Context::eRoot:
+            if(k=="scene") model.defaultScene = i;
+            break;
+        case Context::eNode:{
+            glTF::Node& node = model.nodes.back();
+            if(k=="mesh") node.mesh = i;
+            else if(k=="skin") node.skin = i;
+            break;
+        }
+        case Context::ePrimitive:{
+            glTF::Primitive& primitive = model.meshes.back().primitives.back();
+            if(k=="indices") primitive.indices = i;
+            else if(k=="material") primitive.material = i;
+            else if(k=="mode") primitive.mode = i;
+            break;
+        }
+        case Context::eAttributes:
+            (*frame.attributes)[k] = i;
+            break;
+        case Context::eAccessor:{
+            glTF::Accessor& accessor = model.accessors.back();
+            if(k=="bufferView") accessor.bufferView = i;
+            else if(k=="byteOffset") accessor.byteOffset = (size_t)val;
+            else if(k=="componentType") accessor.componentType = i;
+            else if(k=="normalized") accessor.normalized = i!=0;
+            else if(k=="count") accessor.count = (size_t)val;
+            break;
+        }
+        case Context::eSparse:
+            if(k=="count") model.accessors.back().sparse.count = i;
+            break;
+        case Context::eSparseIndices:{
+            auto& indices = model.accessors.back().sparse.indices;
+            if(k=="bufferView") indices.bufferView = i;
+            else if(k=="byteOffset") indices.byteOffset = (size_t)val;
+            else if(k=="componentType") indices.componentType = i;
+            break;
+        }
+        case Context::eSparseValues:{
+            auto& values = model.accessors.back().sparse.values;
+            if(k=="bufferView") values.bufferView = i;
+            else if(k=="byteOffset") values.byteOffset = (size_t)val;
+            break;
+        }
+        case Context::eBufferView:{
+            glTF::BufferView& bufferView = model.bufferViews.back();
+            if(k=="buffer") bufferView.buffer = i;
+            else if(k=="byteOffset") bufferView.byteOffset = (size_t)val;
+            else if(k=="byteLength") bufferView.byteLength = (size_t)val;
+            else if(k=="byteStride") bufferView.byteStride = (size_t)val;
+            break;
+        }
+        case Context::eImage:
+            if(k=="bufferView") model.images.back().bufferView = i;
+            break;
+        case Context::eTexture:
+            if(k=="source") model.textures.back().source = i;
+            else if(k=="sampler") model.textures.back().sampler = i;
+            break;
+        case Context::eMaterial:
+            if(k=="alphaCutoff") model.materials.back().alphaCutoff = val;
+            else if(k=="doubleSided") model.materials.back().doubleSided = i!=0;
+            break;
+        case Context::ePbr:
+            if(k=="metallicFactor") model.materials.back().pbrMetallicRoughness.metallicFactor = val;
+            else if(k=="roughnessFactor") model.materials.back().pbrMetallicRoughness.roughnessFactor = val;
+            break;
+        case Context::eTextureInfo:
+            if(k=="index") *frame.textureIndex = i;
+            else if(k=="texCoord") *frame.texCoord = i;
+            else if(frame.factor&&(k=="scale"||k=="strength")) *frame.factor = val;
+            break;
+        case Context::eSkin:
+            if(k=="inverseBindMatrices") model.skins.back().inverseBindMatrices = i;
+            else if(k=="skeleton") model.skins.back().skeleton = i;
+            break;
+        case Context::eChannel:
+            if(k=="sampler") model.animations.back().channels.back().sampler = i;
+            break;
+        case Context::eChannelTarget:
+            if(k=="node") model.animations.back().channels.back().target_node = i;
+            break;
+        case Context::eAnimationSampler:
+            if(k=="input") model.animations.back().samplers.back().input = i;
+            else if(k=="output") model.animations.back().samplers.back().output = i;
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+bool SaxHandler::string(json::string_t& val)
+{
+    const std::string& k = currentKey;
+    if(stack.empty()){
+        error = "the top level value is not an object";
+        return false;
+    }
+    switch(stack.back().context){
+        case Context::eAccessor:
+            if(k=="type") model.accessors.back().type = accessorType(val);
+            break;
+        case Context::eBuffer:
+            if(k=="uri") model.buffers.back().uri.swap(val);
+            break;
+        case Context::eImage:
+            if(k=="uri") model.images.back().uri.swap(val);
+            else if(k=="mimeType") model.images.back().mimeType.swap(val);
+            break;
+        case Context::eMaterial:
+            if(k=="alphaMode") model.materials.back().alphaMode.swap(val);
+            break;
+        case Context::eAnimation:
+            if(k=="name") model.animations.back().name.swap(val);
+            break;
+        case Context::eChannelTarget:
+            if(k=="path") model.animations.back().channels.back().target_path.swap(val);
+            break;
+        case Context::eAnimationSampler:
+            if(k=="interpolation") model.animations.back().samplers.back().interpolation.swap(val);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+//bytes of a buffer or image uri,relative paths are resolved against baseDir
+static void loadUri(const std::string& uri,const std::string& baseDir,std::vector<unsigned char>& out)
+{
+    if(tinygltf::IsDataURI(uri)){
+        std::string mimeType;
+        if(!tinygltf::DecodeDataURI(&out,mimeType,uri,0,false)){
+            throw std::runtime_error("failed to decode glTF data uri!");
+        }
+        return;
+    }
+    std::string path;
+    tinygltf::URIDecode(uri,&path,nullptr);
+    std::string err;
+    if(!tinygltf::ReadWholeFile(&out,&err,baseDir+path,nullptr)){
+        throw std::runtime_error("failed to read "+baseDir+path+"!");
+    }
+}
+}
+
+void parseglTFJson(const char* text,size_t size,glTF::Model& model)
+{
+    SaxHandler handler(model);
+    if(!json::sax_parse(text,text+size,&handler)){
+        throw std::runtime_error("failed to parse glTF:"+handler.error);
+    }
+    if(model.defaultScene<0&&model.scenes.size()){
+        model.defaultScene = 0;
+    }
+}
+
+static std::string baseDirectory(const char* path)
+{
+    std::string baseDir = path;
+    size_t slash = baseDir.find_last_of("/\\");
+    return slash==std::string::npos?"":baseDir.substr(0,slash+1);
+}
+
+size_t parseglTFFile(const char* path,glTF::Model& model)
+{
+    std::ifstream file(path,std::ios::binary|std::ios::ate);
+    if(!file.is_open()){
+        throw std::runtime_error(std::string("failed to open ")+path+"!");
+    }
+    //the text is parsed from memory,it is small next to the DOM tinygltf would build from it
+    std::string text(file.tellg(),'\0');
+    file.seekg(0);
+    file.read(text.data(),text.size());
+    parseglTFJson(text.data(),text.size(),model);
+    return text.size();
+}
+
+void loadglTFBuffers(const char* path,glTF::Model& model)
+{
+    std::string baseDir = baseDirectory(path);
+    for(auto& buffer:model.buffers){
+        if(buffer.uri.empty()){
+            throw std::runtime_error("glTF buffer without uri!");
+        }
+        loadUri(buffer.uri,baseDir,buffer.data);
+    }
+}
+
+void decodeglTFImages(const char* path,glTF::Model& model)
+{
+    std::string baseDir = baseDirectory(path);
+    for(size_t i=0;i<model.images.size();++i){
+        glTF::Image& image = model.images[i];
+        std::vector<unsigned char> bytes;
+        const unsigned char* data;
+        size_t size;
+        if(image.bufferView>-1){
+            glTF::BufferView& bufferView = model.bufferViews[image.bufferView];
+            data = model.buffers[bufferView.buffer].data.data()+bufferView.byteOffset;
+            size = bufferView.byteLength;
+        }
+        else{
+            loadUri(image.uri,baseDir,bytes);
+            data = bytes.data();
+            size = bytes.size();
+        }
+        //decoded with stb_image through tinygltf,like tinygltf's own loader does
+        tinygltf::Image decoded;
+        std::string err;
+        std::string warn;
+        if(!tinygltf::LoadImageData(&decoded,(int)i,&err,&warn,0,0,data,(int)size,nullptr)){
+            throw std::runtime_error("failed to load glTF image:"+err);
+        }
+        image.width = decoded.width;
+        image.height = decoded.height;
+        image.component = decoded.component;
+        image.image.swap(decoded.image);
+    }
+}
+
+void loadglTFFile(const char* path,glTF::Model& model)
+{
+    parseglTFFile(path,model);
+    loadglTFBuffers(path,model);
+    decodeglTFImages(path,model);
+}
+}
@@ -1,10 +1,218 @@
 #include"renderer.h"
+#include"thumbnail.h"
+#include"trace.h"
 #include<iostream>
+#include<fstream>
+#include<cstring>
+#include<cstdlib>
+#include<chrono>
+//--headless renders --frames frames offscreen and prints the timings,--output saves the last one as a PNG.
+//--batch renders a PNG into --out-dir for every glTF path listed in a file,one per line.
+//--capture writes every frame into a directory,as --capture-format tga(default) or png.
+//--trace records CPU and GPU zones from startup to exit into a Chrome trace event JSON file
+//--record-scaling renders --frames headless frames for every --record-threads count from 0(inline) to the thread pool's size
+//and prints the scene's recording time for each,e.g. on a scene generated by loader_bench --out
+//--dynamic-resolution scales the scene so the gpu frame time stays within a budget in ms,down to --min-scale
+//--present-mode immediate|mailbox|fifo|fifo-relaxed,--swapchain-images,--fps-limit and --max-queued-presents set up frame pacing
 int main(int argc, char* argv[]){
+    RendererOptions options;
+    bool headless = false;
+    uint32_t frameCount = 600;
+    const char* output = nullptr;
+    const char* batchList = nullptr;
+    std::string outDir = "thumbnails";
+    const char* tracePath = nullptr;
+    bool recordScaling = false;
+    for(int i=1;i<argc;++i){
+        if(std::strcmp(argv[i],"--frames-in-flight")==0&&i+1<argc){
+            options.framesInFlight = (uint32_t)std::strtoul(argv[++i],nullptr,10);
+        }
+        else if(std::strcmp(argv[i],"--scene")==0&&i+1<argc){
+            options.scenePath = argv[++i];
+        }
+        else if(std::strcmp(argv[i],"--headless")==0){
+            headless = true;
+        }
+        else if(std::strcmp(argv[i],"--width")==0&&i+1<argc){
+            options.extent.width = (uint32_t)std::strtoul(argv[++i],nullptr,10);
+        }
+        else if(std::strcmp(argv[i],"--height")==0&&i+1<argc){
+            options.extent.height = (uint32_t)std::strtoul(argv[++i],nullptr,10);
+        }
+        else if(std::strcmp(argv[i],"--frames")==0&&i+1<argc){
+            frameCount = (uint32_t)std::strtoul(argv[++i],nullptr,10);
+        }
+        else if(std::strcmp(argv[i],"--output")==0&&i+1<argc){
+            output = argv[++i];
+        }
+        else if(std::strcmp(argv[i],"--batch")==0&&i+1<argc){
+            batchList = argv[++i];
+        }
+        else if(std::strcmp(argv[i],"--out-dir")==0&&i+1<argc){
+            outDir = argv[++i];
+        }
+        else if(std::strcmp(argv[i],"--capture")==0&&i+1<argc){
+            options.captureFromStart = true;
+            options.capture.directory = argv[++i];
+        }
+        else if(std::strcmp(argv[i],"--trace")==0&&i+1<argc){
+            tracePath = argv[++i];
+        }
+        else if(std::strcmp(argv[i],"--capture-format")==0&&i+1<argc){
+            ++i;
+            options.capture.format = std::strcmp(argv[i],"png")==0?CaptureFormat::ePng:CaptureFormat::eTga;
+        }
+        else if(std::strcmp(argv[i],"--record-threads")==0&&i+1<argc){
+            options.recordThreads = (uint32_t)std::strtoul(argv[++i],nullptr,10);
+        }
+        else if(std::strcmp(argv[i],"--record-scaling")==0){
+            headless = true;
+            recordScaling = true;
+        }
+        else if(std::strcmp(argv[i],"--dynamic-resolution")==0&&i+1<argc){
+            options.resolution.enabled = true;
+            options.resolution.gpuBudget = std::strtof(argv[++i],nullptr);
+        }
+        else if(std::strcmp(argv[i],"--min-scale")==0&&i+1<argc){
+            options.resolution.minScale = std::strtof(argv[++i],nullptr);
+        }
+        else if(std::strcmp(argv[i],"--present-mode")==0&&i+1<argc){
+            ++i;
+            if(std::strcmp(argv[i],"immediate")==0){
+                options.pacing.presentMode = vk::PresentModeKHR::eImmediate;
+            }
+            else if(std::strcmp(argv[i],"fifo")==0){
+                options.pacing.presentMode = vk::PresentModeKHR::eFifo;
+            }
+            else if(std::strcmp(argv[i],"fifo-relaxed")==0){
+                options.pacing.presentMode = vk::PresentModeKHR::eFifoRelaxed;
+            }
+            else{
+                options.pacing.presentMode = vk::PresentModeKHR::eMailbox;
+            }
+        }
+        else if(std::strcmp(argv[i],"--swapchain-images")==0&&i+1<argc){
+            options.pacing.imageCount = (uint32_t)std::strtoul(argv[++i],nullptr,10);
+        }
+        else if(std::strcmp(argv[i],"--fps-limit")==0&&i+1<argc){
+            options.pacing.fpsLimit = std::strtof(argv[++i],nullptr);
+        }
+        else if(std::strcmp(argv[i],"--max-queued-presents")==0&&i+1<argc){
+            options.pacing.maxQueuedPresents = (uint32_t)std::strtoul(argv[++i],nullptr,10);
+        }
+    }
+    //written once every renderer is destroyed,whichever way main returns
+    struct TraceFile{
+        const char* path;
+        ~TraceFile(){
+            if(path&&!Tracer::stop(path)){
+                std::cerr<<"failed to write "<<path<<"!"<<std::endl;
+            }
+        }
+    } traceFile{tracePath};
+    Tracer::setThreadName("main");
+    if(tracePath){
+        Tracer::start();
+    }
+
+    if(batchList){
+        std::ifstream list(batchList);
+        if(!list.is_open()){
+            std::cerr<<"failed to open "<<batchList<<"!"<<std::endl;
+            return 1;
+        }
+        std::vector<std::string> paths;
+        std::string line;
+        while(std::getline(list,line)){
+            if(!line.empty()&&line.back()=='\r'){
+                line.pop_back();
+            }
+            if(!line.empty()&&line[0]!='#'){
+                paths.push_back(line);
+            }
+        }
+        if(paths.empty()){
+            std::cerr<<batchList<<" lists no assets!"<<std::endl;
+            return 1;
+        }
+        try{
+            //every asset is loaded by the batch,one that fails is skipped instead of failing the renderer
+            options.scenePath.clear();
+            Renderer renderer(RendererMode::eHeadless,options);
+            ThumbnailBatch batch(&renderer);
+            const ThumbnailStats& stats = batch.run(paths,outDir);
+            uint32_t assets = stats.rendered+stats.failed;
+            auto perAsset = [&](double ms){
+                return stats.rendered?ms/stats.rendered:0.0;
+            };
+            std::cout<<stats.rendered<<"/"<<assets<<" thumbnails at "<<options.extent.width<<"x"<<options.extent.height<<" in "<<stats.total<<"ms,"
+            <<stats.assetsPerSecond()<<" assets/s\n"
+            <<"per asset:read wait "<<perAsset(stats.readWait)<<"ms,upload "<<perAsset(stats.upload)<<"ms,render "<<perAsset(stats.render)
+            <<"ms,readback "<<perAsset(stats.readback)<<"ms,write wait "<<perAsset(stats.writeWait)<<"ms\n";
+            if(stats.failed){
+                return 1;
+            }
+        }
+        catch(std::runtime_error err){
+            std::cerr<<err.what()<<std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if(recordScaling){
+        try{
+            Renderer renderer(RendererMode::eHeadless,options);
+            double inlineMs = 0;
+            for(uint32_t threads=0;threads<=renderer.getMaxRecordThreads();++threads){
+                renderer.setRecordThreads(threads);
+                for(uint32_t i=0;i<frameCount;++i){
+                    renderer.tick();
+                }
+                //smoothed,so it is the time of the last frames only
+                const FrameTimings& timings = renderer.getFrameTimings();
+                if(threads==0){
+                    inlineMs = timings.sceneRecord;
+                    std::cout<<"inline:scene record "<<timings.sceneRecord<<"ms,record "<<timings.record<<"ms\n";
+                }
+                else{
+                    std::cout<<threads<<" threads:scene record "<<timings.sceneRecord<<"ms,record "<<timings.record<<"ms,"
+                    <<(timings.sceneRecord>0?inlineMs/timings.sceneRecord:0.0)<<"x inline\n";
+                }
+            }
+        }
+        catch(std::runtime_error err){
+            std::cerr<<err.what()<<std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if(headless){
+        try{
+            Renderer renderer(RendererMode::eHeadless,options);
+            auto start = std::chrono::high_resolution_clock::now();
+            for(uint32_t i=0;i<frameCount;++i){
+                renderer.tick();
+            }
+            if(output){
+                renderer.saveFrame(output);
+            }
+            double ms = std::chrono::duration<double,std::milli>(std::chrono::high_resolution_clock::now()-start).count();
+            const FrameTimings& timings = renderer.getFrameTimings();
+            std::cout<<frameCount<<" frames at "<<options.extent.width<<"x"<<options.extent.height<<" in "<<ms<<"ms,"
+            <<(frameCount?ms/frameCount:0.0)<<"ms/frame,gpu "<<timings.gpu<<"ms/frame\n";
+        }
+        catch(std::runtime_error err){
+            std::cerr<<err.what()<<std::endl;
+            return 1;
+        }
+        return 0;
+    }
 
     SDL_Init(SDL_INIT_EVERYTHING);
     try{
-        Renderer renderer;
+        Renderer renderer(RendererMode::eWindowed,options);
         while(renderer.tick()){}
     }
     catch(std::runtime_error err){
@@ -13,4 +221,4 @@ int main(int argc, char* argv[]){
     }
     SDL_Quit();
     return 0;
-}
\ No newline at end of file
+}
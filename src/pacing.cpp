@@ -0,0 +1,127 @@
+#include"pacing.h"
+#include"renderer.h"
+#include"trace.h"
+
+#include<thread>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include<windows.h>
+#endif
+
+static void smooth(float& value,float sample){
+    value = value*0.95f+sample*0.05f;
+}
+
+FramePacer::FramePacer(Renderer* renderer):renderer(renderer)
+{
+    presentWait = renderer->presentWaitSupported;
+    nextFrameTime = std::chrono::high_resolution_clock::now();
+#ifdef _WIN32
+    timer = CreateWaitableTimerExW(nullptr,nullptr,CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,TIMER_ALL_ACCESS);
+#endif
+}
+
+FramePacer::~FramePacer()
+{
+#ifdef _WIN32
+    if(timer){
+        CloseHandle(timer);
+    }
+#endif
+}
+
+void FramePacer::waitForFrameStart()
+{
+    TraceScope scope("frame pacing");
+    auto start = std::chrono::high_resolution_clock::now();
+    const PacingOptions& options = renderer->options.pacing;
+    if(presentWait){
+        //whatever was presented since the last frame,without blocking
+        waitForPresent(presentId,0);
+        if(options.maxQueuedPresents&&presentId>options.maxQueuedPresents){
+            //a second at most,a minimized window may never present
+            waitForPresent(presentId-options.maxQueuedPresents,1000000000ull);
+        }
+    }
+    limitFrameRate();
+    inputTime = std::chrono::high_resolution_clock::now();
+    smooth(stats.pacingWait,std::chrono::duration<float,std::milli>(inputTime-start).count());
+}
+
+void FramePacer::limitFrameRate()
+{
+    float fpsLimit = renderer->options.pacing.fpsLimit;
+    auto now = std::chrono::high_resolution_clock::now();
+    if(fpsLimit<=0){
+        nextFrameTime = now;
+        return;
+    }
+    auto period = std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double>(1.0/fpsLimit));
+    //a frame that ran long moves the schedule instead of letting the next frames catch up in a burst
+    if(now-nextFrameTime>period){
+        nextFrameTime = now;
+    }
+    auto target = nextFrameTime;
+    nextFrameTime += period;
+    auto margin = std::chrono::duration<double,std::milli>(PACING_SPIN_MARGIN);
+    auto sleepTime = target-now-margin;
+    if(sleepTime.count()>0){
+#ifdef _WIN32
+        if(timer){
+            //relative due time in 100ns units
+            LARGE_INTEGER due;
+            due.QuadPart = -int64_t(std::chrono::duration<double>(sleepTime).count()*10000000.0);
+            SetWaitableTimer(timer,&due,0,nullptr,nullptr,false);
+            WaitForSingleObject(timer,INFINITE);
+        }
+#else
+        std::this_thread::sleep_for(sleepTime);
+#endif
+    }
+    while(std::chrono::high_resolution_clock::now()<target){
+        std::this_thread::yield();
+    }
+}
+
+bool FramePacer::waitForPresent(uint64_t id,uint64_t timeout)
+{
+    while(presentedId<id){
+        vk::Result result;
+        try{
+            result = renderer->lDevice.waitForPresentKHR(renderer->swapchain,presentedId+1,timeout,renderer->dld);
+        }
+        catch(vk::SystemError){
+            //out of date,the swapchain is recreated before the next present
+            return false;
+        }
+        if(result!=vk::Result::eSuccess&&result!=vk::Result::eSuboptimalKHR){
+            return false;
+        }
+        ++presentedId;
+        auto input = inputTimes[presentedId%PACING_LATENCY_HISTORY];
+        smooth(stats.inputToPresented,std::chrono::duration<float,std::milli>(std::chrono::high_resolution_clock::now()-input).count());
+    }
+    return true;
+}
+
+void FramePacer::beforePresent(vk::PresentInfoKHR& presentInfo)
+{
+    ++presentId;
+    inputTimes[presentId%PACING_LATENCY_HISTORY] = inputTime;
+    if(presentWait){
+        presentIdInfo.setPresentIds(presentId);
+        presentInfo.setPNext(&presentIdInfo);
+    }
+}
+
+void FramePacer::afterPresent()
+{
+    smooth(stats.inputToPresentCall,std::chrono::duration<float,std::milli>(std::chrono::high_resolution_clock::now()-inputTime).count());
+}
+
+void FramePacer::swapchainRecreated()
+{
+    presentId = 0;
+    presentedId = 0;
+}
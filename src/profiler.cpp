@@ -0,0 +1,308 @@
+#include"profiler.h"
+#include"renderer.h"
+#include"trace.h"
+
+#include<algorithm>
+#include<cstring>
+#include<array>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include<windows.h>
+#endif
+
+#define STATISTICS_FLAGS (vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives|\
+vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations|vk::QueryPipelineStatisticFlagBits::eClippingPrimitives|\
+vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations|vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations)
+
+static uint64_t validBitsMask(uint32_t validBits){
+    return validBits>=64?~0ull:(1ull<<validBits)-1;
+}
+//collected frames between calibrations,the clocks drift apart slowly
+#define CALIBRATION_INTERVAL 256
+
+Profiler::Profiler(Renderer* renderer,uint32_t framesInFlight):renderer(renderer)
+{
+    auto families = renderer->pDevice.getQueueFamilyProperties();
+    uint32_t graphicsBits = families[renderer->queueFamilyIndices.graphicQueueFamily.value()].timestampValidBits;
+    uint32_t computeBits = families[renderer->queueFamilyIndices.computeQueueFamily.value()].timestampValidBits;
+    hostReset = renderer->hostQueryResetSupported;
+    graphicsTimestamps = graphicsBits>0;
+    computeTimestamps = computeBits>0&&hostReset;
+    graphicsMask = validBitsMask(graphicsBits);
+    computeMask = validBitsMask(computeBits);
+    statistics = renderer->pipelineStatisticsSupported;
+    timestampPeriod = renderer->pDevice.getProperties().limits.timestampPeriod;
+
+    frames.resize(framesInFlight);
+    for(auto& frame:frames){
+        if(graphicsTimestamps){
+            vk::QueryPoolCreateInfo createInfo;
+            createInfo.setQueryType(vk::QueryType::eTimestamp);
+            createInfo.setQueryCount(PROFILER_MAX_ZONES*2);
+            frame.timestampPool = renderer->lDevice.createQueryPool(createInfo);
+            if(hostReset){
+                renderer->lDevice.resetQueryPool(frame.timestampPool,0,PROFILER_MAX_ZONES*2);
+            }
+        }
+        if(statistics){
+            vk::QueryPoolCreateInfo createInfo;
+            createInfo.setQueryType(vk::QueryType::ePipelineStatistics);
+            createInfo.setQueryCount(1);
+            createInfo.setPipelineStatistics(STATISTICS_FLAGS);
+            frame.statisticsPool = renderer->lDevice.createQueryPool(createInfo);
+            if(hostReset){
+                renderer->lDevice.resetQueryPool(frame.statisticsPool,0,1);
+            }
+        }
+        frame.zones.reserve(PROFILER_MAX_ZONES);
+    }
+}
+
+Profiler::~Profiler()
+{
+    for(auto& frame:frames){
+        if(frame.timestampPool){
+            renderer->lDevice.destroyQueryPool(frame.timestampPool);
+        }
+        if(frame.statisticsPool){
+            renderer->lDevice.destroyQueryPool(frame.statisticsPool);
+        }
+    }
+}
+
+void Profiler::collect(uint32_t frameIndex)
+{
+    Frame& frame = frames[frameIndex];
+    if(!frame.zones.empty()){
+        uint32_t count = frame.zones.size()*2;
+        uint64_t timestamps[PROFILER_MAX_ZONES*2];
+        //no wait flag,the fence covers every queue the zones were written on
+        auto result = renderer->lDevice.getQueryPoolResults(frame.timestampPool,0,count,sizeof(uint64_t)*count,timestamps,
+        sizeof(uint64_t),vk::QueryResultFlagBits::e64);
+        bool tracing = Tracer::enabled();
+        if(tracing&&calibrationCountdown--==0){
+            calibrate();
+            //the fallback waits for the device,it only runs once
+            calibrationCountdown = renderer->calibratedTimestampsSupported?CALIBRATION_INTERVAL:UINT32_MAX;
+        }
+        if(result==vk::Result::eSuccess&&!paused){
+            for(uint32_t i=0;i<frame.zones.size();++i){
+                FrameZone& zone = frame.zones[i];
+                uint64_t mask = zone.queue==ProfilerQueue::eCompute?computeMask:graphicsMask;
+                uint64_t ticks = (timestamps[zone.query+1]-timestamps[zone.query])&mask;
+                float ms = ticks*timestampPeriod/1000000.0f;
+                addSample(getZone(zone.name,true),ms);
+                if((int)i==frame.frameZone){
+                    gpuFrameTime = ms;
+                }
+            }
+        }
+        if(result==vk::Result::eSuccess&&tracing){
+            for(auto& zone:frame.zones){
+                int64_t begin = int64_t(timestamps[zone.query]*(double)timestampPeriod)+gpuOffset;
+                int64_t end = int64_t(timestamps[zone.query+1]*(double)timestampPeriod)+gpuOffset;
+                Tracer::trackZone(zone.queue==ProfilerQueue::eCompute?computeTrack:graphicsTrack,zone.name,begin,end);
+            }
+        }
+        if(hostReset){
+            renderer->lDevice.resetQueryPool(frame.timestampPool,0,count);
+        }
+    }
+    frame.zones.clear();
+    frame.openZones.clear();
+    frame.frameZone = -1;
+    if(frame.statisticsWritten){
+        PipelineStatistics results;
+        auto result = renderer->lDevice.getQueryPoolResults(frame.statisticsPool,0,1,sizeof(results),&results,
+        sizeof(results),vk::QueryResultFlagBits::e64);
+        if(result==vk::Result::eSuccess&&!paused){
+            lastStatistics = results;
+        }
+        if(hostReset){
+            renderer->lDevice.resetQueryPool(frame.statisticsPool,0,1);
+        }
+        frame.statisticsWritten = false;
+    }
+}
+
+void Profiler::calibrate()
+{
+    if(!graphicsTrack){
+        graphicsTrack = Tracer::getTrack("gpu graphics queue");
+        computeTrack = Tracer::getTrack("gpu compute queue");
+    }
+    if(renderer->calibratedTimestampsSupported){
+#ifdef _WIN32
+        vk::TimeDomainEXT hostDomain = vk::TimeDomainEXT::eQueryPerformanceCounter;
+#else
+        vk::TimeDomainEXT hostDomain = vk::TimeDomainEXT::eClockMonotonic;
+#endif
+        std::array<vk::CalibratedTimestampInfoEXT,2> infos = {
+            vk::CalibratedTimestampInfoEXT(vk::TimeDomainEXT::eDevice),
+            vk::CalibratedTimestampInfoEXT(hostDomain),
+        };
+        auto [timestamps,deviation] = renderer->lDevice.getCalibratedTimestampsEXT(infos,renderer->dld);
+        int64_t host = timestamps[1];
+#ifdef _WIN32
+        //steady_clock is the performance counter too,in ns
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        host = int64_t(timestamps[1]*(1000000000.0/frequency.QuadPart));
+#endif
+        gpuOffset = host-int64_t(timestamps[0]*(double)timestampPeriod);
+        return;
+    }
+    if(!graphicsTimestamps){
+        return;
+    }
+    vk::QueryPoolCreateInfo createInfo;
+    createInfo.setQueryType(vk::QueryType::eTimestamp);
+    createInfo.setQueryCount(1);
+    vk::QueryPool pool = renderer->lDevice.createQueryPool(createInfo);
+    vk::CommandBuffer cb = renderer->startOneShotCommandBuffer(renderer->graphicCommandPool);
+    cb.resetQueryPool(pool,0,1);
+    cb.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,pool,0);
+    int64_t submitted = Tracer::now();
+    renderer->finishOneShotCommandBuffer(renderer->graphicCommandPool,cb,renderer->graphicQueue);
+    uint64_t timestamp;
+    auto result = renderer->lDevice.getQueryPoolResults(pool,0,1,sizeof(timestamp),&timestamp,sizeof(timestamp),
+    vk::QueryResultFlagBits::e64|vk::QueryResultFlagBits::eWait);
+    renderer->lDevice.destroyQueryPool(pool);
+    if(result==vk::Result::eSuccess){
+        gpuOffset = submitted-int64_t(timestamp*(double)timestampPeriod);
+    }
+}
+
+void Profiler::beginFrame(vk::CommandBuffer commandBuffer,uint32_t frameIndex)
+{
+    Frame& frame = frames[frameIndex];
+    if(!hostReset){
+        if(graphicsTimestamps){
+            commandBuffer.resetQueryPool(frame.timestampPool,0,PROFILER_MAX_ZONES*2);
+        }
+        if(statistics){
+            commandBuffer.resetQueryPool(frame.statisticsPool,0,1);
+        }
+    }
+    frame.frameZone = frame.zones.size();
+    beginZone(commandBuffer,frameIndex,"gpu frame");
+}
+
+void Profiler::endFrame(vk::CommandBuffer commandBuffer,uint32_t frameIndex)
+{
+    endZone(commandBuffer,frameIndex);
+}
+
+void Profiler::beginZone(vk::CommandBuffer commandBuffer,uint32_t frameIndex,const char* name,ProfilerQueue queue)
+{
+    Frame& frame = frames[frameIndex];
+    bool timed = queue==ProfilerQueue::eCompute?computeTimestamps:graphicsTimestamps;
+    if(!timed||frame.zones.size()>=PROFILER_MAX_ZONES){
+        frame.openZones.push_back(-1);
+        return;
+    }
+    FrameZone zone;
+    zone.name = name;
+    zone.query = frame.zones.size()*2;
+    zone.queue = queue;
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,frame.timestampPool,zone.query);
+    frame.openZones.push_back(frame.zones.size());
+    frame.zones.push_back(zone);
+}
+
+void Profiler::endZone(vk::CommandBuffer commandBuffer,uint32_t frameIndex)
+{
+    Frame& frame = frames[frameIndex];
+    int zone = frame.openZones.back();
+    frame.openZones.pop_back();
+    if(zone<0){
+        return;
+    }
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,frame.timestampPool,frame.zones[zone].query+1);
+}
+
+void Profiler::beginStatistics(vk::CommandBuffer commandBuffer,uint32_t frameIndex)
+{
+    if(statistics){
+        commandBuffer.beginQuery(frames[frameIndex].statisticsPool,0,vk::QueryControlFlags());
+    }
+}
+
+void Profiler::endStatistics(vk::CommandBuffer commandBuffer,uint32_t frameIndex)
+{
+    if(statistics){
+        commandBuffer.endQuery(frames[frameIndex].statisticsPool,0);
+        frames[frameIndex].statisticsWritten = true;
+    }
+}
+
+vk::QueryPipelineStatisticFlags Profiler::getStatisticsFlags() const
+{
+    return statistics?vk::QueryPipelineStatisticFlags(STATISTICS_FLAGS):vk::QueryPipelineStatisticFlags();
+}
+
+void Profiler::addCpuSample(const char* name,float ms)
+{
+    if(!paused){
+        addSample(getZone(name,false),ms);
+    }
+}
+
+ProfilerZone& Profiler::getZone(const char* name,bool gpu)
+{
+    for(auto& zone:zones){
+        if(zone.gpu==gpu&&std::strcmp(zone.name,name)==0){
+            return zone;
+        }
+    }
+    ProfilerZone zone;
+    zone.name = name;
+    zone.gpu = gpu;
+    zone.history.reserve(PROFILER_HISTORY);
+    zones.push_back(zone);
+    return zones.back();
+}
+
+void Profiler::addSample(ProfilerZone& zone,float ms)
+{
+    if(zone.history.size()<PROFILER_HISTORY){
+        zone.history.push_back(ms);
+    }
+    else{
+        zone.history[zone.next] = ms;
+        zone.next = (zone.next+1)%PROFILER_HISTORY;
+    }
+    zone.last = ms;
+}
+
+void Profiler::drawUI()
+{
+    if(ImGui::Begin("profiler")){
+        ImGui::Checkbox("paused",&paused);
+        std::vector<float> sorted;
+        for(auto& zone:zones){
+            sorted = zone.history;
+            std::sort(sorted.begin(),sorted.end());
+            auto percentile = [&](float p){
+                return sorted.empty()?0.0f:sorted[std::min<size_t>(sorted.size()-1,size_t(p*sorted.size()))];
+            };
+            zone.p50 = percentile(0.50f);
+            zone.p95 = percentile(0.95f);
+            zone.p99 = percentile(0.99f);
+            ImGui::PushID(&zone);
+            ImGui::Text("%s %s:%.3fms,p50 %.3f,p95 %.3f,p99 %.3f",zone.gpu?"gpu":"cpu",zone.name,zone.last,zone.p50,zone.p95,zone.p99);
+            ImGui::PlotLines("##history",zone.history.data(),zone.history.size(),zone.next,nullptr,0.0f,zone.p99*1.25f,ImVec2(0,40));
+            ImGui::PopID();
+        }
+        if(statistics){
+            ImGui::Separator();
+            ImGui::BulletText("input primitives:%llu",(unsigned long long)lastStatistics.inputPrimitives);
+            ImGui::BulletText("vertex invocations:%llu",(unsigned long long)lastStatistics.vertexInvocations);
+            ImGui::BulletText("clipped primitives:%llu",(unsigned long long)lastStatistics.clippingPrimitives);
+            ImGui::BulletText("fragment invocations:%llu",(unsigned long long)lastStatistics.fragmentInvocations);
+            ImGui::BulletText("compute invocations:%llu",(unsigned long long)lastStatistics.computeInvocations);
+        }
+    }
+    ImGui::End();
+}
@@ -0,0 +1,93 @@
+#include"recorder.h"
+#include"renderer.h"
+#include"threadpool.h"
+#include"trace.h"
+
+#include<algorithm>
+
+DrawRecorder::DrawRecorder(Renderer* renderer,uint32_t framesInFlight):renderer(renderer)
+{
+    frames.resize(framesInFlight);
+    for(auto& frame:frames){
+        frame.chunks.resize(RECORDER_MAX_CHUNKS);
+        for(auto& chunk:frame.chunks){
+            vk::CommandPoolCreateInfo poolInfo;
+            poolInfo.setQueueFamilyIndex(renderer->queueFamilyIndices.graphicQueueFamily.value());
+            poolInfo.setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+            chunk.pool = renderer->lDevice.createCommandPool(poolInfo);
+        }
+    }
+}
+
+DrawRecorder::~DrawRecorder()
+{
+    for(auto& frame:frames){
+        for(auto& chunk:frame.chunks){
+            //frees the command buffers too
+            renderer->lDevice.destroyCommandPool(chunk.pool);
+        }
+    }
+}
+
+void DrawRecorder::reset(uint32_t frameIndex)
+{
+    for(auto& chunk:frames[frameIndex].chunks){
+        if(chunk.used){
+            renderer->lDevice.resetCommandPool(chunk.pool);
+            chunk.used = 0;
+        }
+    }
+}
+
+uint32_t DrawRecorder::getThreadCount() const
+{
+    return renderer->threadPool->getThreadCount();
+}
+
+std::vector<vk::CommandBuffer> DrawRecorder::record(uint32_t frameIndex,uint32_t chunkCount,const vk::CommandBufferInheritanceInfo& inheritance,
+const std::vector<uint32_t>& costs,const std::function<void(vk::CommandBuffer,uint32_t,uint32_t)>& recordRange)
+{
+    Frame& frame = frames[frameIndex];
+    uint32_t drawCount = costs.size();
+    chunkCount = std::clamp<uint32_t>(chunkCount,1,RECORDER_MAX_CHUNKS);
+    chunkCount = std::min(chunkCount,std::max(drawCount,1u));
+
+    //chunk k ends at the first draw whose cost prefix reaches (k+1)/chunkCount of the total
+    uint64_t totalCost = 0;
+    for(auto cost:costs){
+        totalCost += cost;
+    }
+    std::vector<uint32_t> ends(chunkCount,drawCount);
+    uint64_t prefix = 0;
+    uint32_t k = 0;
+    for(uint32_t i=0;i<drawCount&&k+1<chunkCount;++i){
+        prefix += costs[i];
+        while(k+1<chunkCount&&prefix*chunkCount>=totalCost*(k+1)){
+            ends[k++] = i+1;
+        }
+    }
+
+    std::vector<vk::CommandBuffer> commandBuffers(chunkCount);
+    renderer->threadPool->parallelFor(chunkCount,1,[&](uint32_t begin,uint32_t end){
+        for(uint32_t c=begin;c<end;++c){
+            TraceScope scope("record chunk");
+            Chunk& chunk = frame.chunks[c];
+            if(chunk.used==chunk.commandBuffers.size()){
+                vk::CommandBufferAllocateInfo allocateInfo;
+                allocateInfo.setCommandPool(chunk.pool);
+                allocateInfo.setLevel(vk::CommandBufferLevel::eSecondary);
+                allocateInfo.setCommandBufferCount(1);
+                chunk.commandBuffers.push_back(renderer->lDevice.allocateCommandBuffers(allocateInfo)[0]);
+            }
+            vk::CommandBuffer commandBuffer = chunk.commandBuffers[chunk.used++];
+            vk::CommandBufferBeginInfo beginInfo;
+            beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit|vk::CommandBufferUsageFlagBits::eRenderPassContinue);
+            beginInfo.setPInheritanceInfo(&inheritance);
+            commandBuffer.begin(beginInfo);
+            recordRange(commandBuffer,c?ends[c-1]:0,ends[c]);
+            commandBuffer.end();
+            commandBuffers[c] = commandBuffer;
+        }
+    });
+    return commandBuffers;
+}
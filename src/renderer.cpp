@@ -1,10 +1,22 @@
 #include "renderer.h"
 #include"vkglTF.h"
+#include"threadpool.h"
+#include"deform.h"
+#include"cull.h"
+#include"capture.h"
+#include"profiler.h"
+#include"trace.h"
+#include"stb_image_write.h"
 
 #include<iostream>
 #include<fstream>
 #include<string>
 #include<set>
+#include<algorithm>
+#include<array>
+#include<cstring>
+#include<cmath>
+#include<thread>
 const uint64_t notimeout = std::numeric_limits<uint64_t>::max();
 void Renderer::checkVkResult(VkResult result)
 {
@@ -28,8 +40,10 @@ VKAPI_ATTR VkBool32 VKAPI_CALL Renderer::debugMessengerCallback(
     return VK_FALSE;
 }
 
-Renderer::Renderer()
+Renderer::Renderer(RendererMode mode,const RendererOptions& options):mode(mode),options(options),
+resolution(options.resolution),framesInFlight(std::clamp(options.framesInFlight,1u,(uint32_t)MAX_FRAMES_IN_FLIGHT))
 {
+    setRecordThreads(options.recordThreads);
     init();
 }
 
@@ -40,33 +54,77 @@ Renderer::~Renderer()
 
 void Renderer::init()
 {
-    initSDL();
+    //the modes share everything up to the frame's target:a window's swapchain or offscreen images,
+    //eDeviceOnly stops before it and only loads scenes
+    bool windowed = mode==RendererMode::eWindowed;
+    if(windowed){
+        initSDL();
+    }
     initVkInstance();
     initDLD();
     initDebugMessenger();
-    initSurface();
+    if(windowed){
+        initSurface();
+    }
     initLogicalDevice();
+    initPipelineCache();
+    allocator.init(pDevice,lDevice);
     initCommandPool();
-    initCommandBuffers();
     initDescriptorPool();
+    threadPool = new vkglTF::ThreadPool();
+    if(mode==RendererMode::eDeviceOnly){
+        return;
+    }
+    initCommandBuffers();
+    if(windowed){
+        initSwapchain();
+    }
+    else{
+        initOffscreenImages();
+    }
+    //the cull pass sizes its depth pyramid from the scene target
+    initSceneTarget();
     initglTFScene();
-    initSwapchain();
-    initDepthResources();
     initCamera();
     initRenderPass();
     initPipelineLayouts();
     initPipelines();
+    initUpscalePipeline();
     initFramebuffer();
+    initUpscaleSet();
     initSyncObjects();
-    initImGui();
+    initProfiler();
+    recorder = new DrawRecorder(this,framesInFlight);
+    if(windowed){
+        initImGui();
+        pacer = new FramePacer(this);
+    }
+    std::cout<<pipelineCacheStats.pipelineCount<<" pipelines created in "<<pipelineCacheStats.creationTime<<"ms,"
+    <<(pipelineCacheStats.warm?"warm":"cold")<<" pipeline cache\n";
+    if(options.captureFromStart){
+        startCapture(options.capture);
+    }
 }
 
 bool Renderer::tick()
 {
-    bool handleResult = handleEvents();
+    if(pacer){
+        pacer->waitForFrameStart();
+    }
+    bool handleResult;
+    {
+        ProfileScope scope(profiler,"handleEvents");
+        handleResult = handleEvents();
+    }
     if(!handleResult){
         return false;
     }
+    //nothing is presented until the window is restored
+    if(windowMinimized){
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return true;
+    }
+    ProfileScope scope(profiler,"render");
     render();
     return true;
 }
@@ -74,42 +132,86 @@ bool Renderer::tick()
 void Renderer::cleanup()
 {
     lDevice.waitIdle();
-    ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplSDL2_Shutdown();
-    ImGui::DestroyContext();
+    //eDeviceOnly has nothing of the frame to destroy
+    if(mode!=RendererMode::eDeviceOnly){
+        destroyRetired(true);
+        delete capture;
+        capture = nullptr;
+        delete pacer;
+        pacer = nullptr;
+        if(mode==RendererMode::eWindowed){
+            ImGui_ImplVulkan_Shutdown();
+            ImGui_ImplSDL2_Shutdown();
+            ImGui::DestroyContext();
+        }
 
-    lDevice.destroySemaphore(imageAvaliable);
-    lDevice.destroySemaphore(renderingFinished);
-    lDevice.destroyFence(inflightFence);
-    
-    for(int i=0;i<imguiFrameBuffers.size();++i){
-        lDevice.destroyFramebuffer(imguiFrameBuffers[i]);
-        lDevice.destroyFramebuffer(defaultGraphicFrameBuffers[i]);
-    }
-    lDevice.destroyPipeline(defaultGraphicPipeline);
-    lDevice.destroyPipelineLayout(defaultGraphicPipelineLayout);
-    lDevice.destroyRenderPass(defaultGraphicRenderPass);
-    lDevice.destroyRenderPass(imguiRenderPass);
-       for(int i=0;i<swapchainImageViews.size();++i){
-        lDevice.destroyImageView(swapchainImageViews[i]);
+        for(auto& frame:frames){
+            lDevice.destroySemaphore(frame.imageAvaliable);
+            lDevice.destroyFence(frame.inflightFence);
+            lDevice.freeCommandBuffers(graphicCommandPool,frame.commandBuffer);
+        }
+        for(auto semaphore:renderingFinished){
+            lDevice.destroySemaphore(semaphore);
+        }
+        delete profiler;
+        delete recorder;
+
+        for(auto frameBuffer:frameBuffers){
+            lDevice.destroyFramebuffer(frameBuffer);
+        }
+        lDevice.destroyFramebuffer(sceneFramebuffer);
+        for(auto pipeline:graphicPipelines){
+            lDevice.destroyPipeline(pipeline);
+        }
+        lDevice.destroyPipelineLayout(defaultGraphicPipelineLayout);
+        lDevice.destroyPipeline(upscalePipeline);
+        lDevice.destroyPipelineLayout(upscalePipelineLayout);
+        lDevice.destroyDescriptorSetLayout(upscaleSetLayout);
+        lDevice.destroySampler(upscaleSampler);
+        lDevice.destroyRenderPass(defaultGraphicRenderPass);
+        lDevice.destroyRenderPass(earlyGraphicRenderPass);
+        lDevice.destroyRenderPass(lateGraphicRenderPass);
+        lDevice.destroyRenderPass(outputRenderPass);
+        for(int i=0;i<swapchainImageViews.size();++i){
+            lDevice.destroyImageView(swapchainImageViews[i]);
+        }
+        destroySceneTarget();
+        if(mode==RendererMode::eHeadless){
+            for(int i=0;i<swapchainImages.size();++i){
+                destroyImage(swapchainImages[i],offscreenImageMemory[i]);
+            }
+        }
+        else{
+            lDevice.destroySwapchainKHR(swapchain);
+        }
+        delete cullPass;
+        delete deformPass;
+        delete glTFScene;
     }
-    lDevice.destroyImageView(depthImageView);
-    lDevice.destroyImage(depthImage);
-    lDevice.freeMemory(depthImageMemory);
-    lDevice.destroySwapchainKHR(swapchain);
-    delete glTFScene;
+    delete threadPool;
+    allocator.cleanup();
     lDevice.destroyDescriptorPool(descriptorPool);
     lDevice.destroyCommandPool(graphicCommandPool);
     lDevice.destroyCommandPool(computeCommandPool);
+    savePipelineCache();
     lDevice.destroy();
 
-    vkInstance.destroySurfaceKHR(surface);
-    vkInstance.destroyDebugUtilsMessengerEXT(debugMessenger,nullptr,dld);
+    if(surface){
+        vkInstance.destroySurfaceKHR(surface);
+    }
+    if(debugMessenger){
+        vkInstance.destroyDebugUtilsMessengerEXT(debugMessenger,nullptr,dld);
+    }
     vkInstance.destroy();
-    SDL_DestroyWindow(sdlWindow);
-    
+    if(sdlWindow){
+        SDL_DestroyWindow(sdlWindow);
+    }
 }
 bool Renderer::handleEvents(){
+    if(mode==RendererMode::eHeadless){
+        deltaTime = HEADLESS_FRAME_TIME;
+        return true;
+    }
     SDL_Event event;
 
     while(SDL_PollEvent(&event)){
@@ -130,7 +232,7 @@ bool Renderer::handleEvents(){
                     break;
                 case SDL_WINDOWEVENT_SIZE_CHANGED:
                     handled = true;
-                    reinitSwapchain();
+                    swapchainDirty = true;
                     break;
                 case SDL_WINDOWEVENT_LEAVE:
                     handled = true;
@@ -173,6 +275,20 @@ bool Renderer::handleEvents(){
                     handled = true;
                     moveRight = true;
                     break;
+                case SDLK_F12:
+                    handled = true;
+                    if(capture){
+                        stopCapture();
+                    }
+                    else{
+                        try{
+                            startCapture(options.capture);
+                        }
+                        catch(std::runtime_error err){
+                            std::cerr<<err.what()<<std::endl;
+                        }
+                    }
+                    break;
             }
         }
         else if(event.type == SDL_KEYUP){
@@ -218,7 +334,7 @@ bool Renderer::handleEvents(){
     }
 
     float nowSDLtime = SDL_GetTicks()/1000.0f;
-    float deltaTime = nowSDLtime - lastSDLtime;
+    deltaTime = nowSDLtime - lastSDLtime;
     lastSDLtime = nowSDLtime;
 
     if(moveLeft){
@@ -238,27 +354,143 @@ bool Renderer::handleEvents(){
     return true;
 }
 void Renderer::render(){
+    if(!glTFScene){
+        throw std::runtime_error("there is no scene to render,setScene has to give one first!");
+    }
+    //before anything signals semaphores this frame has to wait on.
+    //a window without area can't be rendered to,the frame is skipped until it has one again
+    if(swapchainDirty&&!reinitSwapchain()){
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return;
+    }
 
-    //imgui render
-    auto waitFenceResult = lDevice.waitForFences(inflightFence,true,notimeout);
-    lDevice.resetFences(inflightFence);
+    //animation and deformation are kicked off before waiting for the last frame,
+    //so the compute queue works on this frame while the last one is still rendering
+    bool animated;
+    {
+        ProfileScope scope(profiler,"animation");
+        animated = glTFScene->updateAnimations(deltaTime,threadPool);
+    }
+    vk::Semaphore deformFinished;
+    if(deformPass&&(animated||!deformPass->hasDispatched())){
+        deformFinished = deformPass->dispatch();
+    }
 
-    ImGui_ImplVulkan_NewFrame();
-    ImGui_ImplSDL2_NewFrame();
-    ImGui::NewFrame();
+    //wait for the frame that used these resources framesInFlight frames ago,
+    //the frames after it keep the GPU busy meanwhile
+    FrameResources& frame = frames[curFrame];
+    auto frameStart = std::chrono::high_resolution_clock::now();
+    vk::Result waitFenceResult;
     {
-        if(ImGui::Begin("fps")){
-            ImGui::BulletText("fps:%.3f",ImGui::GetIO().Framerate);
+        TraceScope scope("fence wait");
+        waitFenceResult = lDevice.waitForFences(frame.inflightFence,true,notimeout);
+    }
+    auto recordStart = std::chrono::high_resolution_clock::now();
+    profiler->collect(curFrame);
+    recorder->reset(curFrame);
+    destroyRetired(false);
+    profiler->addCpuSample("fence wait",std::chrono::duration<float,std::milli>(recordStart-frameStart).count());
+    //exponential average,so the overlay is readable
+    auto smooth = [](float& value,float sample){
+        value = value*0.95f+sample*0.05f;
+    };
+    smooth(frameTimings.cpuFrame,std::chrono::duration<float,std::milli>(frameStart-lastFrameStart).count());
+    smooth(frameTimings.fenceWait,std::chrono::duration<float,std::milli>(recordStart-frameStart).count());
+    smooth(frameTimings.gpu,profiler->getGpuFrameTime());
+    lastFrameStart = frameStart;
+    //copies recorded with this frame's last use are done
+    if(capture){
+        capture->collect(curFrame);
+    }
+
+    //this frame's copy of the matrices is no longer read by the GPU.
+    //releases rewrite descriptors every frame binds,so they wait for all frames
+    glTFScene->flushModelMats(curFrame);
+    if(glTFScene->hasPendingReleases()){
+        std::vector<vk::Fence> fences;
+        for(auto& other:frames){
+            fences.push_back(other.inflightFence);
         }
-        ImGui::End();
+        waitFenceResult = lDevice.waitForFences(fences,true,notimeout);
+        glTFScene->processReleases();
     }
-    ImGui::Render();
 
-    auto [result,frameIdx] = lDevice.acquireNextImageKHR(swapchain,notimeout,imageAvaliable);
-    
+    //before any culling is recorded:the early phase's uniforms carry the scale the late phase tests this frame's pyramid with
+    float scale = resolution.update(mode==RendererMode::eWindowed?profiler->getGpuFrameTime():0.0f,framesInFlight);
+    renderExtent = vk::Extent2D(std::max(uint32_t(sceneExtent.width*scale+0.5f),1u),std::max(uint32_t(sceneExtent.height*scale+0.5f),1u));
+
+    //culling reads the matrices just flushed,the graphics pass waits for it before reading the indirect commands
+    //occlusion culling reads the depth image,so it is recorded into the graphics command buffer below
+    vk::Semaphore cullFinished;
+    bool occlusion = cullPass&&occlusionCulling;
+    if(cullPass){
+        cullStats = cullPass->getStats(curFrame);
+        if(!occlusion){
+            cullFinished = cullPass->dispatch(curFrame,camera);
+        }
+    }
+
+    if(mode==RendererMode::eWindowed){
+        ProfileScope scope(profiler,"build ui");
+        buildUI();
+    }
+
+
+    //offscreen images are per frame in flight,so the frame's fence already covers them
+    uint32_t frameIdx = curFrame;
+    if(mode==RendererMode::eWindowed){
+        std::optional<uint32_t> imageIndex;
+        {
+            TraceScope scope("acquire");
+            imageIndex = acquireImage(frame.imageAvaliable);
+        }
+        if(!imageIndex){
+            //still wait on what deformation and culling signal,so their semaphores can be signaled again,
+            //and signal the fence the next frame waits on
+            std::vector<vk::Semaphore> waitSemaphores;
+            std::vector<vk::PipelineStageFlags> waitStages;
+            for(auto semaphore:{deformFinished,cullFinished}){
+                if(semaphore){
+                    waitSemaphores.push_back(semaphore);
+                    waitStages.push_back(vk::PipelineStageFlagBits::eAllCommands);
+                }
+            }
+            vk::SubmitInfo submitInfo;
+            submitInfo.setWaitSemaphores(waitSemaphores);
+            submitInfo.setWaitDstStageMask(waitStages);
+            lDevice.resetFences(frame.inflightFence);
+            graphicQueue.submit(submitInfo,frame.inflightFence);
+            return;
+        }
+        frameIdx = *imageIndex;
+    }
+    lastImage = frameIdx;
+    //with fewer swapchain images than frames in flight,another frame may still render into this image
+    if(imagesInFlight[frameIdx]&&imagesInFlight[frameIdx]!=frame.inflightFence){
+        waitFenceResult = lDevice.waitForFences(imagesInFlight[frameIdx],true,notimeout);
+    }
+    imagesInFlight[frameIdx] = frame.inflightFence;
+    lDevice.resetFences(frame.inflightFence);
+
+    //secondary command buffers can't be executed while a pipeline statistics query is active without inheritedQueries
+    bool parallel = cullPass&&options.recordThreads>0;
+    bool statistics = !parallel||inheritedQueriesSupported;
+    vk::SubpassContents sceneContents = parallel?vk::SubpassContents::eSecondaryCommandBuffers:vk::SubpassContents::eInline;
+
+    vk::CommandBuffer renderingCommandBuffers = frame.commandBuffer;
+    renderingCommandBuffers.reset();
     vk::CommandBufferBeginInfo beginInfo;
     beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
     renderingCommandBuffers.begin(beginInfo);
+    profiler->beginFrame(renderingCommandBuffers,curFrame);
+    if(statistics){
+        profiler->beginStatistics(renderingCommandBuffers,curFrame);
+    }
+    if(occlusion){
+        profiler->beginZone(renderingCommandBuffers,curFrame,"early cull");
+        cullPass->recordCull(renderingCommandBuffers,curFrame,camera,CullPhase::eEarly);
+        profiler->endZone(renderingCommandBuffers,curFrame);
+    }
     vk::RenderPassBeginInfo renderpassBeginInfo;
 
     vk::ClearValue depthStencilClearValue;
@@ -267,61 +499,203 @@ void Renderer::render(){
         vk::ClearValue(),depthStencilClearValue
     };
 
-    vk::Rect2D area({0,0},swapchainDetails.extent);
+    //the scene is drawn into the renderExtent corner of the scene target,but all of it is cleared:
+    //the depth pyramid is built from the whole depth image,and far depth around the corner keeps it conservative
+    vk::Rect2D area({0,0},sceneExtent);
     renderpassBeginInfo.setRenderArea(area);
-    renderpassBeginInfo.setRenderPass(defaultGraphicRenderPass);
+    renderpassBeginInfo.setRenderPass(occlusion?earlyGraphicRenderPass:defaultGraphicRenderPass);
     renderpassBeginInfo.setClearValues(clearValues);
-    renderpassBeginInfo.setFramebuffer(defaultGraphicFrameBuffers[frameIdx]);
-    renderingCommandBuffers.beginRenderPass(renderpassBeginInfo,vk::SubpassContents::eInline);
-    renderingCommandBuffers.bindPipeline(vk::PipelineBindPoint::eGraphics,defaultGraphicPipeline);
-    
-    renderingCommandBuffers.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,defaultGraphicPipelineLayout,0,{
-        glTFScene->modelMatsDescriptorSet,
-        glTFScene->materialDescriptorSet
-    },{});
-
-    renderingCommandBuffers.bindVertexBuffers(0,{glTFScene->vertexBuffer},{0});
-    renderingCommandBuffers.bindIndexBuffer(glTFScene->indexBuffer,0,vk::IndexType::eUint32);
-    renderingCommandBuffers.pushConstants<CameraDetails>(defaultGraphicPipelineLayout,vk::ShaderStageFlagBits::eVertex,0,camera);
-
-    vk::Viewport viewport;
-    viewport.setMinDepth(0.0f);
-    viewport.setMaxDepth(1.0f);
-    viewport.setWidth(swapchainDetails.extent.width);
-    viewport.setHeight(swapchainDetails.extent.height);
-    viewport.setX(0.0f);
-    viewport.setY(0.0f);
-    vk::Rect2D scissor;
-    scissor.setExtent(swapchainDetails.extent);
-    scissor.setOffset({0,0});
-    renderingCommandBuffers.setViewport(0,viewport);
-    renderingCommandBuffers.setScissor(0,scissor);
-    renderingCommandBuffers.drawIndexed(glTFScene->indexs.size(),1,0,0,0);
-    renderingCommandBuffers.endRenderPass();
+    renderpassBeginInfo.setFramebuffer(sceneFramebuffer);
+    //state is lost between render passes and isn't inherited by secondary command buffers,each of them binds it again
+    auto bindScene = [&](vk::CommandBuffer commandBuffer){
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,defaultGraphicPipelineLayout,0,{
+            glTFScene->modelMatsDescriptorSet,
+            glTFScene->materialDescriptorSet
+        },glTFScene->getModelMatsOffset(curFrame));
+
+        vk::Buffer vertexBuffer = deformPass?deformPass->getVertexBuffer():glTFScene->vertexBuffer;
+        commandBuffer.bindVertexBuffers(0,{vertexBuffer},{0});
+        commandBuffer.bindIndexBuffer(glTFScene->indexBuffer,0,vk::IndexType::eUint32);
+        commandBuffer.pushConstants<CameraDetails>(defaultGraphicPipelineLayout,vk::ShaderStageFlagBits::eVertex,0,camera);
 
-    renderpassBeginInfo.setRenderPass(imguiRenderPass);
-    renderpassBeginInfo.setFramebuffer(imguiFrameBuffers[frameIdx]);
-    renderingCommandBuffers.beginRenderPass(renderpassBeginInfo,vk::SubpassContents::eInline);
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(),renderingCommandBuffers);
+        vk::Viewport viewport;
+        viewport.setMinDepth(0.0f);
+        viewport.setMaxDepth(1.0f);
+        viewport.setWidth(renderExtent.width);
+        viewport.setHeight(renderExtent.height);
+        viewport.setX(0.0f);
+        viewport.setY(0.0f);
+        vk::Rect2D scissor;
+        scissor.setExtent(renderExtent);
+        scissor.setOffset({0,0});
+        commandBuffer.setViewport(0,viewport);
+        commandBuffer.setScissor(0,scissor);
+    };
+    struct SceneDraw{
+        CullPhase phase;
+        uint32_t bucket;
+    };
+    //buckets are sorted opaque,masked,blended.blended ones are drawn once all opaque draws of both phases are done
+    auto addDraws = [&](std::vector<SceneDraw>& draws,CullPhase phase,bool blended){
+        for(uint32_t i=0;i<glTFScene->drawBuckets.size();++i){
+            uint32_t variant = glTFScene->drawBuckets[i].pipelineVariant;
+            if(((variant&PIPELINE_VARIANT_ALPHA_BLEND)!=0)!=blended){
+                continue;
+            }
+            draws.push_back({phase,i});
+        }
+    };
+    //into the subpass of renderPass,inline or through secondary command buffers recorded in parallel.
+    //secondary command buffers execute in order,so blended draws keep theirs
+    float sceneRecordTime = 0;
+    auto drawScene = [&](vk::RenderPass renderPass,const std::vector<SceneDraw>& draws){
+        auto start = std::chrono::high_resolution_clock::now();
+        auto recordRange = [&](vk::CommandBuffer commandBuffer,uint32_t begin,uint32_t end){
+            bindScene(commandBuffer);
+            for(uint32_t i=begin;i<end;++i){
+                uint32_t variant = glTFScene->drawBuckets[draws[i].bucket].pipelineVariant;
+                commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,graphicPipelines[variant]);
+                cullPass->draw(commandBuffer,curFrame,draws[i].phase,draws[i].bucket);
+            }
+        };
+        if(parallel){
+            vk::CommandBufferInheritanceInfo inheritance;
+            inheritance.setRenderPass(renderPass);
+            inheritance.setSubpass(0);
+            inheritance.setFramebuffer(sceneFramebuffer);
+            inheritance.setPipelineStatistics(statistics?profiler->getStatisticsFlags():vk::QueryPipelineStatisticFlags());
+            std::vector<uint32_t> costs;
+            for(auto& draw:draws){
+                costs.push_back(cullPass->getDrawCallCount(draw.bucket));
+            }
+            renderingCommandBuffers.executeCommands(recorder->record(curFrame,options.recordThreads,inheritance,costs,recordRange));
+        }
+        else{
+            recordRange(renderingCommandBuffers,0,draws.size());
+        }
+        sceneRecordTime += std::chrono::duration<float,std::milli>(std::chrono::high_resolution_clock::now()-start).count();
+    };
+    //timestamps can't be written into a subpass of secondary command buffers,so the scene zones are around the render passes
+    std::vector<SceneDraw> draws;
+    if(cullPass){
+        addDraws(draws,CullPhase::eEarly,false);
+        if(!occlusion){
+            addDraws(draws,CullPhase::eEarly,true);
+        }
+    }
+    profiler->beginZone(renderingCommandBuffers,curFrame,"early scene");
+    renderingCommandBuffers.beginRenderPass(renderpassBeginInfo,sceneContents);
+    drawScene(renderpassBeginInfo.renderPass,draws);
+    renderingCommandBuffers.endRenderPass();
+    profiler->endZone(renderingCommandBuffers,curFrame);
+
+    //depth of the early draws hides what they occlude,what the last frame's pyramid hid wrongly is drawn on top
+    if(occlusion){
+        profiler->beginZone(renderingCommandBuffers,curFrame,"depth pyramid");
+        cullPass->recordPyramid(renderingCommandBuffers,camera);
+        profiler->endZone(renderingCommandBuffers,curFrame);
+        profiler->beginZone(renderingCommandBuffers,curFrame,"late cull");
+        cullPass->recordCull(renderingCommandBuffers,curFrame,camera,CullPhase::eLate);
+        profiler->endZone(renderingCommandBuffers,curFrame);
+        draws.clear();
+        addDraws(draws,CullPhase::eLate,false);
+        addDraws(draws,CullPhase::eEarly,true);
+        addDraws(draws,CullPhase::eLate,true);
+        renderpassBeginInfo.setRenderPass(lateGraphicRenderPass);
+        profiler->beginZone(renderingCommandBuffers,curFrame,"late scene");
+        renderingCommandBuffers.beginRenderPass(renderpassBeginInfo,sceneContents);
+        drawScene(renderpassBeginInfo.renderPass,draws);
+        renderingCommandBuffers.endRenderPass();
+        profiler->endZone(renderingCommandBuffers,curFrame);
+    }
+    smooth(frameTimings.sceneRecord,sceneRecordTime);
+    profiler->addCpuSample("record scene",sceneRecordTime);
+
+    //the scene target is in eShaderReadOnlyOptimal now.the output pass upscales it over the whole swapchain image,
+    //then the ui draws on top at native resolution,so the image is written once and stored once
+    vk::RenderPassBeginInfo outputBeginInfo;
+    outputBeginInfo.setRenderPass(outputRenderPass);
+    outputBeginInfo.setFramebuffer(frameBuffers[frameIdx]);
+    outputBeginInfo.setRenderArea(vk::Rect2D({0,0},swapchainDetails.extent));
+    renderingCommandBuffers.beginRenderPass(outputBeginInfo,vk::SubpassContents::eInline);
+    profiler->beginZone(renderingCommandBuffers,curFrame,"upscale");
+    vk::Viewport outputViewport(0.0f,0.0f,swapchainDetails.extent.width,swapchainDetails.extent.height,0.0f,1.0f);
+    renderingCommandBuffers.setViewport(0,outputViewport);
+    renderingCommandBuffers.setScissor(0,outputBeginInfo.renderArea);
+    renderingCommandBuffers.bindPipeline(vk::PipelineBindPoint::eGraphics,upscalePipeline);
+    renderingCommandBuffers.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,upscalePipelineLayout,0,upscaleSet,{});
+    glm::vec2 sceneSize(sceneExtent.width,sceneExtent.height);
+    glm::vec2 renderSize(renderExtent.width,renderExtent.height);
+    glm::vec4 upscaleConstants(renderSize/sceneSize,(renderSize-0.5f)/sceneSize);
+    renderingCommandBuffers.pushConstants<glm::vec4>(upscalePipelineLayout,vk::ShaderStageFlagBits::eFragment,0,upscaleConstants);
+    renderingCommandBuffers.draw(3,1,0,0);
+    profiler->endZone(renderingCommandBuffers,curFrame);
+    if(mode==RendererMode::eWindowed){
+        profiler->beginZone(renderingCommandBuffers,curFrame,"ui");
+        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(),renderingCommandBuffers);
+        profiler->endZone(renderingCommandBuffers,curFrame);
+    }
     renderingCommandBuffers.endRenderPass();
+    if(statistics){
+        profiler->endStatistics(renderingCommandBuffers,curFrame);
+    }
+    if(capture){
+        vk::ImageLayout finalLayout = mode==RendererMode::eHeadless?vk::ImageLayout::eTransferSrcOptimal:vk::ImageLayout::ePresentSrcKHR;
+        profiler->beginZone(renderingCommandBuffers,curFrame,"capture copy");
+        capture->record(renderingCommandBuffers,curFrame,swapchainImages[frameIdx],finalLayout,renderedFrames);
+        profiler->endZone(renderingCommandBuffers,curFrame);
+    }
+    profiler->endFrame(renderingCommandBuffers,curFrame);
 
     renderingCommandBuffers.end();
     vk::SubmitInfo submitInfo;
     submitInfo.setCommandBuffers(renderingCommandBuffers);
-    submitInfo.setSignalSemaphores(renderingFinished);
-    submitInfo.setWaitSemaphores(imageAvaliable);
-    std::vector<vk::PipelineStageFlags> waitStages = {
-        vk::PipelineStageFlagBits::eTopOfPipe
-    };
+    std::vector<vk::Semaphore> waitSemaphores;
+    std::vector<vk::PipelineStageFlags> waitStages;
+    if(mode==RendererMode::eWindowed){
+        submitInfo.setSignalSemaphores(renderingFinished[frameIdx]);
+        //the output pass is the first to touch the swapchain image,the cull and scene passes overlap the acquire
+        waitSemaphores.push_back(frame.imageAvaliable);
+        waitStages.push_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+    }
+    if(deformFinished){
+        waitSemaphores.push_back(deformFinished);
+        waitStages.push_back(vk::PipelineStageFlagBits::eVertexInput);
+    }
+    if(cullFinished){
+        waitSemaphores.push_back(cullFinished);
+        waitStages.push_back(vk::PipelineStageFlagBits::eDrawIndirect);
+    }
+    submitInfo.setWaitSemaphores(waitSemaphores);
     submitInfo.setWaitDstStageMask(waitStages);
-    graphicQueue.submit(submitInfo,inflightFence);
-
-    vk::PresentInfoKHR presentInfo;
-    presentInfo.setImageIndices(frameIdx);
-    presentInfo.setSwapchains(swapchain);
-    presentInfo.setWaitSemaphores(renderingFinished);
-
-    auto presentResult = presentQueue.presentKHR(presentInfo);
+    {
+        TraceScope scope("submit");
+        graphicQueue.submit(submitInfo,frame.inflightFence);
+    }
+    float recordTime = std::chrono::duration<float,std::milli>(std::chrono::high_resolution_clock::now()-recordStart).count();
+    smooth(frameTimings.record,recordTime);
+    profiler->addCpuSample("record",recordTime);
+
+    if(mode==RendererMode::eWindowed){
+        vk::PresentInfoKHR presentInfo;
+        presentInfo.setImageIndices(frameIdx);
+        presentInfo.setSwapchains(swapchain);
+        presentInfo.setWaitSemaphores(renderingFinished[frameIdx]);
+        TraceScope scope("present");
+        pacer->beforePresent(presentInfo);
+        //either way the image is presented or released,the swapchain is recreated before the next frame
+        try{
+            if(presentQueue.presentKHR(presentInfo)==vk::Result::eSuboptimalKHR){
+                swapchainDirty = true;
+            }
+        }
+        catch(vk::OutOfDateKHRError){
+            swapchainDirty = true;
+        }
+        pacer->afterPresent();
+    }
+    curFrame = (curFrame+1)%framesInFlight;
+    ++renderedFrames;
 
 
 }
@@ -371,6 +745,132 @@ void Renderer::initDebugMessenger()
     
     debugMessenger = vkInstance.createDebugUtilsMessengerEXT(debugMessengerInfo,nullptr,dld);
 }
+void Renderer::buildUI()
+{
+    ImGui_ImplVulkan_NewFrame();
+    ImGui_ImplSDL2_NewFrame();
+    ImGui::NewFrame();
+    {
+        if(ImGui::Begin("fps")){
+            ImGui::BulletText("fps:%.3f",ImGui::GetIO().Framerate);
+            ImGui::BulletText("frames in flight:%u",framesInFlight);
+            ImGui::BulletText("cpu frame:%.3fms",frameTimings.cpuFrame);
+            ImGui::BulletText("cpu record:%.3fms(scene %.3fms),fence wait:%.3fms",frameTimings.record,frameTimings.sceneRecord,frameTimings.fenceWait);
+            int recordThreads = options.recordThreads;
+            if(ImGui::SliderInt("record threads(0 inline)",&recordThreads,0,recorder->getThreadCount())){
+                setRecordThreads(recordThreads);
+            }
+            if(profiler->hasTimestamps()){
+                ImGui::BulletText("gpu:%.3fms",frameTimings.gpu);
+            }
+            //share of the frame the CPU spent working instead of waiting for the GPU
+            float overlap = frameTimings.cpuFrame>0?1.0f-frameTimings.fenceWait/frameTimings.cpuFrame:0.0f;
+            ImGui::BulletText("cpu/gpu overlap:%.1f%%",overlap*100.0f);
+            if(cullPass){
+                uint32_t draws = cullPass->getInstanceCount();
+                uint32_t submitted = cullStats.drawCounts[0]+cullStats.drawCounts[1];
+                ImGui::Checkbox("occlusion culling",&occlusionCulling);
+                ImGui::BulletText("draws:%u submitted,%u culled,%u buckets",submitted,draws-submitted,(uint32_t)glTFScene->drawBuckets.size());
+                ImGui::BulletText("triangles:%u rasterized,%u without occlusion culling",cullStats.drawnTriangles,cullStats.frustumTriangles);
+            }
+            ImGui::BulletText("pipelines:%u in %.2fms,%s cache",pipelineCacheStats.pipelineCount,pipelineCacheStats.creationTime,
+            pipelineCacheStats.warm?"warm":"cold");
+            if(capture){
+                CaptureStats stats = capture->getStats();
+                ImGui::BulletText("capture(F12):%llu written,%llu dropped,%.2fms/image",(unsigned long long)stats.written,
+                (unsigned long long)stats.dropped,stats.encodeTime);
+            }
+        }
+        ImGui::End();
+        if(glTFScene->animations.size()){
+            if(ImGui::Begin("animation")){
+                auto& animations = glTFScene->animations;
+                int active = glTFScene->activeAnimation;
+                if(ImGui::BeginCombo("clip",animations[active].name.c_str())){
+                    for(int i=0;i<animations.size();++i){
+                        ImGui::PushID(i);
+                        if(ImGui::Selectable(animations[i].name.c_str(),i==active)){
+                            glTFScene->activeAnimation = i;
+                            glTFScene->animationTime = 0;
+                        }
+                        ImGui::PopID();
+                    }
+                    ImGui::EndCombo();
+                }
+                ImGui::Checkbox("playing",&glTFScene->animationPlaying);
+                ImGui::BulletText("channels:%d",(int)animations[active].channels.size());
+                ImGui::BulletText("update:%.3fms",glTFScene->animationUpdateTime);
+            }
+            ImGui::End();
+        }
+        if(ImGui::Begin("memory")){
+            const float MB = 1024.0f*1024.0f;
+            GpuAllocatorStats stats = allocator.getStats();
+            ImGui::BulletText("device memory objects:%u/%u",stats.deviceMemoryCount,stats.maxDeviceMemoryCount);
+            ImGui::BulletText("dedicated:%u,%.2fMB",stats.dedicatedCount,stats.dedicatedBytes/MB);
+            for(auto& pool:stats.pools){
+                const char* strategy = pool.strategy==AllocationStrategy::eLinear?"linear":"buddy";
+                ImGui::BulletText("type %u %s %s:%u blocks,%u allocations",pool.memoryType,strategy,
+                pool.image?"images":"buffers",pool.blockCount,pool.allocationCount);
+                ImGui::Indent();
+                ImGui::Text("used %.2f/%.2fMB(requested %.2fMB)",pool.usedBytes/MB,pool.blockBytes/MB,pool.requestedBytes/MB);
+                ImGui::Text("largest free %.2fMB,fragmentation %.1f%%",pool.largestFreeRange/MB,pool.fragmentation*100.0f);
+                ImGui::Unindent();
+            }
+        }
+        ImGui::End();
+        if(ImGui::Begin("pacing")){
+            PacingOptions& pacing = options.pacing;
+            if(ImGui::BeginCombo("present mode",vk::to_string(swapchainDetails.presentMode).c_str())){
+                for(auto presentMode:supportedPresentModes){
+                    if(ImGui::Selectable(vk::to_string(presentMode).c_str(),presentMode==swapchainDetails.presentMode)){
+                        pacing.presentMode = presentMode;
+                        swapchainDirty |= presentMode!=swapchainDetails.presentMode;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            int imageCount = pacing.imageCount;
+            if(ImGui::InputInt("swapchain images(0 default)",&imageCount)){
+                pacing.imageCount = std::max(imageCount,0);
+                swapchainDirty = true;
+            }
+            ImGui::BulletText("swapchain images:%u",(uint32_t)swapchainImages.size());
+            ImGui::DragFloat("fps limit(0 off)",&pacing.fpsLimit,1.0f,0.0f,1000.0f,"%.0f");
+            if(pacer->hasPresentWait()){
+                int maxQueued = pacing.maxQueuedPresents;
+                if(ImGui::InputInt("max queued presents(0 off)",&maxQueued)){
+                    pacing.maxQueuedPresents = std::max(maxQueued,0);
+                }
+            }
+            const PacingStats& stats = pacer->getStats();
+            ImGui::BulletText("pacing wait:%.3fms",stats.pacingWait);
+            ImGui::BulletText("input to present call:%.3fms",stats.inputToPresentCall);
+            if(pacer->hasPresentWait()){
+                ImGui::BulletText("input to presented:%.3fms",stats.inputToPresented);
+            }
+            else{
+                ImGui::BulletText("input to presented:needs VK_KHR_present_wait");
+            }
+        }
+        ImGui::End();
+        if(ImGui::Begin("resolution")){
+            DynamicResolutionOptions& resolutionOptions = resolution.getOptions();
+            ImGui::Checkbox("dynamic",&resolutionOptions.enabled);
+            ImGui::DragFloat("gpu budget(ms)",&resolutionOptions.gpuBudget,0.1f,1.0f,100.0f,"%.1f");
+            ImGui::SliderFloat("min scale",&resolutionOptions.minScale,0.1f,1.0f);
+            ImGui::SliderFloat("max scale",&resolutionOptions.maxScale,0.1f,1.0f);
+            if(!profiler->hasTimestamps()){
+                ImGui::BulletText("needs gpu timestamps,the scale stays at max");
+            }
+            ImGui::BulletText("scene:%ux%u(%.0f%%),output:%ux%u",renderExtent.width,renderExtent.height,resolution.getScale()*100.0f,
+            swapchainDetails.extent.width,swapchainDetails.extent.height);
+        }
+        ImGui::End();
+        profiler->drawUI();
+    }
+    ImGui::Render();
+}
 void Renderer::initImGui()
 {
     IMGUI_CHECKVERSION();
@@ -384,15 +884,22 @@ void Renderer::initImGui()
     initInfo.ColorAttachmentFormat = static_cast<VkFormat>(swapchainDetails.format.format);
     initInfo.DescriptorPool = descriptorPool;
     initInfo.Device = lDevice;
-    initInfo.ImageCount = swapchainImages.size();
+    //imgui cycles its vertex buffers over ImageCount frames,which must cover the frames in flight
+    initInfo.ImageCount = std::max<uint32_t>(swapchainImages.size(),framesInFlight);
     initInfo.Instance = vkInstance;
-    initInfo.MinImageCount = std::min(swapchainDetails.capabilities.minImageCount+1,swapchainDetails.capabilities.maxImageCount);
+    //imgui asserts at least 2,maxImageCount may be 0
+    initInfo.MinImageCount = std::max<uint32_t>(swapchainDetails.capabilities.minImageCount,2);
     initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
     initInfo.PhysicalDevice = pDevice;
     initInfo.Queue = graphicQueue;
     initInfo.QueueFamily = queueFamilyIndices.graphicQueueFamily.value();
     initInfo.Subpass = 0;
-    ImGui_ImplVulkan_Init(&initInfo,imguiRenderPass);
+    initInfo.PipelineCache = pipelineCache;
+    //imgui creates its pipeline in init
+    auto imguiStart = std::chrono::high_resolution_clock::now();
+    ImGui_ImplVulkan_Init(&initInfo,outputRenderPass);
+    pipelineCacheStats.creationTime += std::chrono::duration<float,std::milli>(std::chrono::high_resolution_clock::now()-imguiStart).count();
+    ++pipelineCacheStats.pipelineCount;
 
     vk::CommandBufferAllocateInfo allocateInfo;
     allocateInfo.setCommandBufferCount(1);
@@ -413,26 +920,60 @@ void Renderer::initImGui()
 }
 void Renderer::initPipelineLayouts()
 {
+    if(glTFScene){
+        initScenePipelineLayout();
+    }
     {
-        std::vector<vk::DescriptorSetLayout> setLayouts = {
-            glTFScene->modelMatsDescriptorSetLayout,
-            glTFScene->materialDescriptorSetLayout,
-        };
+        vk::DescriptorSetLayoutBinding binding;
+        binding.setBinding(0);
+        binding.setDescriptorCount(1);
+        binding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        binding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+        vk::DescriptorSetLayoutCreateInfo setLayoutInfo;
+        setLayoutInfo.setBindings(binding);
+        upscaleSetLayout = lDevice.createDescriptorSetLayout(setLayoutInfo);
+        //uv scale and uv max of upscale.frag
         vk::PushConstantRange range;
         range.setOffset(0);
-        range.setSize(sizeof(CameraDetails));
-        range.setStageFlags(vk::ShaderStageFlagBits::eVertex);
+        range.setSize(sizeof(glm::vec4));
+        range.setStageFlags(vk::ShaderStageFlagBits::eFragment);
         vk::PipelineLayoutCreateInfo createInfo;
-        createInfo.setSetLayouts(setLayouts);
+        createInfo.setSetLayouts(upscaleSetLayout);
         createInfo.setPushConstantRanges(range);
-        defaultGraphicPipelineLayout = lDevice.createPipelineLayout(createInfo);
+        upscalePipelineLayout = lDevice.createPipelineLayout(createInfo);
     }
 }
+void Renderer::initScenePipelineLayout()
+{
+    std::vector<vk::DescriptorSetLayout> setLayouts = {
+        glTFScene->modelMatsDescriptorSetLayout,
+        glTFScene->materialDescriptorSetLayout,
+    };
+    vk::PushConstantRange range;
+    range.setOffset(0);
+    range.setSize(sizeof(CameraDetails));
+    range.setStageFlags(vk::ShaderStageFlagBits::eVertex);
+    vk::PipelineLayoutCreateInfo createInfo;
+    createInfo.setSetLayouts(setLayouts);
+    createInfo.setPushConstantRanges(range);
+    defaultGraphicPipelineLayout = lDevice.createPipelineLayout(createInfo);
+}
 void Renderer::initPipelines()
 {
+    //without a scene there are no variants to create yet
+    if(!glTFScene){
+        return;
+    }
     {
         vk::PipelineColorBlendAttachmentState colorBlendAttachment;
         colorBlendAttachment.setBlendEnable(false);
+        //used by blended variants
+        colorBlendAttachment.setSrcColorBlendFactor(vk::BlendFactor::eSrcAlpha);
+        colorBlendAttachment.setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha);
+        colorBlendAttachment.setColorBlendOp(vk::BlendOp::eAdd);
+        colorBlendAttachment.setSrcAlphaBlendFactor(vk::BlendFactor::eOne);
+        colorBlendAttachment.setDstAlphaBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha);
+        colorBlendAttachment.setAlphaBlendOp(vk::BlendOp::eAdd);
         colorBlendAttachment.setColorWriteMask(vk::ColorComponentFlagBits::eR|vk::ColorComponentFlagBits::eG|vk::ColorComponentFlagBits::eB|vk::ColorComponentFlagBits::eA);
         vk::PipelineColorBlendStateCreateInfo colorBlendState;
         colorBlendState.setAttachments(colorBlendAttachment);
@@ -456,7 +997,8 @@ void Renderer::initPipelines()
         multiSampleState.setRasterizationSamples(vk::SampleCountFlagBits::e1);
 
         vk::PipelineRasterizationStateCreateInfo rasterizationState;
-        rasterizationState.setCullMode(vk::CullModeFlagBits::eNone);
+        //glTF faces are counter clockwise,the flipped y of projectionMat keeps them so
+        rasterizationState.setFrontFace(vk::FrontFace::eCounterClockwise);
         rasterizationState.setPolygonMode(vk::PolygonMode::eFill);
         rasterizationState.setLineWidth(1.0f);
 
@@ -466,10 +1008,24 @@ void Renderer::initPipelines()
         vertShader.setModule(vertShaderModule);
         vertShader.setPName("main");
         vertShader.setStage(vk::ShaderStageFlagBits::eVertex);
+        //constant_id 0 and 1 of fragshader.frag
+        struct FragmentSpecialization{
+            int32_t alphaMode;
+            VkBool32 baseColorTexture;
+        } specialization;
+        std::array<vk::SpecializationMapEntry,2> specializationEntries = {
+            vk::SpecializationMapEntry(0,offsetof(FragmentSpecialization,alphaMode),sizeof(int32_t)),
+            vk::SpecializationMapEntry(1,offsetof(FragmentSpecialization,baseColorTexture),sizeof(VkBool32)),
+        };
+        vk::SpecializationInfo specializationInfo;
+        specializationInfo.setMapEntries(specializationEntries);
+        specializationInfo.setDataSize(sizeof(specialization));
+        specializationInfo.setPData(&specialization);
         vk::PipelineShaderStageCreateInfo fragShader;
         fragShader.setModule(fragShaderModule);
         fragShader.setPName("main");
         fragShader.setStage(vk::ShaderStageFlagBits::eFragment);
+        fragShader.setPSpecializationInfo(&specializationInfo);
         std::vector<vk::PipelineShaderStageCreateInfo> stages = {vertShader,fragShader};
 
         vk::PipelineTessellationStateCreateInfo tessellationState;
@@ -510,15 +1066,103 @@ void Renderer::initPipelines()
         createInfo.setSubpass(0);
         createInfo.setRenderPass(defaultGraphicRenderPass);
 
-        vk::ResultValue<vk::Pipeline> resultValue = lDevice.createGraphicsPipeline(nullptr,createInfo);
-        if(resultValue.result!=vk::Result::eSuccess){
-            throw std::runtime_error("failed to create defaultGraphicPipeline!");
+        //only the variants the scene's draw buckets use,earlier scenes' variants are kept
+        graphicPipelines.resize(PIPELINE_VARIANT_COUNT,nullptr);
+        for(auto& bucket:glTFScene->drawBuckets){
+            uint32_t variant = bucket.pipelineVariant;
+            if(graphicPipelines[variant]){
+                continue;
+            }
+            uint32_t alphaMode = variant>>PIPELINE_VARIANT_ALPHA_SHIFT;
+            specialization.alphaMode = alphaMode;
+            specialization.baseColorTexture = variant&PIPELINE_VARIANT_BASE_COLOR_TEXTURE?VK_TRUE:VK_FALSE;
+            rasterizationState.setCullMode(variant&PIPELINE_VARIANT_DOUBLE_SIDED?vk::CullModeFlagBits::eNone:vk::CullModeFlagBits::eBack);
+            //blended draws come after every opaque one,they are depth tested but hide nothing
+            bool blend = alphaMode==(uint32_t)vkglTF::AlphaMode::eBlend;
+            colorBlendAttachment.setBlendEnable(blend);
+            depthStencilState.setDepthWriteEnable(!blend);
+            graphicPipelines[variant] = createGraphicsPipeline(createInfo,"graphic pipeline variant");
         }
-        defaultGraphicPipeline = resultValue.value;
         lDevice.destroyShaderModule(vertShaderModule);
         lDevice.destroyShaderModule(fragShaderModule);
     }
 }
+void Renderer::initUpscalePipeline()
+{
+    vk::PipelineColorBlendAttachmentState colorBlendAttachment;
+    colorBlendAttachment.setBlendEnable(false);
+    colorBlendAttachment.setColorWriteMask(vk::ColorComponentFlagBits::eR|vk::ColorComponentFlagBits::eG|vk::ColorComponentFlagBits::eB|vk::ColorComponentFlagBits::eA);
+    vk::PipelineColorBlendStateCreateInfo colorBlendState;
+    colorBlendState.setAttachments(colorBlendAttachment);
+
+    vk::PipelineDynamicStateCreateInfo dynamicStates;
+    std::vector<vk::DynamicState> states = {vk::DynamicState::eViewport,vk::DynamicState::eScissor};
+    dynamicStates.setDynamicStates(states);
+    vk::PipelineViewportStateCreateInfo viewportState;
+    viewportState.setViewportCount(1);
+    viewportState.setScissorCount(1);
+
+    vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState;
+    inputAssemblyState.setTopology(vk::PrimitiveTopology::eTriangleList);
+    vk::PipelineVertexInputStateCreateInfo vertexInputState;
+    vk::PipelineMultisampleStateCreateInfo multiSampleState;
+    multiSampleState.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+    vk::PipelineRasterizationStateCreateInfo rasterizationState;
+    rasterizationState.setCullMode(vk::CullModeFlagBits::eNone);
+    rasterizationState.setPolygonMode(vk::PolygonMode::eFill);
+    rasterizationState.setLineWidth(1.0f);
+
+    vk::ShaderModule vertShaderModule = createShaderModule("shaders/spv/fullscreen.spv");
+    vk::ShaderModule fragShaderModule = createShaderModule("shaders/spv/upscale.spv");
+    std::array<vk::PipelineShaderStageCreateInfo,2> stages;
+    stages[0].setModule(vertShaderModule);
+    stages[0].setPName("main");
+    stages[0].setStage(vk::ShaderStageFlagBits::eVertex);
+    stages[1].setModule(fragShaderModule);
+    stages[1].setPName("main");
+    stages[1].setStage(vk::ShaderStageFlagBits::eFragment);
+
+    vk::GraphicsPipelineCreateInfo createInfo;
+    createInfo.setLayout(upscalePipelineLayout);
+    createInfo.setPColorBlendState(&colorBlendState);
+    createInfo.setPDynamicState(&dynamicStates);
+    createInfo.setPInputAssemblyState(&inputAssemblyState);
+    createInfo.setPMultisampleState(&multiSampleState);
+    createInfo.setPRasterizationState(&rasterizationState);
+    createInfo.setStages(stages);
+    createInfo.setPVertexInputState(&vertexInputState);
+    createInfo.setPViewportState(&viewportState);
+    createInfo.setSubpass(0);
+    createInfo.setRenderPass(outputRenderPass);
+    upscalePipeline = createGraphicsPipeline(createInfo,"upscale pipeline");
+    lDevice.destroyShaderModule(vertShaderModule);
+    lDevice.destroyShaderModule(fragShaderModule);
+
+    //upscale.frag clamps to the rendered corner itself
+    vk::Filter filter = sceneFilterLinear?vk::Filter::eLinear:vk::Filter::eNearest;
+    vk::SamplerCreateInfo samplerInfo;
+    samplerInfo.setMagFilter(filter);
+    samplerInfo.setMinFilter(filter);
+    samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+    samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+    samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+    samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+    upscaleSampler = lDevice.createSampler(samplerInfo);
+}
+void Renderer::initUpscaleSet()
+{
+    vk::DescriptorSetAllocateInfo allocateInfo;
+    allocateInfo.setDescriptorPool(descriptorPool);
+    allocateInfo.setSetLayouts(upscaleSetLayout);
+    upscaleSet = lDevice.allocateDescriptorSets(allocateInfo)[0];
+    vk::DescriptorImageInfo imageInfo(upscaleSampler,sceneColorImageView,vk::ImageLayout::eShaderReadOnlyOptimal);
+    vk::WriteDescriptorSet write;
+    write.setDstSet(upscaleSet);
+    write.setDstBinding(0);
+    write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    write.setImageInfo(imageInfo);
+    lDevice.updateDescriptorSets(write,{});
+}
 void Renderer::initSurface()
 {
     VkSurfaceKHR stagingSurface;
@@ -575,11 +1219,11 @@ bool Renderer::pickQueueFamilies(vk::PhysicalDevice pdevice)
         if(!queueFamilyIndices.graphicQueueFamily.has_value()&&(queueFamilyProperty.queueFlags&vk::QueueFlagBits::eGraphics)){
             queueFamilyIndices.graphicQueueFamily =  i;
         }
-        if(!queueFamilyIndices.presentQueueFamily.has_value()&&pdevice.getSurfaceSupportKHR(i,surface)){
+        if(mode==RendererMode::eWindowed&&!queueFamilyIndices.presentQueueFamily.has_value()&&pdevice.getSurfaceSupportKHR(i,surface)){
             queueFamilyIndices.presentQueueFamily =  i;
         }
     }
-    return queueFamilyIndices.complete();
+    return queueFamilyIndices.complete(mode==RendererMode::eWindowed);
 }
 uint32_t Renderer::getDeviceLayers(std::vector<const char *> &layers)
 {
@@ -589,13 +1233,21 @@ uint32_t Renderer::getDeviceLayers(std::vector<const char *> &layers)
 uint32_t Renderer::getDeviceExts(std::vector<const char *> &exts)
 {
     exts.resize(0);
-    exts.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    if(mode==RendererMode::eWindowed){
+        exts.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
     return exts.size();
 }
 
 void Renderer::getDeviceFeatures(vk::PhysicalDeviceFeatures &features)
 {
-    
+    vk::PhysicalDeviceFeatures supported = pDevice.getFeatures();
+    features.setMultiDrawIndirect(supported.multiDrawIndirect);
+    multiDrawIndirectSupported = supported.multiDrawIndirect;
+    features.setPipelineStatisticsQuery(supported.pipelineStatisticsQuery);
+    pipelineStatisticsSupported = supported.pipelineStatisticsQuery;
+    features.setInheritedQueries(supported.inheritedQueries);
+    inheritedQueriesSupported = supported.inheritedQueries;
 }
 
 void Renderer::getSwapchainDetails()
@@ -613,20 +1265,15 @@ void Renderer::getSwapchainDetails()
     if(!formatPicked){
         swapchainDetails.format = formats[0];
     }
-    bool presentModePicked = false;
-    std::vector<vk::PresentModeKHR> presentModes = pDevice.getSurfacePresentModesKHR(surface);
-    for(auto presentMode:presentModes){
-        if(presentMode == vk::PresentModeKHR::eMailbox){
-            presentModePicked = true;
-            swapchainDetails.presentMode = vk::PresentModeKHR::eMailbox;
-        }
-    }
-    if(!presentModePicked){
-        swapchainDetails.presentMode = vk::PresentModeKHR::eFifo;
-    }
+    //the one asked for if the surface has it,fifo is always there
+    supportedPresentModes = pDevice.getSurfacePresentModesKHR(surface);
+    vk::PresentModeKHR wanted = options.pacing.presentMode;
+    bool supported = std::find(supportedPresentModes.begin(),supportedPresentModes.end(),wanted)!=supportedPresentModes.end();
+    swapchainDetails.presentMode = supported?wanted:vk::PresentModeKHR::eFifo;
 }
 
-vk::ImageView Renderer::createImageView(vk::Image image,vk::Format format,vk::ImageAspectFlags aspectMask)
+vk::ImageView Renderer::createImageView(vk::Image image,vk::Format format,vk::ImageAspectFlags aspectMask,
+                                        uint32_t baseMipLevel,uint32_t levelCount)
 {
     vk::ImageViewCreateInfo imageViewInfo;
     imageViewInfo.setImage(image);
@@ -635,9 +1282,9 @@ vk::ImageView Renderer::createImageView(vk::Image image,vk::Format format,vk::Im
     vk::ImageSubresourceRange subresoureceRange;
     subresoureceRange.setAspectMask(aspectMask);
     subresoureceRange.setBaseArrayLayer(0);
-    subresoureceRange.setBaseMipLevel(0);
+    subresoureceRange.setBaseMipLevel(baseMipLevel);
     subresoureceRange.setLayerCount(1);
-    subresoureceRange.setLevelCount(1);
+    subresoureceRange.setLevelCount(levelCount);
     imageViewInfo.setSubresourceRange(subresoureceRange);
     imageViewInfo.setViewType(vk::ImageViewType::e2D);
     vk::ImageView imageView =  lDevice.createImageView(imageViewInfo);
@@ -664,6 +1311,30 @@ vk::ShaderModule Renderer::createShaderModule(const char *path)
     return shaderModule;
 }
 
+vk::Pipeline Renderer::createGraphicsPipeline(const vk::GraphicsPipelineCreateInfo& createInfo,const char* name)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    vk::ResultValue<vk::Pipeline> resultValue = lDevice.createGraphicsPipeline(pipelineCache,createInfo);
+    if(resultValue.result!=vk::Result::eSuccess){
+        throw std::runtime_error(std::string("failed to create ")+name+"!");
+    }
+    pipelineCacheStats.creationTime += std::chrono::duration<float,std::milli>(std::chrono::high_resolution_clock::now()-start).count();
+    ++pipelineCacheStats.pipelineCount;
+    return resultValue.value;
+}
+
+vk::Pipeline Renderer::createComputePipeline(const vk::ComputePipelineCreateInfo& createInfo,const char* name)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    vk::ResultValue<vk::Pipeline> resultValue = lDevice.createComputePipeline(pipelineCache,createInfo);
+    if(resultValue.result!=vk::Result::eSuccess){
+        throw std::runtime_error(std::string("failed to create ")+name+"!");
+    }
+    pipelineCacheStats.creationTime += std::chrono::duration<float,std::milli>(std::chrono::high_resolution_clock::now()-start).count();
+    ++pipelineCacheStats.pipelineCount;
+    return resultValue.value;
+}
+
 vk::CommandBuffer Renderer::startOneShotCommandBuffer(vk::CommandPool cp)
 {
     vk::CommandBufferAllocateInfo commandBufferInfo;
@@ -687,23 +1358,8 @@ void Renderer::finishOneShotCommandBuffer(vk::CommandPool cp,vk::CommandBuffer c
     lDevice.freeCommandBuffers(cp,cb);
 }
 
-int Renderer::getSuitableMemoryTypeIndex(uint32_t memoryTypeBits,vk::MemoryPropertyFlags props)
-{
-    vk::PhysicalDeviceMemoryProperties memoryProperties = pDevice.getMemoryProperties();
-    for(int i=0;i<memoryProperties.memoryTypeCount;++i){
-        vk::MemoryType type = memoryProperties.memoryTypes[i];
-        if(type.propertyFlags&props){
-            if((1<<i)&memoryTypeBits){
-                return i;
-            }
-        }
-    }
-    throw std::runtime_error("failed to find a suitable memory type!");
-    return -1;
-}
-
-void Renderer::createImage(vk::Image& image,vk::DeviceMemory& imageMemory,vk::Extent2D extent,vk::Format format,
-                           vk::ImageUsageFlags usages,vk::MemoryPropertyFlags memoryProps)
+void Renderer::createImage(vk::Image& image,GpuAllocation& imageMemory,vk::Extent2D extent,vk::Format format,
+                           vk::ImageUsageFlags usages,vk::MemoryPropertyFlags memoryProps,uint32_t mipLevels)
 {
     vk::ImageCreateInfo createInfo;
     createInfo.setArrayLayers(1);
@@ -711,7 +1367,7 @@ void Renderer::createImage(vk::Image& image,vk::DeviceMemory& imageMemory,vk::Ex
     createInfo.setFormat(format);
     createInfo.setImageType(vk::ImageType::e2D);
     createInfo.setInitialLayout(vk::ImageLayout::eUndefined);
-    createInfo.setMipLevels(1);
+    createInfo.setMipLevels(mipLevels);
     createInfo.setQueueFamilyIndices(queueFamilyIndices.graphicQueueFamily.value());
     createInfo.setSamples(vk::SampleCountFlagBits::e1);
     createInfo.setSharingMode(vk::SharingMode::eExclusive);
@@ -719,16 +1375,20 @@ void Renderer::createImage(vk::Image& image,vk::DeviceMemory& imageMemory,vk::Ex
     createInfo.setUsage(usages);
     image = lDevice.createImage(createInfo);
 
-    vk::MemoryRequirements requirements = lDevice.getImageMemoryRequirements(image);
-    int memoryTypeIndex = getSuitableMemoryTypeIndex(requirements.memoryTypeBits,memoryProps);
-    vk::MemoryAllocateInfo allocateInfo;
-    allocateInfo.setAllocationSize(requirements.size);
-    allocateInfo.setMemoryTypeIndex(memoryTypeIndex);
-    imageMemory = lDevice.allocateMemory(allocateInfo);
-    lDevice.bindImageMemory(image,imageMemory,0);
+    vk::ImageMemoryRequirementsInfo2 requirementsInfo;
+    requirementsInfo.setImage(image);
+    auto requirementsChain = lDevice.getImageMemoryRequirements2<vk::MemoryRequirements2,vk::MemoryDedicatedRequirements>(requirementsInfo);
+    vk::MemoryRequirements requirements = requirementsChain.get<vk::MemoryRequirements2>().memoryRequirements;
+    vk::MemoryDedicatedRequirements dedicated = requirementsChain.get<vk::MemoryDedicatedRequirements>();
+    AllocationStrategy strategy = AllocationStrategy::eBuddy;
+    if(dedicated.prefersDedicatedAllocation||dedicated.requiresDedicatedAllocation||requirements.size>=GPU_DEDICATED_IMAGE_SIZE){
+        strategy = AllocationStrategy::eDedicated;
+    }
+    imageMemory = allocator.allocate(requirements,memoryProps,strategy,image);
+    lDevice.bindImageMemory(image,imageMemory.memory,imageMemory.offset);
 }
 
-void Renderer::createBuffer(vk::Buffer& buffer,vk::DeviceMemory& bufferMemory,int size,vk::BufferUsageFlags usages,vk::MemoryPropertyFlags memoryProps)
+void Renderer::createBuffer(vk::Buffer& buffer,GpuAllocation& bufferMemory,int size,vk::BufferUsageFlags usages,vk::MemoryPropertyFlags memoryProps)
 {
     vk::BufferCreateInfo bufferInfo;
     if(queueFamilyIndices.computeQueueFamily.value() == queueFamilyIndices.graphicQueueFamily.value()){
@@ -744,12 +1404,41 @@ void Renderer::createBuffer(vk::Buffer& buffer,vk::DeviceMemory& bufferMemory,in
     bufferInfo.setSize(size);
     buffer = lDevice.createBuffer(bufferInfo);
     vk::MemoryRequirements requirements = lDevice.getBufferMemoryRequirements(buffer);
-    int memoryTypeIndex = getSuitableMemoryTypeIndex(requirements.memoryTypeBits,memoryProps);
-    vk::MemoryAllocateInfo allocateInfo;
-    allocateInfo.setAllocationSize(requirements.size);
-    allocateInfo.setMemoryTypeIndex(memoryTypeIndex);
-    bufferMemory = lDevice.allocateMemory(allocateInfo);
-    lDevice.bindBufferMemory(buffer,bufferMemory,0);
+    AllocationStrategy strategy = usages==vk::BufferUsageFlagBits::eTransferSrc?AllocationStrategy::eLinear:AllocationStrategy::eBuddy;
+    bufferMemory = allocator.allocate(requirements,memoryProps,strategy);
+    lDevice.bindBufferMemory(buffer,bufferMemory.memory,bufferMemory.offset);
+}
+
+void Renderer::createDeviceLocalBuffer(vk::Buffer& buffer,GpuAllocation& bufferMemory,const void* data,int size,vk::BufferUsageFlags usages)
+{
+    createBuffer(buffer,bufferMemory,size,usages|vk::BufferUsageFlagBits::eTransferDst,vk::MemoryPropertyFlagBits::eDeviceLocal);
+    vk::Buffer stagingBuffer;
+    GpuAllocation stagingMemory;
+    createBuffer(stagingBuffer,stagingMemory,size,
+    vk::BufferUsageFlagBits::eTransferSrc,vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
+    memcpy(stagingMemory.mapped,data,size);
+    vk::CommandBuffer cb = startOneShotCommandBuffer(graphicCommandPool);
+    vk::BufferCopy region;
+    region.setSize(size);
+    region.setSrcOffset(0);
+    region.setDstOffset(0);
+    cb.copyBuffer(stagingBuffer,buffer,region);
+    finishOneShotCommandBuffer(graphicCommandPool,cb,graphicQueue);
+    destroyBuffer(stagingBuffer,stagingMemory);
+}
+
+void Renderer::destroyImage(vk::Image& image,GpuAllocation& imageMemory)
+{
+    lDevice.destroyImage(image);
+    allocator.free(imageMemory);
+    image = nullptr;
+}
+
+void Renderer::destroyBuffer(vk::Buffer& buffer,GpuAllocation& bufferMemory)
+{
+    lDevice.destroyBuffer(buffer);
+    allocator.free(bufferMemory);
+    buffer = nullptr;
 }
 
 void Renderer::initLogicalDevice()
@@ -763,14 +1452,36 @@ void Renderer::initLogicalDevice()
     uint32_t extCount = getDeviceExts(exts);
     uint32_t layerCount = getDeviceLayers(layers);
     getDeviceFeatures(features);
+    bool presentIdExt = false;
+    bool presentWaitExt = false;
+    //optional,lets traces put GPU timestamps on the CPU timeline without waiting for the device
+    for(auto& ext:pDevice.enumerateDeviceExtensionProperties()){
+        presentIdExt |= std::strcmp(ext.extensionName,VK_KHR_PRESENT_ID_EXTENSION_NAME)==0;
+        presentWaitExt |= std::strcmp(ext.extensionName,VK_KHR_PRESENT_WAIT_EXTENSION_NAME)==0;
+        if(std::strcmp(ext.extensionName,VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)==0){
+#ifdef _WIN32
+            vk::TimeDomainEXT hostDomain = vk::TimeDomainEXT::eQueryPerformanceCounter;
+#else
+            vk::TimeDomainEXT hostDomain = vk::TimeDomainEXT::eClockMonotonic;
+#endif
+            auto domains = pDevice.getCalibrateableTimeDomainsEXT(dld);
+            calibratedTimestampsSupported = std::find(domains.begin(),domains.end(),vk::TimeDomainEXT::eDevice)!=domains.end()&&
+            std::find(domains.begin(),domains.end(),hostDomain)!=domains.end();
+            if(calibratedTimestampsSupported){
+                exts.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+            }
+        }
+    }
     deviceInfo.setPEnabledExtensionNames(exts);
     deviceInfo.setPEnabledLayerNames(layers);
     deviceInfo.setPEnabledFeatures(&features);
     float queuePriority = 1.0f;
     std::vector<vk::DeviceQueueCreateInfo> queueInfos;
     std::set<uint32_t> familyIndices{queueFamilyIndices.computeQueueFamily.value(),
-    queueFamilyIndices.graphicQueueFamily.value(),
-    queueFamilyIndices.presentQueueFamily.value()};
+    queueFamilyIndices.graphicQueueFamily.value()};
+    if(queueFamilyIndices.presentQueueFamily.has_value()){
+        familyIndices.insert(queueFamilyIndices.presentQueueFamily.value());
+    }
     for(auto indice:familyIndices){
         vk::DeviceQueueCreateInfo queueInfo;
         queueInfo.setQueueCount(1);
@@ -779,14 +1490,107 @@ void Renderer::initLogicalDevice()
         queueInfos.push_back(queueInfo);
     }
     deviceInfo.setQueueCreateInfos(queueInfos);
-    vk::PhysicalDeviceDescriptorIndexingFeatures diFeatures;
-    diFeatures.setDescriptorBindingPartiallyBound(true);
-    deviceInfo.setPNext(&diFeatures);
+    auto supported12 = pDevice.getFeatures2<vk::PhysicalDeviceFeatures2,vk::PhysicalDeviceVulkan12Features>();
+    vk::PhysicalDeviceVulkan12Features features12;
+    features12.setDescriptorBindingPartiallyBound(true);
+    features12.setDrawIndirectCount(supported12.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount);
+    drawIndirectCountSupported = features12.drawIndirectCount;
+    //lets the profiler reset its queries after reading them,so compute queue work can be timed too
+    features12.setHostQueryReset(supported12.get<vk::PhysicalDeviceVulkan12Features>().hostQueryReset);
+    hostQueryResetSupported = features12.hostQueryReset;
+    deviceInfo.setPNext(&features12);
+    //optional,lets the frame pacer wait for presents and measure when they happen
+    vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures;
+    vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures;
+    if(mode==RendererMode::eWindowed&&presentIdExt&&presentWaitExt){
+        auto supportedPresent = pDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+        vk::PhysicalDevicePresentIdFeaturesKHR,vk::PhysicalDevicePresentWaitFeaturesKHR>();
+        presentWaitSupported = supportedPresent.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId&&
+        supportedPresent.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+        if(presentWaitSupported){
+            exts.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            exts.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+            deviceInfo.setPEnabledExtensionNames(exts);
+            presentIdFeatures.setPresentId(true);
+            presentWaitFeatures.setPresentWait(true);
+            presentIdFeatures.setPNext(&presentWaitFeatures);
+            features12.setPNext(&presentIdFeatures);
+        }
+    }
     lDevice = pDevice.createDevice(deviceInfo);
+    dld.init(lDevice);
 
     computeQueue = lDevice.getQueue(queueFamilyIndices.computeQueueFamily.value(),0);
     graphicQueue = lDevice.getQueue(queueFamilyIndices.graphicQueueFamily.value(),0);
-    presentQueue = lDevice.getQueue(queueFamilyIndices.presentQueueFamily.value(),0);
+    if(queueFamilyIndices.presentQueueFamily.has_value()){
+        presentQueue = lDevice.getQueue(queueFamilyIndices.presentQueueFamily.value(),0);
+    }
+}
+//written in front of the driver's cache data in PIPELINE_CACHE_PATH.
+//the driver's own header has no driver version,and a cache from another driver is at best useless
+struct PipelineCacheFileHeader{
+    uint32_t magic;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+};
+#define PIPELINE_CACHE_MAGIC 0x43504b56
+void Renderer::initPipelineCache()
+{
+    vk::PhysicalDeviceProperties props = pDevice.getProperties();
+    std::vector<char> data;
+    std::ifstream ifs(PIPELINE_CACHE_PATH,std::ios::binary);
+    PipelineCacheFileHeader header;
+    if(ifs&&ifs.read(reinterpret_cast<char*>(&header),sizeof(header))){
+        bool valid = header.magic==PIPELINE_CACHE_MAGIC&&header.vendorID==props.vendorID&&header.deviceID==props.deviceID&&
+        header.driverVersion==props.driverVersion&&std::memcmp(header.pipelineCacheUUID,props.pipelineCacheUUID.data(),VK_UUID_SIZE)==0&&
+        header.dataSize>=sizeof(VkPipelineCacheHeaderVersionOne);
+        if(valid){
+            data.resize(header.dataSize);
+            valid = (bool)ifs.read(data.data(),data.size());
+        }
+        //the driver validates its header too,but some drivers have crashed on foreign data
+        if(valid){
+            VkPipelineCacheHeaderVersionOne driverHeader;
+            std::memcpy(&driverHeader,data.data(),sizeof(driverHeader));
+            valid = driverHeader.headerSize>=sizeof(driverHeader)&&driverHeader.headerVersion==VK_PIPELINE_CACHE_HEADER_VERSION_ONE&&
+            driverHeader.vendorID==props.vendorID&&driverHeader.deviceID==props.deviceID&&
+            std::memcmp(driverHeader.pipelineCacheUUID,props.pipelineCacheUUID.data(),VK_UUID_SIZE)==0;
+        }
+        if(!valid){
+            std::cerr<<"ignoring "<<PIPELINE_CACHE_PATH<<",it does not match this device and driver\n";
+            data.clear();
+        }
+    }
+    vk::PipelineCacheCreateInfo createInfo;
+    createInfo.setInitialDataSize(data.size());
+    createInfo.setPInitialData(data.data());
+    pipelineCache = lDevice.createPipelineCache(createInfo);
+    pipelineCacheStats.warm = !data.empty();
+    pipelineCacheStats.loadedBytes = data.size();
+}
+void Renderer::savePipelineCache()
+{
+    std::vector<uint8_t> data = lDevice.getPipelineCacheData(pipelineCache);
+    lDevice.destroyPipelineCache(pipelineCache);
+    vk::PhysicalDeviceProperties props = pDevice.getProperties();
+    PipelineCacheFileHeader header;
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.vendorID = props.vendorID;
+    header.deviceID = props.deviceID;
+    header.driverVersion = props.driverVersion;
+    std::memcpy(header.pipelineCacheUUID,props.pipelineCacheUUID.data(),VK_UUID_SIZE);
+    header.dataSize = data.size();
+    //a failed write only costs the next start its warm cache
+    std::ofstream ofs(PIPELINE_CACHE_PATH,std::ios::binary|std::ios::trunc);
+    if(!ofs){
+        std::cerr<<"failed to write "<<PIPELINE_CACHE_PATH<<'\n';
+        return;
+    }
+    ofs.write(reinterpret_cast<const char*>(&header),sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(data.data()),data.size());
 }
 void Renderer::initSwapchain()
 {
@@ -829,8 +1633,20 @@ void Renderer::initSwapchain()
     }
     swapchainInfo.setSurface(surface);
     swapchainInfo.setPreTransform(vk::SurfaceTransformFlagBitsKHR::eIdentity);
-    swapchainInfo.setMinImageCount(std::min(details.capabilities.minImageCount + 1,details.capabilities.maxImageCount));
-    swapchainInfo.setImageUsage(vk::ImageUsageFlagBits::eColorAttachment);
+    //maxImageCount 0 means no limit
+    uint32_t imageCount = options.pacing.imageCount?options.pacing.imageCount:details.capabilities.minImageCount+1;
+    imageCount = std::max(imageCount,details.capabilities.minImageCount);
+    if(details.capabilities.maxImageCount){
+        imageCount = std::min(imageCount,details.capabilities.maxImageCount);
+    }
+    swapchainInfo.setMinImageCount(imageCount);
+    swapchainInfo.setPresentMode(details.presentMode);
+    //null on the first call
+    swapchainInfo.setOldSwapchain(swapchain);
+    //copied from by capture
+    swapchainReadable = bool(details.capabilities.supportedUsageFlags&vk::ImageUsageFlagBits::eTransferSrc);
+    swapchainInfo.setImageUsage(vk::ImageUsageFlagBits::eColorAttachment|
+    (swapchainReadable?vk::ImageUsageFlagBits::eTransferSrc:vk::ImageUsageFlags()));
     
     swapchain = lDevice.createSwapchainKHR(swapchainInfo);
 
@@ -840,6 +1656,122 @@ void Renderer::initSwapchain()
         swapchainImageViews[i] = createImageView(swapchainImages[i],swapchainDetails.format.format,vk::ImageAspectFlagBits::eColor);
     }
 }
+void Renderer::initOffscreenImages()
+{
+    swapchainDetails.format = vk::SurfaceFormatKHR(HEADLESS_FORMAT,vk::ColorSpaceKHR::eSrgbNonlinear);
+    swapchainDetails.extent = options.extent;
+    swapchainImages.resize(framesInFlight);
+    offscreenImageMemory.resize(framesInFlight);
+    swapchainImageViews.resize(framesInFlight);
+    for(uint32_t i=0;i<framesInFlight;++i){
+        createImage(swapchainImages[i],offscreenImageMemory[i],swapchainDetails.extent,HEADLESS_FORMAT,
+        vk::ImageUsageFlagBits::eColorAttachment|vk::ImageUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eDeviceLocal);
+        swapchainImageViews[i] = createImageView(swapchainImages[i],HEADLESS_FORMAT,vk::ImageAspectFlagBits::eColor);
+    }
+    swapchainReadable = true;
+}
+void Renderer::startCapture(const CaptureOptions& options)
+{
+    if(capture){
+        return;
+    }
+    if(!swapchainReadable){
+        throw std::runtime_error("the swapchain images can't be captured!");
+    }
+    capture = new FrameCapture(this,options);
+}
+void Renderer::stopCapture()
+{
+    if(!capture){
+        return;
+    }
+    lDevice.waitIdle();
+    delete capture;
+    capture = nullptr;
+}
+void Renderer::saveFrame(const char* path)
+{
+    std::vector<uint8_t> pixels;
+    readFrame(pixels);
+    vk::Extent2D extent = swapchainDetails.extent;
+    if(!stbi_write_png(path,extent.width,extent.height,4,pixels.data(),extent.width*4)){
+        throw std::runtime_error(std::string("failed to write ")+path+"!");
+    }
+}
+void Renderer::readFrame(std::vector<uint8_t>& pixels)
+{
+    if(mode!=RendererMode::eHeadless||renderedFrames==0){
+        throw std::runtime_error("readFrame needs a frame rendered in headless mode!");
+    }
+    vk::Extent2D extent = swapchainDetails.extent;
+    int size = extent.width*extent.height*4;
+    vk::Buffer readbackBuffer;
+    GpuAllocation readbackMemory;
+    createBuffer(readbackBuffer,readbackMemory,size,vk::BufferUsageFlagBits::eTransferDst,
+    vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
+    //the render pass left the image in eTransferSrcOptimal,the one shot submit comes after the frame's
+    vk::CommandBuffer cb = startOneShotCommandBuffer(graphicCommandPool);
+    vk::MemoryBarrier barrier;
+    barrier.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+    barrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+    cb.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,vk::PipelineStageFlagBits::eTransfer,
+    vk::DependencyFlags(0),barrier,{},{});
+    vk::BufferImageCopy region;
+    region.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor,0,0,1));
+    region.setImageExtent(vk::Extent3D(extent.width,extent.height,1));
+    cb.copyImageToBuffer(swapchainImages[lastImage],vk::ImageLayout::eTransferSrcOptimal,readbackBuffer,region);
+    barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    barrier.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+    cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,vk::PipelineStageFlagBits::eHost,
+    vk::DependencyFlags(0),barrier,{},{});
+    finishOneShotCommandBuffer(graphicCommandPool,cb,graphicQueue);
+    pixels.resize(size);
+    std::memcpy(pixels.data(),readbackMemory.mapped,size);
+    destroyBuffer(readbackBuffer,readbackMemory);
+}
+void Renderer::setScene(vkglTF::Scene* scene)
+{
+    if(mode!=RendererMode::eHeadless||!scene->loaded){
+        throw std::runtime_error("setScene needs a loaded scene in headless mode!");
+    }
+    //the scene's buffers and descriptor sets may still be read by frames in flight
+    lDevice.waitIdle();
+    delete cullPass;
+    delete deformPass;
+    delete glTFScene;
+    cullPass = nullptr;
+    deformPass = nullptr;
+    cullStats = {};
+    glTFScene = scene;
+    initScenePasses();
+    //every scene's set layouts are defined alike,so defaultGraphicPipelineLayout stays compatible.
+    //a renderer started without a scene creates it from the first one
+    if(!defaultGraphicPipelineLayout){
+        initScenePipelineLayout();
+    }
+    initPipelines();
+}
+void Renderer::frameScene()
+{
+    glm::vec3 center = (glTFScene->boundsMin+glTFScene->boundsMax)*0.5f;
+    float radius = glm::length(glTFScene->boundsMax-glTFScene->boundsMin)*0.5f;
+    if(!(radius>0.0f)){
+        radius = 1.0f;
+    }
+    //the bounding sphere has to fit the narrower of the two fields of view
+    fovY = glm::radians(45.0f);
+    float aspect = 1.0f*swapchainDetails.extent.width/swapchainDetails.extent.height;
+    float halfFov = std::min(fovY*0.5f,std::atan(std::tan(fovY*0.5f)*aspect));
+    float distance = radius/std::sin(halfFov);
+    //the same three quarter view initCamera starts with
+    camera.viewDirection = glm::normalize(glm::vec3(-1,-1,-1));
+    camera.cameraPosition = center-camera.viewDirection*distance;
+    camera.viewMat = glm::lookAt(camera.cameraPosition,camera.cameraPosition+camera.viewDirection,glm::vec3{0,1,0});
+    zNear = distance*0.01f;
+    zFar = distance+radius*2.0f;
+    updateProjection();
+}
 void Renderer::initCamera()
 {
     //sponza
@@ -849,43 +1781,141 @@ void Renderer::initCamera()
     //damgedHelmet
     camera.viewDirection = glm::normalize(glm::vec3(-1,-1,-1));
     camera.viewMat = glm::lookAt(camera.cameraPosition,camera.cameraPosition+camera.viewDirection,glm::vec3{0,1,0});
-    camera.projectionMat = glm::perspective(glm::radians(45.0f),1.0f*swapchainDetails.extent.width/swapchainDetails.extent.height,0.01f,1000.0f);
+    fovY = glm::radians(45.0f);
+    zNear = 0.01f;
+    zFar = 1000.0f;
+    updateProjection();
+}
+void Renderer::updateProjection()
+{
+    camera.projectionMat = glm::perspective(fovY,1.0f*swapchainDetails.extent.width/swapchainDetails.extent.height,zNear,zFar);
     camera.projectionMat[1][1] *= -1;
 }
-void Renderer::reinitSwapchain()
+bool Renderer::reinitSwapchain()
 {
-    lDevice.waitIdle();
-    for(int i=0;i<imguiFrameBuffers.size();++i){
-        lDevice.destroyFramebuffer(imguiFrameBuffers[i]);
-    }
-    for(int i=0;i<swapchainImageViews.size();++i){
-        lDevice.destroyImageView(swapchainImageViews[i]);
+    //minimized windows may have a zero extent,no swapchain can be created for it
+    vk::SurfaceCapabilitiesKHR capabilities = pDevice.getSurfaceCapabilitiesKHR(surface);
+    if(capabilities.currentExtent.width==0||capabilities.currentExtent.height==0){
+        return false;
     }
-    lDevice.destroyImageView(depthImageView);
-    lDevice.destroyImage(depthImage);
-    lDevice.freeMemory(depthImageMemory);
-    lDevice.destroySwapchainKHR(swapchain);
+    TraceScope scope("recreate swapchain");
+    //frames in flight still render into the old images and present them,
+    //so everything sized by the swapchain is retired instead of destroyed
+    vk::SwapchainKHR oldSwapchain = swapchain;
+    std::vector<vk::ImageView> oldImageViews = swapchainImageViews;
+    std::vector<vk::Framebuffer> oldFramebuffers = frameBuffers;
+    oldFramebuffers.push_back(sceneFramebuffer);
+    std::vector<vk::Semaphore> oldSemaphores = renderingFinished;
+    vk::Image oldColorImage = sceneColorImage;
+    GpuAllocation oldColorMemory = sceneColorImageMemory;
+    vk::ImageView oldColorView = sceneColorImageView;
+    vk::Image oldDepthImage = depthImage;
+    GpuAllocation oldDepthMemory = depthImageMemory;
+    vk::ImageView oldDepthView = depthImageView;
+    vk::DescriptorSet oldUpscaleSet = upscaleSet;
+    retire([=,this]()mutable{
+        lDevice.freeDescriptorSets(descriptorPool,oldUpscaleSet);
+        for(auto frameBuffer:oldFramebuffers){
+            lDevice.destroyFramebuffer(frameBuffer);
+        }
+        for(auto imageView:oldImageViews){
+            lDevice.destroyImageView(imageView);
+        }
+        lDevice.destroyImageView(oldColorView);
+        destroyImage(oldColorImage,oldColorMemory);
+        lDevice.destroyImageView(oldDepthView);
+        destroyImage(oldDepthImage,oldDepthMemory);
+        for(auto semaphore:oldSemaphores){
+            lDevice.destroySemaphore(semaphore);
+        }
+        lDevice.destroySwapchainKHR(oldSwapchain);
+    });
+    //hands the old swapchain over,its images can still be presented
     initSwapchain();
-    initDepthResources();
+    initSceneTarget();
     initFramebuffer();
+    initUpscaleSet();
+    updateProjection();
+    if(cullPass){
+        cullPass->resize();
+    }
+    if(capture){
+        //readback buffers may still be copied into,capturing while resizing stalls
+        lDevice.waitIdle();
+        capture->resize();
+    }
+    //the image count may have changed
+    vk::SemaphoreCreateInfo semaphoreInfo;
+    renderingFinished.resize(swapchainImages.size());
+    for(auto& semaphore:renderingFinished){
+        semaphore = lDevice.createSemaphore(semaphoreInfo);
+    }
+    imagesInFlight.assign(swapchainImages.size(),vk::Fence());
+    if(pacer){
+        pacer->swapchainRecreated();
+    }
+    swapchainDirty = false;
+    return true;
 }
-void Renderer::initDepthResources()
+std::optional<uint32_t> Renderer::acquireImage(vk::Semaphore semaphore)
 {
-    createImage(depthImage,depthImageMemory,swapchainDetails.extent,vk::Format::eD32SfloatS8Uint,
-    vk::ImageUsageFlagBits::eDepthStencilAttachment,vk::MemoryPropertyFlagBits::eDeviceLocal);
+    //once with the current swapchain,once more with a new one if it was out of date
+    for(int attempt=0;attempt<2;++attempt){
+        try{
+            auto [result,imageIndex] = lDevice.acquireNextImageKHR(swapchain,notimeout,semaphore);
+            //the semaphore is signaled and the image has to be presented,the swapchain is recreated next frame
+            if(result==vk::Result::eSuboptimalKHR){
+                swapchainDirty = true;
+            }
+            return imageIndex;
+        }
+        catch(vk::OutOfDateKHRError){
+            if(!reinitSwapchain()){
+                return std::nullopt;
+            }
+        }
+    }
+    return std::nullopt;
+}
+void Renderer::retire(std::function<void()> destroy)
+{
+    retired.push_back({renderedFrames,std::move(destroy)});
+}
+void Renderer::destroyRetired(bool all)
+{
+    //the fence of the frame being recorded was waited on,so every frame framesInFlight before it is done
+    while(!retired.empty()&&(all||retired.front().frame+framesInFlight<=renderedFrames)){
+        retired.front().destroy();
+        retired.pop_front();
+    }
+}
+void Renderer::initSceneTarget()
+{
+    //render scales are at most 1,so the target never outgrows the swapchain
+    sceneExtent = swapchainDetails.extent;
+    renderExtent = sceneExtent;
+    vk::Format colorFormat = swapchainDetails.format.format;
+    vk::FormatFeatureFlags features = pDevice.getFormatProperties(colorFormat).optimalTilingFeatures;
+    if(!(features&vk::FormatFeatureFlagBits::eSampledImage)){
+        throw std::runtime_error("the scene target can't be sampled by the output pass!");
+    }
+    sceneFilterLinear = bool(features&vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+    createImage(sceneColorImage,sceneColorImageMemory,sceneExtent,colorFormat,
+    vk::ImageUsageFlagBits::eColorAttachment|vk::ImageUsageFlagBits::eSampled,vk::MemoryPropertyFlagBits::eDeviceLocal);
+    sceneColorImageView = createImageView(sceneColorImage,colorFormat,vk::ImageAspectFlagBits::eColor);
+
+    createImage(depthImage,depthImageMemory,sceneExtent,vk::Format::eD32SfloatS8Uint,
+    vk::ImageUsageFlagBits::eDepthStencilAttachment|vk::ImageUsageFlagBits::eSampled,vk::MemoryPropertyFlagBits::eDeviceLocal);
     depthImageView = createImageView(depthImage,vk::Format::eD32SfloatS8Uint,vk::ImageAspectFlagBits::eDepth);
-    vk::CommandBuffer cb = startOneShotCommandBuffer(graphicCommandPool);
-    vk::ImageMemoryBarrier imageBarrier;
-    imageBarrier.setImage(depthImage);
-    imageBarrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eDepth|vk::ImageAspectFlagBits::eStencil;
-    imageBarrier.subresourceRange.layerCount = 1;
-    imageBarrier.subresourceRange.levelCount = 1;
-    imageBarrier.setSrcAccessMask(vk::AccessFlags(0));
-    imageBarrier.setDstAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentRead|vk::AccessFlagBits::eDepthStencilAttachmentWrite);
-    imageBarrier.setOldLayout(vk::ImageLayout::eUndefined);
-    imageBarrier.setNewLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
-    cb.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,vk::PipelineStageFlagBits::eEarlyFragmentTests,vk::DependencyFlags(0),{},{},imageBarrier);
-    finishOneShotCommandBuffer(graphicCommandPool,cb,graphicQueue);
+    //no layout transition here,the scene passes that clear depth start from eUndefined.
+    //a one shot command buffer would wait for the device,and this runs while frames are in flight on resize
+}
+void Renderer::destroySceneTarget()
+{
+    lDevice.destroyImageView(sceneColorImageView);
+    destroyImage(sceneColorImage,sceneColorImageMemory);
+    lDevice.destroyImageView(depthImageView);
+    destroyImage(depthImage,depthImageMemory);
 }
 void Renderer::initCommandPool()
 {
@@ -905,10 +1935,14 @@ void Renderer::initCommandPool()
 void Renderer::initCommandBuffers()
 {
     vk::CommandBufferAllocateInfo allocateInfo;
-    allocateInfo.setCommandBufferCount(1);
+    allocateInfo.setCommandBufferCount(framesInFlight);
     allocateInfo.setCommandPool(graphicCommandPool);
     allocateInfo.setLevel(vk::CommandBufferLevel::ePrimary);
-    renderingCommandBuffers = lDevice.allocateCommandBuffers(allocateInfo)[0];
+    std::vector<vk::CommandBuffer> commandBuffers = lDevice.allocateCommandBuffers(allocateInfo);
+    frames.resize(framesInFlight);
+    for(uint32_t i=0;i<framesInFlight;++i){
+        frames[i].commandBuffer = commandBuffers[i];
+    }
 }
 void Renderer::initglTFScene()
 {
@@ -918,151 +1952,193 @@ void Renderer::initglTFScene()
     vkBase.physicalDevice = pDevice;
     vkBase.graphicQueue = graphicQueue;
     vkBase.graphicQueueFamily = queueFamilyIndices.graphicQueueFamily.value();
+    if(options.scenePath.empty()&&mode==RendererMode::eHeadless){
+        return;
+    }
     glTFScene = new vkglTF::Scene(this);
-    glTFScene->loadFile("assets/damagedHelmet/DamagedHelmet.gltf");
+    glTFScene->loadFile(options.scenePath.c_str());
+    initScenePasses();
+}
+void Renderer::initScenePasses()
+{
+    if(glTFScene->deformVertexCount){
+        deformPass = new DeformPass(this,glTFScene);
+    }
+    if(glTFScene->drawInstanceCount){
+        cullPass = new CullPass(this,glTFScene);
+    }
 }
 void Renderer::initDescriptorPool()
 {
-    std::array<vk::DescriptorPoolSize,3> poolSizes = {
+    std::array<vk::DescriptorPoolSize,5> poolSizes = {
         vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler,1024),
         vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer,1024),
-        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer,8),
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer,128),
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBufferDynamic,16),
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage,32),
     };
     vk::DescriptorPoolCreateInfo poolInfo;
-    poolInfo.setMaxSets(16);
+    poolInfo.setMaxSets(64);
     poolInfo.setPoolSizes(poolSizes);
+    //scenes free their sets on cleanup
+    poolInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
     
     descriptorPool = lDevice.createDescriptorPool(poolInfo);
 }
 void Renderer::initRenderPass()
 {
-    {
-        //imgui renderpass
-        vk::AttachmentDescription colorAttachment;
-        colorAttachment.setFormat(swapchainDetails.format.format);
-        colorAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
-        colorAttachment.setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
-        colorAttachment.setLoadOp(vk::AttachmentLoadOp::eDontCare);
-        colorAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
-        colorAttachment.setSamples(vk::SampleCountFlagBits::e1);
-        std::vector<vk::AttachmentDescription> attachments = {
-            colorAttachment,
-        };
-        vk::AttachmentReference ref_colorAttachment;
-        ref_colorAttachment.setAttachment(0);
-        ref_colorAttachment.setLayout(vk::ImageLayout::eColorAttachmentOptimal);
-
-        vk::SubpassDescription imguiSubpassInfo;
-        imguiSubpassInfo.setColorAttachments(ref_colorAttachment);
-        imguiSubpassInfo.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
-        std::vector<vk::SubpassDescription> subpasses = {
-            imguiSubpassInfo
-        };
-        std::vector<vk::SubpassDependency> subpassDependencies={
-            vk::SubpassDependency(VK_SUBPASS_EXTERNAL,0,
-            vk::PipelineStageFlagBits::eColorAttachmentOutput,vk::PipelineStageFlagBits::eColorAttachmentOutput,
-            vk::AccessFlagBits::eNone,vk::AccessFlagBits::eColorAttachmentWrite),
-        };
-
-        vk::RenderPassCreateInfo renderpassInfo; 
-        renderpassInfo.setAttachments(attachments);
-        renderpassInfo.setDependencies(subpassDependencies);
-        renderpassInfo.setSubpasses(subpasses);
-
-        imguiRenderPass = lDevice.createRenderPass(renderpassInfo);
-    }
-    {
-        //default renderpass
-        vk::AttachmentDescription colorAttachment;
-        colorAttachment.setFormat(swapchainDetails.format.format);
-        colorAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
-        colorAttachment.setFinalLayout(vk::ImageLayout::eColorAttachmentOptimal);
-
-        colorAttachment.setLoadOp(vk::AttachmentLoadOp::eClear);
-        colorAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
-        colorAttachment.setSamples(vk::SampleCountFlagBits::e1);
-
-        vk::AttachmentDescription depthAttachment;
-        depthAttachment.setFormat(vk::Format::eD32SfloatS8Uint);
-        depthAttachment.setInitialLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
-        depthAttachment.setFinalLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
-
-        depthAttachment.setLoadOp(vk::AttachmentLoadOp::eClear);
-        depthAttachment.setStoreOp(vk::AttachmentStoreOp::eDontCare);
-        depthAttachment.setSamples(vk::SampleCountFlagBits::e1);
-
-        std::vector<vk::AttachmentDescription> attachments = {
-            colorAttachment,depthAttachment
-        };
-        vk::AttachmentReference ref_colorAttachment;
-        ref_colorAttachment.setAttachment(0);
-        ref_colorAttachment.setLayout(vk::ImageLayout::eColorAttachmentOptimal);
-        vk::AttachmentReference ref_depthAttachment;
-        ref_depthAttachment.setAttachment(1);
-        ref_depthAttachment.setLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
-
-        vk::SubpassDescription defaultSubpassInfo;
-        defaultSubpassInfo.setColorAttachments(ref_colorAttachment);
-        defaultSubpassInfo.setPDepthStencilAttachment(&ref_depthAttachment);
-        defaultSubpassInfo.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
-        std::vector<vk::SubpassDescription> subpasses = {
-            defaultSubpassInfo
-        };
-
-        vk::RenderPassCreateInfo renderpassInfo; 
-        renderpassInfo.setAttachments(attachments);
-        renderpassInfo.setSubpasses(subpasses);
+    //the scene passes draw into the scene target,whose color is left ready to be sampled by the output pass.
+    //all three differ in load/store ops and layouts only,so pipelines and the scene framebuffer work with each
+    vk::AttachmentDescription colorAttachment;
+    colorAttachment.setFormat(swapchainDetails.format.format);
+    colorAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
+    colorAttachment.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    colorAttachment.setLoadOp(vk::AttachmentLoadOp::eClear);
+    colorAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
+    colorAttachment.setSamples(vk::SampleCountFlagBits::e1);
+
+    vk::AttachmentDescription depthAttachment;
+    depthAttachment.setFormat(vk::Format::eD32SfloatS8Uint);
+    //cleared,so the last frame's contents and layout don't matter
+    depthAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
+    depthAttachment.setFinalLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+    depthAttachment.setLoadOp(vk::AttachmentLoadOp::eClear);
+    depthAttachment.setStoreOp(vk::AttachmentStoreOp::eDontCare);
+    depthAttachment.setSamples(vk::SampleCountFlagBits::e1);
+
+    std::vector<vk::AttachmentDescription> attachments = {
+        colorAttachment,depthAttachment
+    };
+    vk::AttachmentReference ref_colorAttachment;
+    ref_colorAttachment.setAttachment(0);
+    ref_colorAttachment.setLayout(vk::ImageLayout::eColorAttachmentOptimal);
+    vk::AttachmentReference ref_depthAttachment;
+    ref_depthAttachment.setAttachment(1);
+    ref_depthAttachment.setLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+    vk::SubpassDescription sceneSubpassInfo;
+    sceneSubpassInfo.setColorAttachments(ref_colorAttachment);
+    sceneSubpassInfo.setPDepthStencilAttachment(&ref_depthAttachment);
+    sceneSubpassInfo.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
+    std::vector<vk::SubpassDependency> subpassDependencies={
+        //the last frame is done upscaling color and with depth,the early pass is done with color
+        vk::SubpassDependency(VK_SUBPASS_EXTERNAL,0,
+        vk::PipelineStageFlagBits::eFragmentShader|vk::PipelineStageFlagBits::eColorAttachmentOutput|vk::PipelineStageFlagBits::eLateFragmentTests,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput|vk::PipelineStageFlagBits::eEarlyFragmentTests,
+        vk::AccessFlagBits::eColorAttachmentWrite|vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+        vk::AccessFlagBits::eColorAttachmentWrite|vk::AccessFlagBits::eDepthStencilAttachmentRead|vk::AccessFlagBits::eDepthStencilAttachmentWrite),
+        //color is sampled by the output pass right after
+        vk::SubpassDependency(0,VK_SUBPASS_EXTERNAL,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,vk::PipelineStageFlagBits::eFragmentShader,
+        vk::AccessFlagBits::eColorAttachmentWrite,vk::AccessFlagBits::eShaderRead),
+    };
 
-        defaultGraphicRenderPass = lDevice.createRenderPass(renderpassInfo);
-    }
+    vk::RenderPassCreateInfo renderpassInfo; 
+    renderpassInfo.setAttachments(attachments);
+    renderpassInfo.setSubpasses(sceneSubpassInfo);
+    renderpassInfo.setDependencies(subpassDependencies);
+    defaultGraphicRenderPass = lDevice.createRenderPass(renderpassInfo);
+
+    //with occlusion culling,the early pass keeps color and depth for the pyramid and the late pass
+    attachments[0].setFinalLayout(vk::ImageLayout::eColorAttachmentOptimal);
+    attachments[1].setStoreOp(vk::AttachmentStoreOp::eStore);
+    renderpassInfo.setAttachments(attachments);
+    earlyGraphicRenderPass = lDevice.createRenderPass(renderpassInfo);
+
+    attachments[0].setInitialLayout(vk::ImageLayout::eColorAttachmentOptimal);
+    attachments[0].setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    attachments[0].setLoadOp(vk::AttachmentLoadOp::eLoad);
+    attachments[1].setInitialLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+    attachments[1].setLoadOp(vk::AttachmentLoadOp::eLoad);
+    attachments[1].setStoreOp(vk::AttachmentStoreOp::eDontCare);
+    renderpassInfo.setAttachments(attachments);
+    lateGraphicRenderPass = lDevice.createRenderPass(renderpassInfo);
+
+    //the upscale covers every pixel,so the swapchain image is neither loaded nor cleared,
+    //and the ui draws over it in the same subpass.offscreen images are left ready to be copied out
+    vk::AttachmentDescription outputAttachment;
+    outputAttachment.setFormat(swapchainDetails.format.format);
+    outputAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
+    outputAttachment.setFinalLayout(mode==RendererMode::eHeadless?vk::ImageLayout::eTransferSrcOptimal:vk::ImageLayout::ePresentSrcKHR);
+    outputAttachment.setLoadOp(vk::AttachmentLoadOp::eDontCare);
+    outputAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
+    outputAttachment.setSamples(vk::SampleCountFlagBits::e1);
+    vk::SubpassDescription outputSubpassInfo;
+    outputSubpassInfo.setColorAttachments(ref_colorAttachment);
+    outputSubpassInfo.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
+    //the image is acquired,the semaphore is waited on at eColorAttachmentOutput
+    vk::SubpassDependency outputDependency(VK_SUBPASS_EXTERNAL,0,
+    vk::PipelineStageFlagBits::eColorAttachmentOutput,vk::PipelineStageFlagBits::eColorAttachmentOutput,
+    vk::AccessFlags(0),vk::AccessFlagBits::eColorAttachmentWrite);
+    vk::RenderPassCreateInfo outputRenderpassInfo;
+    outputRenderpassInfo.setAttachments(outputAttachment);
+    outputRenderpassInfo.setSubpasses(outputSubpassInfo);
+    outputRenderpassInfo.setDependencies(outputDependency);
+    outputRenderPass = lDevice.createRenderPass(outputRenderpassInfo);
 }
 void Renderer::initFramebuffer()
 {
-    imguiFrameBuffers.resize(swapchainImages.size());
-    defaultGraphicFrameBuffers.resize(swapchainImages.size());
-    for(int i=0;i<imguiFrameBuffers.size();++i){
+    {
         vk::FramebufferCreateInfo framebufferInfo;
-        framebufferInfo.setAttachments(swapchainImageViews[i]);
-        framebufferInfo.setWidth(swapchainDetails.extent.width);
-        framebufferInfo.setHeight(swapchainDetails.extent.height);
+        std::array<vk::ImageView,2> attachments = {sceneColorImageView,depthImageView};
+        framebufferInfo.setAttachments(attachments);
+        framebufferInfo.setWidth(sceneExtent.width);
+        framebufferInfo.setHeight(sceneExtent.height);
         framebufferInfo.setLayers(1);
-        framebufferInfo.setRenderPass(imguiRenderPass);
-        imguiFrameBuffers[i] = lDevice.createFramebuffer(framebufferInfo);
+        framebufferInfo.setRenderPass(defaultGraphicRenderPass);
+        sceneFramebuffer = lDevice.createFramebuffer(framebufferInfo);
     }
-    for(int i=0;i<defaultGraphicFrameBuffers.size();++i){
+    frameBuffers.resize(swapchainImages.size());
+    for(int i=0;i<frameBuffers.size();++i){
         vk::FramebufferCreateInfo framebufferInfo;
-        std::array<vk::ImageView,2> attachments = {swapchainImageViews[i],depthImageView};
-        framebufferInfo.setAttachments(attachments);
+        framebufferInfo.setAttachments(swapchainImageViews[i]);
         framebufferInfo.setWidth(swapchainDetails.extent.width);
         framebufferInfo.setHeight(swapchainDetails.extent.height);
         framebufferInfo.setLayers(1);
-        framebufferInfo.setRenderPass(defaultGraphicRenderPass);
-        defaultGraphicFrameBuffers[i] = lDevice.createFramebuffer(framebufferInfo);
+        framebufferInfo.setRenderPass(outputRenderPass);
+        frameBuffers[i] = lDevice.createFramebuffer(framebufferInfo);
     }
-
 }
 void Renderer::initSyncObjects()
 {
-  
     vk::SemaphoreCreateInfo semaphoreInfo;
-    imageAvaliable = lDevice.createSemaphore(semaphoreInfo);
-    renderingFinished = lDevice.createSemaphore(semaphoreInfo);
-    
     vk::FenceCreateInfo fenceInfo;
     fenceInfo.setFlags(vk::FenceCreateFlagBits::eSignaled);
-    inflightFence = lDevice.createFence(fenceInfo);
-    
+    for(auto& frame:frames){
+        frame.imageAvaliable = lDevice.createSemaphore(semaphoreInfo);
+        frame.inflightFence = lDevice.createFence(fenceInfo);
+    }
+    renderingFinished.resize(swapchainImages.size());
+    for(auto& semaphore:renderingFinished){
+        semaphore = lDevice.createSemaphore(semaphoreInfo);
+    }
+    imagesInFlight.assign(swapchainImages.size(),vk::Fence());
+    lastFrameStart = std::chrono::high_resolution_clock::now();
+}
+void Renderer::initProfiler()
+{
+    profiler = new Profiler(this,framesInFlight);
 }
 uint32_t Renderer::getInstanceLayers(std::vector<const char *> &layers)
 {
     layers.resize(0);
-    layers.push_back("VK_LAYER_KHRONOS_validation");
+    //only when installed,machines running the benchmarks often have no SDK
+    for(auto& layer:vk::enumerateInstanceLayerProperties()){
+        if(std::strcmp(layer.layerName,"VK_LAYER_KHRONOS_validation")==0){
+            layers.push_back("VK_LAYER_KHRONOS_validation");
+            break;
+        }
+    }
     return layers.size();
 }
 
 uint32_t Renderer::getInstanceExts(std::vector<const char *>& exts)
 {
     exts.resize(0);
+    if(mode!=RendererMode::eWindowed){
+        exts.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        return exts.size();
+    }
     uint32_t sdlExtCounts;
     std::vector<const char*> sdlExts;
     SDL_Vulkan_GetInstanceExtensions(sdlWindow,&sdlExtCounts,nullptr);
@@ -0,0 +1,30 @@
+#include"resolution.h"
+
+#include<algorithm>
+#include<cmath>
+
+float ResolutionController::update(float gpuTime,uint32_t latency)
+{
+    float minScale = std::clamp(options.minScale,0.1f,1.0f);
+    float maxScale = std::clamp(options.maxScale,minScale,1.0f);
+    if(!options.enabled||gpuTime<=0.0f||options.gpuBudget<=0.0f){
+        scale = maxScale;
+        return scale;
+    }
+    if(cooldown){
+        --cooldown;
+        return scale;
+    }
+    float target = options.gpuBudget*RESOLUTION_HEADROOM;
+    if(std::abs(gpuTime-target)<=target*RESOLUTION_DEADBAND){
+        return scale;
+    }
+    float wanted = scale*std::sqrt(target/gpuTime);
+    wanted = std::clamp(wanted,scale-RESOLUTION_MAX_STEP,scale+RESOLUTION_MAX_STEP);
+    wanted = std::clamp(wanted,minScale,maxScale);
+    if(wanted!=scale){
+        scale = wanted;
+        cooldown = latency;
+    }
+    return scale;
+}
@@ -0,0 +1,133 @@
+#include"threadpool.h"
+#include"trace.h"
+
+#include<atomic>
+#include<algorithm>
+#include<memory>
+namespace vkglTF{
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    if(threadCount==0){
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads>1?hardwareThreads-1:1;
+    }
+    workers.reserve(threadCount);
+    for(uint32_t i=0;i<threadCount;++i){
+        workers.emplace_back(&ThreadPool::workerLoop,this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvaliable.notify_all();
+    for(auto& worker:workers){
+        worker.join();
+    }
+}
+
+uint32_t ThreadPool::getThreadCount() const
+{
+    return workers.size()+1;
+}
+
+void ThreadPool::parallelFor(uint32_t count,uint32_t grainSize,const std::function<void(uint32_t,uint32_t)>& fn)
+{
+    if(count==0){
+        return;
+    }
+    grainSize = grainSize?grainSize:1;
+    uint32_t chunkCount = (count+grainSize-1)/grainSize;
+    if(chunkCount==1||workers.empty()){
+        fn(0,count);
+        return;
+    }
+    //helpers may still be queued after the last chunk is done,so the shared state outlives this call.
+    struct ForState{
+        std::atomic<uint32_t> nextChunk{0};
+        std::atomic<uint32_t> doneChunks{0};
+        uint32_t chunkCount;
+        uint32_t count;
+        uint32_t grainSize;
+        const std::function<void(uint32_t,uint32_t)>* fn;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<ForState>();
+    state->chunkCount = chunkCount;
+    state->count = count;
+    state->grainSize = grainSize;
+    state->fn = &fn;
+    auto runChunks = [](ForState& s){
+        uint32_t chunk;
+        while((chunk = s.nextChunk.fetch_add(1))<s.chunkCount){
+            uint32_t begin = chunk*s.grainSize;
+            uint32_t end = std::min(begin+s.grainSize,s.count);
+            (*s.fn)(begin,end);
+            if(s.doneChunks.fetch_add(1)+1==s.chunkCount){
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.finished.notify_all();
+            }
+        }
+    };
+    uint32_t helperCount = std::min<uint32_t>(workers.size(),chunkCount-1);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(uint32_t i=0;i<helperCount;++i){
+            jobs.push_back([state,runChunks](){runChunks(*state);});
+        }
+    }
+    jobAvaliable.notify_all();
+    runChunks(*state);
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock,[&](){return state->doneChunks.load()==state->chunkCount;});
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobAvaliable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsFinished.wait(lock,[this](){return jobs.empty()&&runningJobs==0;});
+}
+
+void ThreadPool::workerLoop()
+{
+    Tracer::setThreadName("pool worker");
+    while(true){
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvaliable.wait(lock,[this](){return stopping||!jobs.empty();});
+            if(stopping&&jobs.empty()){
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            ++runningJobs;
+        }
+        {
+            TraceScope scope("job");
+            job();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --runningJobs;
+            if(jobs.empty()&&runningJobs==0){
+                jobsFinished.notify_all();
+            }
+        }
+    }
+}
+}
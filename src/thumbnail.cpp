@@ -0,0 +1,149 @@
+#include"thumbnail.h"
+#include"renderer.h"
+#include"vkglTF.h"
+#include"stb_image_write.h"
+#include"trace.h"
+
+#include<iostream>
+#include<filesystem>
+#include<chrono>
+#include<unordered_set>
+
+static double lap(std::chrono::high_resolution_clock::time_point& start){
+    auto now = std::chrono::high_resolution_clock::now();
+    double ms = std::chrono::duration<double,std::milli>(now-start).count();
+    start = now;
+    return ms;
+}
+
+//the listed path without extension,with separators turned into '_' so assets named alike in different directories
+//(*/scene.gltf) don't overwrite each other.names that still collide get a number appended
+static std::vector<std::string> outputNames(const std::vector<std::string>& paths)
+{
+    std::vector<std::string> names;
+    std::unordered_set<std::string> used;
+    for(size_t i=0;i<paths.size();++i){
+        std::string name = std::filesystem::path(paths[i]).replace_extension().generic_string();
+        while(name.rfind("../",0)==0||name.rfind("./",0)==0){
+            name.erase(0,name.find('/')+1);
+        }
+        name.erase(0,name.find_first_not_of('/'));
+        for(auto& c:name){
+            if(c=='/'||c=='\\'||c==':'){
+                c = '_';
+            }
+        }
+        std::string unique = name;
+        for(uint32_t n=1;!used.insert(unique).second;++n){
+            unique = name+"-"+std::to_string(n);
+        }
+        names.push_back(unique+".png");
+    }
+    return names;
+}
+
+ThumbnailBatch::ThumbnailBatch(Renderer* renderer,uint32_t framesPerAsset):renderer(renderer),framesPerAsset(framesPerAsset)
+{
+    if(renderer->mode!=RendererMode::eHeadless){
+        throw std::runtime_error("thumbnails need a headless renderer!");
+    }
+}
+
+ThumbnailBatch::~ThumbnailBatch()
+{
+    while(!pendingWrites.empty()){
+        pendingWrites.front().written.wait();
+        pendingWrites.pop_front();
+    }
+}
+
+vkglTF::Scene* ThumbnailBatch::readScene(const std::string& path)
+{
+    Tracer::setThreadName("scene reader");
+    TraceScope scope("read scene");
+    vkglTF::Scene* scene = new vkglTF::Scene(renderer);
+    try{
+        scene->readFile(path.c_str());
+    }
+    catch(...){
+        delete scene;
+        throw;
+    }
+    return scene;
+}
+
+void ThumbnailBatch::waitWrite()
+{
+    PendingWrite& write = pendingWrites.front();
+    if(!write.written.get()){
+        std::cerr<<"failed to write "<<write.path<<"!"<<std::endl;
+        --stats.rendered;
+        ++stats.failed;
+    }
+    pendingWrites.pop_front();
+}
+
+const ThumbnailStats& ThumbnailBatch::run(const std::vector<std::string>& paths,const std::string& outDir)
+{
+    stats = ThumbnailStats();
+    std::filesystem::create_directories(outDir);
+    std::vector<std::string> names = outputNames(paths);
+    auto batchStart = std::chrono::high_resolution_clock::now();
+    std::future<vkglTF::Scene*> nextScene;
+    auto readNext = [&](size_t i){
+        if(i<paths.size()){
+            nextScene = std::async(std::launch::async,&ThumbnailBatch::readScene,this,paths[i]);
+        }
+    };
+    readNext(0);
+    for(size_t i=0;i<paths.size();++i){
+        auto stageStart = std::chrono::high_resolution_clock::now();
+        vkglTF::Scene* scene = nullptr;
+        try{
+            scene = nextScene.get();
+            stats.readWait += lap(stageStart);
+            //the next read overlaps the upload too,it doesn't touch Vulkan
+            readNext(i+1);
+            scene->upload();
+            renderer->setScene(scene);
+            stats.upload += lap(stageStart);
+        }
+        catch(std::runtime_error err){
+            std::cerr<<paths[i]<<":"<<err.what()<<std::endl;
+            delete scene;
+            ++stats.failed;
+            if(!nextScene.valid()){
+                readNext(i+1);
+            }
+            continue;
+        }
+        renderer->frameScene();
+        for(uint32_t frame=0;frame<framesPerAsset;++frame){
+            renderer->tick();
+        }
+        stats.render += lap(stageStart);
+
+        while(pendingWrites.size()>=THUMBNAIL_MAX_PENDING_WRITES){
+            waitWrite();
+        }
+        stats.writeWait += lap(stageStart);
+        std::vector<uint8_t> pixels;
+        renderer->readFrame(pixels);
+        stats.readback += lap(stageStart);
+        std::string output = (std::filesystem::path(outDir)/names[i]).string();
+        vk::Extent2D extent = renderer->getExtent();
+        pendingWrites.push_back({output,std::async(std::launch::async,[output,extent,pixels = std::move(pixels)](){
+            Tracer::setThreadName("thumbnail writer");
+            TraceScope scope("write thumbnail");
+            return stbi_write_png(output.c_str(),extent.width,extent.height,4,pixels.data(),extent.width*4)!=0;
+        })});
+        ++stats.rendered;
+    }
+    auto stageStart = std::chrono::high_resolution_clock::now();
+    while(!pendingWrites.empty()){
+        waitWrite();
+    }
+    stats.writeWait += lap(stageStart);
+    stats.total = lap(batchStart);
+    return stats;
+}
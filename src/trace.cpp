@@ -0,0 +1,149 @@
+#include"trace.h"
+
+#include<vector>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<fstream>
+#include<cstring>
+
+struct TraceEvent{
+    const char* name;
+    int64_t begin;
+    int64_t end;
+};
+//a thread or a GPU queue.tracks live as long as the process,so threads can keep a pointer to theirs
+struct TraceTrack{
+    uint32_t id;
+    const char* name;
+    bool gpu;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    uint64_t dropped = 0;
+};
+
+std::atomic<bool> Tracer::active = false;
+static std::mutex tracksMutex;
+static std::vector<std::unique_ptr<TraceTrack>> tracks;
+static int64_t traceStart = 0;
+thread_local TraceTrack* threadTrack = nullptr;
+thread_local const char* threadName = nullptr;
+
+static TraceTrack* createTrack(const char* name,bool gpu)
+{
+    std::lock_guard<std::mutex> lock(tracksMutex);
+    tracks.push_back(std::make_unique<TraceTrack>());
+    TraceTrack* track = tracks.back().get();
+    track->id = tracks.size();
+    track->name = name;
+    track->gpu = gpu;
+    return track;
+}
+
+static void addEvent(TraceTrack* track,const char* name,int64_t begin,int64_t end)
+{
+    std::lock_guard<std::mutex> lock(track->mutex);
+    if(track->events.size()>=TRACE_MAX_EVENTS_PER_TRACK){
+        ++track->dropped;
+        return;
+    }
+    track->events.push_back({name,begin,end});
+}
+
+//names are literals,but a quote or backslash would still break the file
+static void writeString(std::ofstream& file,const char* string)
+{
+    file<<'"';
+    for(const char* c=string;*c;++c){
+        if(*c=='"'||*c=='\\'){
+            file<<'\\';
+        }
+        file<<*c;
+    }
+    file<<'"';
+}
+
+void Tracer::start()
+{
+    std::lock_guard<std::mutex> lock(tracksMutex);
+    for(auto& track:tracks){
+        std::lock_guard<std::mutex> trackLock(track->mutex);
+        track->events.clear();
+        track->dropped = 0;
+    }
+    traceStart = now();
+    active.store(true);
+}
+
+bool Tracer::stop(const char* path)
+{
+    active.store(false);
+    std::ofstream file(path);
+    if(!file.is_open()){
+        return false;
+    }
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    file<<"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(tracksMutex);
+    for(auto& track:tracks){
+        std::lock_guard<std::mutex> trackLock(track->mutex);
+        //GPU queues sort after the threads
+        file<<(first?"":",\n")<<"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"<<track->id<<",\"args\":{\"name\":";
+        writeString(file,track->name?track->name:"thread");
+        file<<"}},\n{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":1,\"tid\":"<<track->id
+        <<",\"args\":{\"sort_index\":"<<(track->gpu?1000+track->id:track->id)<<"}}";
+        first = false;
+        for(auto& event:track->events){
+            file<<",\n{\"ph\":\"X\",\"cat\":\""<<(track->gpu?"gpu":"cpu")<<"\",\"pid\":1,\"tid\":"<<track->id<<",\"name\":";
+            writeString(file,event.name);
+            file<<",\"ts\":"<<(event.begin-traceStart)/1000.0<<",\"dur\":"<<(event.end-event.begin)/1000.0<<"}";
+        }
+        if(track->dropped){
+            file<<",\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":"<<track->id<<",\"name\":\"dropped "<<track->dropped<<" events\",\"ts\":0}";
+        }
+    }
+    file<<"\n]}\n";
+    return file.good();
+}
+
+void Tracer::setThreadName(const char* name)
+{
+    threadName = name;
+    if(threadTrack){
+        std::lock_guard<std::mutex> lock(threadTrack->mutex);
+        threadTrack->name = name;
+    }
+}
+
+void Tracer::zone(const char* name,int64_t begin,int64_t end)
+{
+    if(!threadTrack){
+        threadTrack = createTrack(threadName,false);
+    }
+    addEvent(threadTrack,name,begin,end);
+}
+
+uint32_t Tracer::getTrack(const char* name)
+{
+    {
+        std::lock_guard<std::mutex> lock(tracksMutex);
+        for(auto& track:tracks){
+            if(track->gpu&&std::strcmp(track->name,name)==0){
+                return track->id;
+            }
+        }
+    }
+    return createTrack(name,true)->id;
+}
+
+void Tracer::trackZone(uint32_t track,const char* name,int64_t begin,int64_t end)
+{
+    TraceTrack* target;
+    {
+        std::lock_guard<std::mutex> lock(tracksMutex);
+        target = tracks[track-1].get();
+    }
+    addEvent(target,name,begin,end);
+}
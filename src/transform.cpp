@@ -0,0 +1,158 @@
+#include"transform.h"
+#include"threadpool.h"
+#include"simdmath.h"
+
+#include<stdexcept>
+#include<algorithm>
+namespace vkglTF{
+
+//levels smaller than this are not worth waking the workers for
+#define TRANSFORM_GRAIN_SIZE 1024
+
+uint32_t TransformHierarchy::addNode(int parent,const glm::vec3 &translation,const glm::quat &rotation,const glm::vec3 &scale)
+{
+    uint32_t index = parents.size();
+    if(parent>=(int)index){
+        throw std::runtime_error("transform parent must be added before its children!");
+    }
+    parents.push_back(parent);
+    translations.push_back(translation);
+    rotations.push_back(rotation);
+    scales.push_back(scale);
+    locals.push_back(glm::mat4(1.0f));
+    globals.push_back(glm::mat4(1.0f));
+    flags.push_back(eLocalDirty);
+    return index;
+}
+
+uint32_t TransformHierarchy::addNode(int parent,const glm::mat4 &matrix)
+{
+    uint32_t index = addNode(parent,glm::vec3(0.0f),glm::quat(1,0,0,0),glm::vec3(1.0f));
+    locals[index] = matrix;
+    flags[index] = eLocalDirty|eUseMatrix;
+    return index;
+}
+
+std::vector<uint32_t> TransformHierarchy::finalize()
+{
+    uint32_t count = size();
+    std::vector<uint32_t> depths(count);
+    uint32_t maxDepth = 0;
+    for(uint32_t i=0;i<count;++i){
+        depths[i] = parents[i]<0?0:depths[parents[i]]+1;
+        maxDepth = std::max(maxDepth,depths[i]);
+    }
+    //counting sort by depth keeps siblings next to each other
+    levelOffsets.assign(count?maxDepth+2:1,0);
+    for(uint32_t i=0;i<count;++i){
+        ++levelOffsets[depths[i]+1];
+    }
+    for(uint32_t level=1;level<levelOffsets.size();++level){
+        levelOffsets[level] += levelOffsets[level-1];
+    }
+    std::vector<uint32_t> remap(count);
+    std::vector<uint32_t> cursors(levelOffsets.begin(),levelOffsets.end()-1);
+    for(uint32_t i=0;i<count;++i){
+        remap[i] = cursors[depths[i]]++;
+    }
+
+    std::vector<int> newParents(count);
+    std::vector<glm::vec3> newTranslations(count);
+    std::vector<glm::quat> newRotations(count);
+    std::vector<glm::vec3> newScales(count);
+    std::vector<glm::mat4> newLocals(count);
+    std::vector<uint8_t> newFlags(count);
+    for(uint32_t i=0;i<count;++i){
+        uint32_t dst = remap[i];
+        newParents[dst] = parents[i]<0?-1:(int)remap[parents[i]];
+        newTranslations[dst] = translations[i];
+        newRotations[dst] = rotations[i];
+        newScales[dst] = scales[i];
+        newLocals[dst] = locals[i];
+        newFlags[dst] = flags[i]|eLocalDirty;
+    }
+    parents.swap(newParents);
+    translations.swap(newTranslations);
+    rotations.swap(newRotations);
+    scales.swap(newScales);
+    locals.swap(newLocals);
+    flags.swap(newFlags);
+    globals.assign(count,glm::mat4(1.0f));
+    return remap;
+}
+
+void TransformHierarchy::clear()
+{
+    parents.clear();
+    translations.clear();
+    rotations.clear();
+    scales.clear();
+    locals.clear();
+    globals.clear();
+    flags.clear();
+    levelOffsets.clear();
+}
+
+void TransformHierarchy::update(ThreadPool *pool)
+{
+    if(levelOffsets.empty()&&size()){
+        throw std::runtime_error("transform hierarchy is not finalized!");
+    }
+    for(uint32_t level=0;level<levelCount();++level){
+        uint32_t begin = levelOffsets[level];
+        uint32_t end = levelOffsets[level+1];
+        if(pool&&end-begin>TRANSFORM_GRAIN_SIZE){
+            pool->parallelFor(end-begin,TRANSFORM_GRAIN_SIZE,[&](uint32_t b,uint32_t e){
+                updateRange(begin+b,begin+e);
+            });
+        }
+        else{
+            updateRange(begin,end);
+        }
+    }
+}
+
+void TransformHierarchy::updateRange(uint32_t begin,uint32_t end)
+{
+    for(uint32_t i=begin;i<end;++i){
+        uint8_t flag = flags[i];
+        bool dirty = flag&eLocalDirty;
+        if(dirty&&!(flag&eUseMatrix)){
+            simd::composeTRS(glm::value_ptr(translations[i]),&rotations[i].x,glm::value_ptr(scales[i]),glm::value_ptr(locals[i]));
+        }
+        int parent = parents[i];
+        bool parentChanged = parent>=0&&(flags[parent]&eGlobalChanged);
+        if(dirty||parentChanged){
+            if(parent>=0){
+                simd::mulMat4(glm::value_ptr(globals[parent]),glm::value_ptr(locals[i]),glm::value_ptr(globals[i]));
+            }
+            else{
+                globals[i] = locals[i];
+            }
+            flag |= eGlobalChanged;
+        }
+        else{
+            flag &= ~eGlobalChanged;
+        }
+        flags[i] = flag&~eLocalDirty;
+    }
+}
+
+void TransformHierarchy::setTranslation(uint32_t node,const glm::vec3 &translation)
+{
+    translations[node] = translation;
+    flags[node] = (flags[node]|eLocalDirty)&~eUseMatrix;
+}
+
+void TransformHierarchy::setRotation(uint32_t node,const glm::quat &rotation)
+{
+    rotations[node] = rotation;
+    flags[node] = (flags[node]|eLocalDirty)&~eUseMatrix;
+}
+
+void TransformHierarchy::setScale(uint32_t node,const glm::vec3 &scale)
+{
+    scales[node] = scale;
+    flags[node] = (flags[node]|eLocalDirty)&~eUseMatrix;
+}
+}
@@ -6,62 +6,196 @@
 #include"tiny_gltf.h"
 
 #include"renderer.h"
+#include"simdmath.h"
+#include"trace.h"
+#include"glm/gtc/packing.hpp"
 
 #include<iostream>
 #include<string>
+#include<chrono>
+#include<algorithm>
 
 #define MAX_MATERIAL_COUNT 128
 namespace vkglTF{
 
-Scene::Scene(Renderer* renderer):renderer(renderer)
+//read one component of a float or normalized integer accessor element
+static float readComponent(const unsigned char* element,int componentType,int c)
+{
+    switch(componentType){
+        case TINYGLTF_COMPONENT_TYPE_FLOAT:
+            return reinterpret_cast<const float*>(element)[c];
+        case TINYGLTF_COMPONENT_TYPE_BYTE:
+            return std::max(reinterpret_cast<const int8_t*>(element)[c]/127.0f,-1.0f);
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            return reinterpret_cast<const uint8_t*>(element)[c]/255.0f;
+        case TINYGLTF_COMPONENT_TYPE_SHORT:
+            return std::max(reinterpret_cast<const int16_t*>(element)[c]/32767.0f,-1.0f);
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+            return reinterpret_cast<const uint16_t*>(element)[c]/65535.0f;
+        default:
+            throw std::runtime_error("bad accessor component type!");
+    }
+}
+
+//append the accessor's elements to out,each padded with zeros to stride floats.
+//accessors without a bufferView start as zeros,sparse elements are applied on top
+static void readAccessorFloats(glTF::Model& glTFmodel,int accessorIndex,uint32_t stride,std::vector<float>& out)
+{
+    glTF::Accessor& glTFaccessor = glTFmodel.accessors[accessorIndex];
+    int components = tinygltf::GetNumComponentsInType(glTFaccessor.type);
+    int elementSize = tinygltf::GetComponentSizeInBytes(glTFaccessor.componentType)*components;
+    size_t base = out.size();
+    out.resize(base+glTFaccessor.count*stride,0.0f);
+    if(glTFaccessor.bufferView>-1){
+        glTF::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
+        glTF::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
+        int byteStride = glTFaccessor.ByteStride(glTFbufferView);
+        int byteOffset = glTFaccessor.byteOffset + glTFbufferView.byteOffset;
+        for(size_t i=0;i<glTFaccessor.count;++i){
+            unsigned char* element = glTFbuffer.data.data()+byteOffset+byteStride*i;
+            for(int c=0;c<components;++c){
+                out[base+i*stride+c] = readComponent(element,glTFaccessor.componentType,c);
+            }
+        }
+    }
+    if(glTFaccessor.sparse.isSparse){
+        auto& sparse = glTFaccessor.sparse;
+        glTF::BufferView& indexView = glTFmodel.bufferViews[sparse.indices.bufferView];
+        glTF::BufferView& valueView = glTFmodel.bufferViews[sparse.values.bufferView];
+        unsigned char* indices = glTFmodel.buffers[indexView.buffer].data.data()+indexView.byteOffset+sparse.indices.byteOffset;
+        unsigned char* values = glTFmodel.buffers[valueView.buffer].data.data()+valueView.byteOffset+sparse.values.byteOffset;
+        for(int i=0;i<sparse.count;++i){
+            uint32_t index;
+            switch(sparse.indices.componentType){
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                    index = indices[i];
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+                    index = reinterpret_cast<uint16_t*>(indices)[i];
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+                    index = reinterpret_cast<uint32_t*>(indices)[i];
+                    break;
+                default:
+                    throw std::runtime_error("bad sparse index type!");
+            }
+            if(index>=glTFaccessor.count){
+                throw std::runtime_error("sparse index out of range!");
+            }
+            //sparse values are tightly packed
+            for(int c=0;c<components;++c){
+                out[base+index*stride+c] = readComponent(values+i*elementSize,glTFaccessor.componentType,c);
+            }
+        }
+    }
+}
+
+//meshes and primitives the subtree at node creates,so each can be placed in one contiguous array
+static void countMeshes(glTF::Model& glTFmodel,int node,uint32_t& meshCount,uint32_t& primitiveCount)
+{
+    glTF::Node& glTFnode = glTFmodel.nodes[node];
+    if(glTFnode.mesh>-1){
+        meshCount++;
+        primitiveCount += glTFmodel.meshes[glTFnode.mesh].primitives.size();
+    }
+    for(int child:glTFnode.children){
+        countMeshes(glTFmodel,child,meshCount,primitiveCount);
+    }
+}
+
+//milliseconds since start,start is moved to now
+//stage names a zone ending now in the trace
+static double lap(std::chrono::high_resolution_clock::time_point& start,const char* stage)
+{
+    auto now = std::chrono::high_resolution_clock::now();
+    double ms = std::chrono::duration<double,std::milli>(now-start).count();
+    start = now;
+    if(Tracer::enabled()){
+        int64_t end = Tracer::now();
+        Tracer::zone(stage,end-int64_t(ms*1000000.0),end);
+    }
+    return ms;
+}
+
+Scene::Scene(Renderer* renderer,Residency residency):residency(residency),renderer(renderer)
 {
     
 }
 
 Scene::~Scene()
 {
-    for(int i=0;i<materials.size();++i){
-        renderer->lDevice.destroyBuffer(materials[i]->uniformMaterialBuffer);
-        renderer->lDevice.freeMemory(materials[i]->uniformMaterialBufferMemory);
-        delete materials[i];
+    for(auto& material:materials){
+        renderer->destroyBuffer(material.uniformMaterialBuffer,material.uniformMaterialBufferMemory);
     }
-    for(int i=0;i<textures.size();++i){
-        renderer->lDevice.destroyImageView(textures[i]->textureImageView);
-        renderer->lDevice.destroyImage(textures[i]->textureImage);
-        renderer->lDevice.destroySampler(textures[i]->imageSampler);
-        renderer->lDevice.freeMemory(textures[i]->imageMemory);
-        delete textures[i];
-    }
-    for(int i=0;i<rtNodes.size();++i){
-        delete rtNodes[i];
+    for(auto& texture:textures){
+        renderer->lDevice.destroyImageView(texture.textureImageView);
+        renderer->destroyImage(texture.textureImage,texture.imageMemory);
+        renderer->lDevice.destroySampler(texture.imageSampler);
     }
+    textures.clear();
+    materials.clear();
+    meshes.clear();
+    nodes.clear();
+    nodeChildren.clear();
+    primitives.clear();
+    rtNodes.clear();
+    arena.reset();
     cleanup();
 }
 void Scene::cleanup(){
     if(loaded){
-        renderer->lDevice.destroyBuffer(vertexBuffer);
-        renderer->lDevice.freeMemory(vertexBufferMemory);
-        renderer->lDevice.destroyBuffer(indexBuffer);
-        renderer->lDevice.freeMemory(indexBufferMemory);
-        renderer->lDevice.destroyBuffer(modelMatsBuffer);
-        renderer->lDevice.freeMemory(modelMatsBufferMemory);
+        renderer->destroyBuffer(vertexBuffer,vertexBufferMemory);
+        renderer->destroyBuffer(indexBuffer,indexBufferMemory);
+        if(drawInstanceCount){
+            renderer->destroyBuffer(drawInstanceBuffer,drawInstanceBufferMemory);
+        }
+        if(deformVertexCount){
+            renderer->destroyBuffer(deformVertexBuffer,deformVertexBufferMemory);
+            renderer->destroyBuffer(morphDeltaBuffer,morphDeltaBufferMemory);
+        }
+        renderer->destroyBuffer(modelMatsBuffer,modelMatsBufferMemory);
+        renderer->destroyBuffer(defaultMaterialBuffer,defaultMaterialBufferMemory);
+        //the pool outlives scenes,so another scene can be loaded into the same renderer
+        std::array<vk::DescriptorSet,2> sets = {materialDescriptorSet,modelMatsDescriptorSet};
+        renderer->lDevice.freeDescriptorSets(renderer->descriptorPool,sets);
         renderer->lDevice.destroyDescriptorSetLayout(materialDescriptorSetLayout);
         renderer->lDevice.destroyDescriptorSetLayout(modelMatsDescriptorSetLayout);
     }
 }
 void Scene::loadFile(const char *path)
 {
+    readFile(path);
+    upload();
+}
+void Scene::readFile(const char *path)
+{
+    TraceScope scope("readFile");
     if(loaded){
         throw std::runtime_error("scene is already loaded!");
     }
-    loaded = true;
-    tinygltf::TinyGLTF loader;
-    std::string err;
-    std::string warn;
-    bool result = loader.LoadASCIIFromFile(&glTFmodel,&err,&warn,path);
-    if(!result){
-        throw std::runtime_error("failed to load glTF!");
+    loadStats = LoadStats();
+    auto stageStart = std::chrono::high_resolution_clock::now();
+    loadStats.jsonBytes = parseglTFFile(path,glTFmodel);
+    loadStats.parse = lap(stageStart,"parse");
+    loadglTFBuffers(path,glTFmodel);
+    for(auto& glTFbuffer:glTFmodel.buffers){
+        loadStats.bufferBytes += glTFbuffer.data.size();
+    }
+    loadStats.buffers = lap(stageStart,"read buffers");
+    decodeglTFImages(path,glTFmodel);
+    for(auto& glTFimage:glTFmodel.images){
+        loadStats.imageBytes += glTFimage.image.size();
+    }
+    loadStats.imageDecode = lap(stageStart,"decode images");
+}
+void Scene::upload()
+{
+    if(loaded){
+        throw std::runtime_error("scene is already loaded!");
     }
+    loaded = true;
+    auto uploadStart = std::chrono::high_resolution_clock::now();
+    auto stageStart = uploadStart;
     //a descriptorSet describe all materials:
     {
         std::array<vk::DescriptorSetLayoutBinding,6> bindings;
@@ -92,26 +226,118 @@ void Scene::loadFile(const char *path)
         allocateInfo.setDescriptorSetCount(1);
         allocateInfo.setSetLayouts(materialDescriptorSetLayout);
         materialDescriptorSet = renderer->lDevice.allocateDescriptorSets(allocateInfo)[0];
+
+        //glTF's defaults,without textures
+        MaterialProperties defaultProperties;
+        defaultProperties.basColorFactor = glm::vec4(1.0f);
+        defaultProperties.metallicFactor = 1.0f;
+        defaultProperties.roughnessFactor = 1.0f;
+        renderer->createDeviceLocalBuffer(defaultMaterialBuffer,defaultMaterialBufferMemory,&defaultProperties,sizeof(MaterialProperties),
+        vk::BufferUsageFlagBits::eUniformBuffer);
     }
 
+    textures.reserve(glTFmodel.textures.size());
+    glTFTextures.resize(glTFmodel.textures.size());
+    loadStats.materials = lap(stageStart,"material descriptors");
     for(int i=0;i<glTFmodel.textures.size();++i){
-        Texture* texture = loadTexture(glTFmodel.textures[i],i);
-        textures.push_back(texture);
+        loadTexture(glTFmodel.textures[i],i);
     }
+    loadStats.textures = lap(stageStart,"upload textures");
+    if(residency==Residency::eGpuOnly){
+        //every texture is uploaded,drop the decoded pixels before the geometry is built
+        for(auto& glTFimage:glTFmodel.images){
+            std::vector<unsigned char>().swap(glTFimage.image);
+        }
+    }
+    materials.reserve(glTFmodel.materials.size());
+    glTFMaterials.resize(glTFmodel.materials.size());
     for(int i=0;i<glTFmodel.materials.size();++i){
-        Material* material = loadMaterial(glTFmodel.materials[i],i);
-        materials.push_back(material);
+        loadMaterial(glTFmodel.materials[i],i);
+    }
+    loadStats.materials += lap(stageStart,"materials");
+    skins.resize(glTFmodel.skins.size());
+    for(int i=0;i<glTFmodel.skins.size();++i){
+        loadSkin(glTFmodel.skins[i],skins[i]);
+    }
+    loadStats.animations = lap(stageStart,"skins");
+    nodeTransforms.assign(glTFmodel.nodes.size(),-1);
+    nodeMorphs.assign(glTFmodel.nodes.size(),{});
+    {
+        uint32_t meshCount = 0;
+        uint32_t primitiveCount = 0;
+        uint32_t childCount = 0;
+        for(int node:glTFmodel.scenes[glTFmodel.defaultScene].nodes){
+            countMeshes(glTFmodel,node,meshCount,primitiveCount);
+        }
+        for(auto& glTFnode:glTFmodel.nodes){
+            childCount += glTFnode.children.size();
+        }
+        nodes.allocate(arena,glTFmodel.nodes.size());
+        nodeChildren.reserve(arena,childCount);
+        meshes.reserve(meshCount);
+        primitives.reserve(arena,primitiveCount);
     }
     for(int node:glTFmodel.scenes[glTFmodel.defaultScene].nodes){
-        Node* rtNode = loadNode(glTFmodel.nodes[node],nullptr);
-        rtNodes.push_back(rtNode);
+        loadNode(glTFmodel.nodes[node],node,-1);
+        rtNodes.push_back(node);
+    }
+    //from here on transforms are stored level by level
+    {
+        std::vector<uint32_t> remap = transforms.finalize();
+        for(auto& modelMatNode:modelMatNodes){
+            modelMatNode = remap[modelMatNode];
+        }
+        for(auto& skinInstance:skinInstances){
+            skinInstance.meshTransform = remap[skinInstance.meshTransform];
+        }
+        for(int i=0;i<nodeTransforms.size();++i){
+            if(nodeTransforms[i]>-1){
+                nodeTransforms[i] = remap[nodeTransforms[i]];
+                nodes[i].transformIndex = nodeTransforms[i];
+            }
+        }
+        updateTransforms();
     }
+    //rest pose bounds,from the corners of every primitive's box
+    {
+        boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+        for(auto& mesh:meshes){
+            if(mesh.modelMatID<0){
+                continue;
+            }
+            glm::mat4& model = modelMats[mesh.modelMatID].model;
+            for(uint32_t p=0;p<mesh.primitiveCount;++p){
+                Primitive& primitive = primitives[mesh.firstPrimitive+p];
+                for(int corner=0;corner<8;++corner){
+                    glm::vec3 local(corner&1?primitive.boundsMax.x:primitive.boundsMin.x,
+                    corner&2?primitive.boundsMax.y:primitive.boundsMin.y,
+                    corner&4?primitive.boundsMax.z:primitive.boundsMin.z);
+                    glm::vec3 world = model*glm::vec4(local,1.0f);
+                    boundsMin = glm::min(boundsMin,world);
+                    boundsMax = glm::max(boundsMax,world);
+                }
+            }
+        }
+        if(boundsMin.x>boundsMax.x){
+            boundsMin = boundsMax = glm::vec3(0.0f);
+        }
+    }
+    loadStats.nodes = lap(stageStart,"nodes");
+    animations.resize(glTFmodel.animations.size());
+    for(int i=0;i<glTFmodel.animations.size();++i){
+        loadAnimation(glTFmodel.animations[i],animations[i]);
+    }
+    if(animations.size()){
+        activeAnimation = 0;
+    }
+    loadStats.animations += lap(stageStart,"animations");
     //build modelMat descriptorSet
     {
         vk::DescriptorSetLayoutBinding binding;
         binding.setBinding(0);
         binding.setDescriptorCount(1);
-        binding.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+        binding.setDescriptorType(vk::DescriptorType::eStorageBufferDynamic);
         binding.setStageFlags(vk::ShaderStageFlagBits::eVertex);
         vk::DescriptorSetLayoutCreateInfo createInfo;
         createInfo.setBindings(binding);
@@ -121,26 +347,19 @@ void Scene::loadFile(const char *path)
         allocateInfo.setDescriptorSetCount(1);
         allocateInfo.setSetLayouts(modelMatsDescriptorSetLayout);
         modelMatsDescriptorSet = renderer->lDevice.allocateDescriptorSets(allocateInfo)[0];
+        //one copy per frame in flight,selected with a dynamic offset
         int size = modelMats.size()*sizeof(ModelMatrix);
-        renderer->createBuffer(modelMatsBuffer,modelMatsBufferMemory,size,
-        vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eTransferDst,vk::MemoryPropertyFlagBits::eDeviceLocal);
-        vk::Buffer stagingBuffer;
-        vk::DeviceMemory stagingMemory;
-        renderer->createBuffer(stagingBuffer,stagingMemory,size,
-        vk::BufferUsageFlagBits::eTransferSrc,vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
-        void* data = renderer->lDevice.mapMemory(stagingMemory,0,size);
-        memcpy(data,modelMats.data(),size);
-        vk::CommandBuffer cb = renderer->startOneShotCommandBuffer(renderer->graphicCommandPool);
-        vk::BufferCopy region;
-        region.setSize(size);
-        region.setSrcOffset(0);
-        region.setDstOffset(0);
-        cb.copyBuffer(stagingBuffer,modelMatsBuffer,region);
-        renderer->finishOneShotCommandBuffer(renderer->graphicCommandPool,cb,renderer->graphicQueue);
-        renderer->lDevice.waitIdle();
-        renderer->lDevice.unmapMemory(stagingMemory);
-        renderer->lDevice.destroyBuffer(stagingBuffer);
-        renderer->lDevice.freeMemory(stagingMemory);
+        vk::DeviceSize alignment = renderer->pDevice.getProperties().limits.minStorageBufferOffsetAlignment;
+        modelMatsCopyCount = renderer->framesInFlight;
+        modelMatsStride = (size+alignment-1)/alignment*alignment;
+        renderer->createBuffer(modelMatsBuffer,modelMatsBufferMemory,modelMatsStride*modelMatsCopyCount,
+        vk::BufferUsageFlagBits::eStorageBuffer,vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
+        modelMatsMapped = reinterpret_cast<ModelMatrix*>(modelMatsBufferMemory.mapped);
+        for(uint32_t copy=0;copy<modelMatsCopyCount;++copy){
+            memcpy((char*)modelMatsMapped+copy*modelMatsStride,modelMats.data(),size);
+        }
+        changedModelMats.clear();
+        staleModelMats.assign(modelMatsCopyCount,{});
 
         vk::DescriptorBufferInfo bufferInfo;
         bufferInfo.setBuffer(modelMatsBuffer);
@@ -149,7 +368,7 @@ void Scene::loadFile(const char *path)
         vk::WriteDescriptorSet write;
         write.setBufferInfo(bufferInfo);
         write.setDescriptorCount(1);
-        write.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+        write.setDescriptorType(vk::DescriptorType::eStorageBufferDynamic);
         write.setDstArrayElement(0);
         write.setDstBinding(0);
         write.setDstSet(modelMatsDescriptorSet);
@@ -158,127 +377,396 @@ void Scene::loadFile(const char *path)
     //build vertex buffer
     {
         int size = vertices.size()*sizeof(Vertex);
-        renderer->createBuffer(vertexBuffer,vertexBufferMemory,size,
-        vk::BufferUsageFlagBits::eVertexBuffer|vk::BufferUsageFlagBits::eTransferDst,vk::MemoryPropertyFlagBits::eDeviceLocal);
-        vk::Buffer stagingBuffer;
-        vk::DeviceMemory stagingMemory;
-        renderer->createBuffer(stagingBuffer,stagingMemory,size,
-        vk::BufferUsageFlagBits::eTransferSrc,vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
-        void* data = renderer->lDevice.mapMemory(stagingMemory,0,size);
-        memcpy(data,vertices.data(),size);
-        vk::CommandBuffer cb = renderer->startOneShotCommandBuffer(renderer->graphicCommandPool);
-        vk::BufferCopy region;
-        region.setSize(size);
-        region.setSrcOffset(0);
-        region.setDstOffset(0);
-        cb.copyBuffer(stagingBuffer,vertexBuffer,region);
-        renderer->finishOneShotCommandBuffer(renderer->graphicCommandPool,cb,renderer->graphicQueue);
-        renderer->lDevice.waitIdle();
-        renderer->lDevice.unmapMemory(stagingMemory);
-        renderer->lDevice.destroyBuffer(stagingBuffer);
-        renderer->lDevice.freeMemory(stagingMemory);
+        renderer->createDeviceLocalBuffer(vertexBuffer,vertexBufferMemory,vertices.data(),size,
+        vk::BufferUsageFlagBits::eVertexBuffer|vk::BufferUsageFlagBits::eStorageBuffer|vk::BufferUsageFlagBits::eTransferSrc);
     }
     //build index buffer
     {
         int size = indexs.size()*sizeof(uint32_t);
-        renderer->createBuffer(indexBuffer,indexBufferMemory,size,
-        vk::BufferUsageFlagBits::eIndexBuffer|vk::BufferUsageFlagBits::eTransferDst,vk::MemoryPropertyFlagBits::eDeviceLocal);
-        vk::Buffer stagingBuffer;
-        vk::DeviceMemory stagingMemory;
-        renderer->createBuffer(stagingBuffer,stagingMemory,size,
-        vk::BufferUsageFlagBits::eTransferSrc,vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
-        void* data = renderer->lDevice.mapMemory(stagingMemory,0,size);
-        memcpy(data,indexs.data(),size);
-        vk::CommandBuffer cb = renderer->startOneShotCommandBuffer(renderer->graphicCommandPool);
-        vk::BufferCopy region;
-        region.setSize(size);
-        region.setSrcOffset(0);
-        region.setDstOffset(0);
-        cb.copyBuffer(stagingBuffer,indexBuffer,region);
-        renderer->finishOneShotCommandBuffer(renderer->graphicCommandPool,cb,renderer->graphicQueue);
-        renderer->lDevice.waitIdle();
-        renderer->lDevice.unmapMemory(stagingMemory);
-        renderer->lDevice.destroyBuffer(stagingBuffer);
-        renderer->lDevice.freeMemory(stagingMemory);
-    }
-    vertices;
-    indexs;
+        renderer->createDeviceLocalBuffer(indexBuffer,indexBufferMemory,indexs.data(),size,vk::BufferUsageFlagBits::eIndexBuffer);
+    }
+    //build deform source buffers
+    if(deformVertices.size()){
+        int size = deformVertices.size()*sizeof(DeformVertex);
+        renderer->createDeviceLocalBuffer(deformVertexBuffer,deformVertexBufferMemory,deformVertices.data(),size,vk::BufferUsageFlagBits::eStorageBuffer);
+        //skinned only scenes have no deltas,the buffer still has to exist for the descriptor
+        if(morphDeltas.empty()){
+            morphDeltas.push_back({});
+        }
+        size = morphDeltas.size()*sizeof(MorphDelta);
+        renderer->createDeviceLocalBuffer(morphDeltaBuffer,morphDeltaBufferMemory,morphDeltas.data(),size,vk::BufferUsageFlagBits::eStorageBuffer);
+        updateJointMatrices();
+    }
+    //build draw instance buffer
+    buildDrawBuckets();
+    if(drawInstances.size()){
+        int size = drawInstances.size()*sizeof(DrawInstance);
+        renderer->createDeviceLocalBuffer(drawInstanceBuffer,drawInstanceBufferMemory,drawInstances.data(),size,vk::BufferUsageFlagBits::eStorageBuffer);
+    }
+    vertexCount = vertices.size();
+    indexCount = indexs.size();
+    drawInstanceCount = drawInstances.size();
+    deformVertexCount = deformVertices.size();
+    morphDeltaCount = morphDeltas.size();
+    loadStats.uploadBytes = vertexCount*sizeof(Vertex)+indexCount*sizeof(uint32_t)+modelMats.size()*sizeof(ModelMatrix)
+    +drawInstanceCount*sizeof(DrawInstance)
+    +(deformVertexCount?deformVertexCount*sizeof(DeformVertex)+morphDeltaCount*sizeof(MorphDelta):0);
+    loadStats.bufferUploads = lap(stageStart,"upload buffers");
+    //createDeviceLocalBuffer waits for its copy,so the GPU buffers are complete and the CPU copies can go
+    if(residency==Residency::eGpuOnly){
+        std::vector<Vertex>().swap(vertices);
+        std::vector<uint32_t>().swap(indexs);
+        std::vector<DeformVertex>().swap(deformVertices);
+        std::vector<MorphDelta>().swap(morphDeltas);
+        std::vector<DrawInstance>().swap(drawInstances);
+        glTFmodel = glTF::Model();
+    }
+    loadStats.total = loadStats.parse+loadStats.buffers+loadStats.imageDecode+lap(uploadStart,"upload");
+}
+
+bool Scene::updateTransforms(ThreadPool *pool)
+{
+    transforms.update(pool);
+    bool changed = false;
+    for(int i=0;i<modelMats.size();++i){
+        if(transforms.globalChanged(modelMatNodes[i])){
+            modelMats[i].model = transforms.getGlobal(modelMatNodes[i]);
+            changedModelMats.push_back(i);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool Scene::updateAnimations(float deltaTime,ThreadPool *pool)
+{
+    if(activeAnimation<0||!animationPlaying){
+        return false;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    animationTime += deltaTime;
+    animations[activeAnimation].evaluate(animationTime,transforms,morphWeights,pool);
+    updateTransforms(pool);
+    if(skinInstances.size()){
+        updateJointMatrices();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    animationUpdateTime = std::chrono::duration<float,std::milli>(end-start).count();
+    return true;
+}
+
+void Scene::flushModelMats(uint32_t copy)
+{
+    //the other copies get these matrices when their frames come around
+    for(uint32_t other=0;other<modelMatsCopyCount;++other){
+        if(other!=copy){
+            staleModelMats[other].insert(staleModelMats[other].end(),changedModelMats.begin(),changedModelMats.end());
+        }
+    }
+    ModelMatrix* mapped = reinterpret_cast<ModelMatrix*>((char*)modelMatsMapped+copy*modelMatsStride);
+    for(uint32_t i:staleModelMats[copy]){
+        mapped[i] = modelMats[i];
+    }
+    for(uint32_t i:changedModelMats){
+        mapped[i] = modelMats[i];
+    }
+    staleModelMats[copy].clear();
+    changedModelMats.clear();
+}
+
+void Scene::updateJointMatrices()
+{
+    for(auto& skinInstance:skinInstances){
+        Skin& skin = skins[skinInstance.skin];
+        //skinned positions end up in the mesh node's space,the vertex shader still applies its modelMat
+        glm::mat4 inverseMesh = glm::inverse(transforms.getGlobal(skinInstance.meshTransform));
+        for(int i=0;i<skin.joints.size();++i){
+            glm::mat4& jointMatrix = jointMatrices[skinInstance.jointOffset+i];
+            int joint = nodeTransforms[skin.joints[i]];
+            if(joint<0){
+                jointMatrix = glm::mat4(1.0f);
+                continue;
+            }
+            glm::mat4 jointBind;
+            simd::mulMat4(glm::value_ptr(transforms.getGlobal(joint)),glm::value_ptr(skin.inverseBindMatrices[i]),glm::value_ptr(jointBind));
+            simd::mulMat4(glm::value_ptr(inverseMesh),glm::value_ptr(jointBind),glm::value_ptr(jointMatrix));
+        }
+    }
+}
+
+void Scene::releaseTexture(TextureHandle texture)
+{
+    std::lock_guard<std::mutex> lock(releaseMutex);
+    pendingTextureReleases.push_back(texture);
+}
+
+void Scene::releaseMaterial(MaterialHandle material)
+{
+    std::lock_guard<std::mutex> lock(releaseMutex);
+    pendingMaterialReleases.push_back(material);
 }
 
-Node* Scene::loadNode(tinygltf::Node &glTFnode,Node* parent)
+bool Scene::hasPendingReleases()
 {
-    Node* newNode = new Node();
-    newNode->parent = parent;
+    std::lock_guard<std::mutex> lock(releaseMutex);
+    return pendingTextureReleases.size()||pendingMaterialReleases.size();
+}
+
+void Scene::processReleases()
+{
+    std::vector<TextureHandle> textureReleases;
+    std::vector<MaterialHandle> materialReleases;
+    {
+        std::lock_guard<std::mutex> lock(releaseMutex);
+        textureReleases.swap(pendingTextureReleases);
+        materialReleases.swap(pendingMaterialReleases);
+    }
+    for(MaterialHandle handle:materialReleases){
+        Material* material = materials.get(handle);
+        if(!material){
+            continue;
+        }
+        //vertices still carry the slot,so it keeps a valid uniform buffer
+        vk::DescriptorBufferInfo bufferInfo(defaultMaterialBuffer,0,sizeof(MaterialProperties));
+        vk::WriteDescriptorSet write;
+        write.setBufferInfo(bufferInfo);
+        write.setDescriptorCount(1);
+        write.setDescriptorType(vk::DescriptorType::eUniformBuffer);
+        write.setDstBinding(0);
+        write.setDstSet(materialDescriptorSet);
+        write.setDstArrayElement(material->index);
+        renderer->lDevice.updateDescriptorSets(1,&write,0,nullptr);
+        renderer->destroyBuffer(material->uniformMaterialBuffer,material->uniformMaterialBufferMemory);
+        materials.release(handle);
+    }
+    for(TextureHandle handle:textureReleases){
+        Texture* texture = textures.get(handle);
+        if(!texture){
+            continue;
+        }
+        //a texCoord of -1 stops the fragment shader from sampling the texture's descriptor
+        for(auto& material:materials){
+            bool changed = false;
+            std::pair<TextureHandle*,int*> references[] = {
+                {&material.baseColorTexture,&material.properties.texCoord_baseColor},
+                {&material.metallicRoughnessTexture,&material.properties.texCoord_metallicRoughness},
+                {&material.normalTexture,&material.properties.texCoord_normal},
+                {&material.occlusionTexture,&material.properties.texCoord_occlusion},
+                {&material.emissiveTexture,&material.properties.texCoord_emissive},
+            };
+            for(auto [textureHandle,texCoord]:references){
+                if(*textureHandle==handle){
+                    *textureHandle = TextureHandle();
+                    *texCoord = -1;
+                    changed = true;
+                }
+            }
+            if(changed){
+                uploadMaterialProperties(material);
+            }
+        }
+        renderer->lDevice.destroyImageView(texture->textureImageView);
+        renderer->destroyImage(texture->textureImage,texture->imageMemory);
+        renderer->lDevice.destroySampler(texture->imageSampler);
+        textures.release(handle);
+    }
+}
+
+void Scene::loadSkin(glTF::Skin &glTFskin,Skin& skin)
+{
+    skin.joints = glTFskin.joints;
+    skin.inverseBindMatrices.assign(skin.joints.size(),glm::mat4(1.0f));
+    if(glTFskin.inverseBindMatrices>-1){
+        std::vector<float> matrices;
+        readAccessorFloats(glTFmodel,glTFskin.inverseBindMatrices,16,matrices);
+        for(int i=0;i<skin.joints.size()&&i*16<matrices.size();++i){
+            skin.inverseBindMatrices[i] = glm::make_mat4x4(matrices.data()+i*16);
+        }
+    }
+}
+
+void Scene::loadAnimation(glTF::Animation &glTFanimation,Animation& animation)
+{
+    animation.name = glTFanimation.name;
+    animation.start = std::numeric_limits<float>::max();
+    animation.end = std::numeric_limits<float>::lowest();
+    std::vector<int> samplerRemap(glTFanimation.samplers.size(),-1);
+    for(auto& glTFchannel:glTFanimation.channels){
+        AnimationChannel channel;
+        if(glTFchannel.target_path=="translation"){
+            channel.path = AnimationPath::eTranslation;
+        }
+        else if(glTFchannel.target_path=="rotation"){
+            channel.path = AnimationPath::eRotation;
+        }
+        else if(glTFchannel.target_path=="scale"){
+            channel.path = AnimationPath::eScale;
+        }
+        else if(glTFchannel.target_path=="weights"){
+            channel.path = AnimationPath::eWeights;
+        }
+        else{
+            continue;
+        }
+        if(glTFchannel.target_node<0||nodeTransforms[glTFchannel.target_node]<0){
+            continue;
+        }
+        if(channel.path==AnimationPath::eWeights){
+            MorphInstance& morph = nodeMorphs[glTFchannel.target_node];
+            if(morph.weightCount==0){
+                continue;
+            }
+            channel.target = morph.weightOffset;
+            channel.weightCount = morph.weightCount;
+        }
+        else{
+            channel.target = nodeTransforms[glTFchannel.target_node];
+        }
+        //samplers are only loaded once some channel uses them
+        if(samplerRemap[glTFchannel.sampler]<0){
+            glTF::AnimationSampler& glTFsampler = glTFanimation.samplers[glTFchannel.sampler];
+            AnimationSampler sampler;
+            if(glTFsampler.interpolation=="STEP"){
+                sampler.interpolation = Interpolation::eStep;
+            }
+            else if(glTFsampler.interpolation=="CUBICSPLINE"){
+                sampler.interpolation = Interpolation::eCubicSpline;
+            }
+            sampler.isRotation = channel.path==AnimationPath::eRotation;
+            sampler.timeOffset = animation.times.size();
+            readAccessorFloats(glTFmodel,glTFsampler.input,1,animation.times);
+            sampler.keyCount = animation.times.size()-sampler.timeOffset;
+            sampler.valueOffset = animation.values.size();
+            if(channel.path==AnimationPath::eWeights){
+                //the output holds weightCount floats per element,repack them into padded keys
+                sampler.stride = (channel.weightCount+3)&~3u;
+                std::vector<float> weights;
+                readAccessorFloats(glTFmodel,glTFsampler.output,1,weights);
+                size_t elementCount = weights.size()/channel.weightCount;
+                animation.values.resize(animation.values.size()+elementCount*sampler.stride,0.0f);
+                for(size_t i=0;i<elementCount;++i){
+                    std::copy_n(weights.data()+i*channel.weightCount,channel.weightCount,
+                    animation.values.data()+sampler.valueOffset+i*sampler.stride);
+                }
+            }
+            else{
+                readAccessorFloats(glTFmodel,glTFsampler.output,sampler.stride,animation.values);
+            }
+            sampler.resultOffset = animation.samplers.size()?animation.samplers.back().resultOffset+animation.samplers.back().stride:0;
+            if(sampler.keyCount==0){
+                throw std::runtime_error("animation sampler without keyframes!");
+            }
+            animation.start = std::min(animation.start,animation.times[sampler.timeOffset]);
+            animation.end = std::max(animation.end,animation.times.back());
+            samplerRemap[glTFchannel.sampler] = animation.samplers.size();
+            animation.samplers.push_back(sampler);
+        }
+        channel.sampler = samplerRemap[glTFchannel.sampler];
+        animation.channels.push_back(channel);
+    }
+    if(animation.samplers.empty()){
+        animation.start = animation.end = 0;
+    }
+}
+
+void Scene::loadNode(glTF::Node &glTFnode,int index,int parent)
+{
+    Node& newNode = nodes[index];
+    newNode.parent = parent;
+    int parentTransform = parent>-1?(int)nodes[parent].transformIndex:-1;
     if(glTFnode.matrix.size()){
-        newNode->local_transform = glm::make_mat4x4(glTFnode.matrix.data());
+        newNode.transformIndex = transforms.addNode(parentTransform,glm::make_mat4x4(glTFnode.matrix.data()));
     }
     else{
         if(glTFnode.translation.size()){
-            newNode->translation = glm::make_vec3(glTFnode.translation.data());
+            newNode.translation = glm::make_vec3(glTFnode.translation.data());
         }
         if(glTFnode.rotation.size()){
-            newNode->rotation = glm::make_quat(glTFnode.rotation.data());
+            newNode.rotation = glm::make_quat(glTFnode.rotation.data());
         }
         if(glTFnode.scale.size()){
-            newNode->scale = glm::make_vec3(glTFnode.scale.data());
+            newNode.scale = glm::make_vec3(glTFnode.scale.data());
         }
-        glm::mat4 transform = glm::mat4(1.0f);
-        transform = glm::scale(transform,newNode->scale);
-        transform = glm::mat4_cast(newNode->rotation)*transform;
-        transform = glm::translate(transform,newNode->translation);
-        newNode->local_transform = transform;
-    }
-    if(parent){
-        newNode->global_transform = newNode->local_transform*parent->global_transform;
-    }
-    else{
-        newNode->global_transform = newNode->local_transform;
+        newNode.transformIndex = transforms.addNode(parentTransform,newNode.translation,newNode.rotation,newNode.scale);
     }
+    nodeTransforms[index] = newNode.transformIndex;
     if(glTFnode.mesh>-1){
-        newNode->mesh = loadMesh(glTFmodel.meshes[glTFnode.mesh],newNode);
+        glTF::Mesh& glTFmesh = glTFmodel.meshes[glTFnode.mesh];
+        int weightOffset = -1;
+        uint32_t targetCount = 0;
+        for(auto& glTFprimitive:glTFmesh.primitives){
+            targetCount = std::max(targetCount,(uint32_t)glTFprimitive.targets.size());
+        }
+        if(targetCount){
+            //every instance of the mesh gets its own weights,so animations can drive them independently
+            weightOffset = morphWeights.size();
+            nodeMorphs[index] = {(uint32_t)weightOffset,targetCount};
+            const std::vector<double>& defaultWeights = glTFnode.weights.size()?glTFnode.weights:glTFmesh.weights;
+            for(uint32_t i=0;i<targetCount;++i){
+                morphWeights.push_back(i<defaultWeights.size()?(float)defaultWeights[i]:0.0f);
+            }
+        }
+        int jointOffset = -1;
+        if(glTFnode.skin>-1){
+            jointOffset = jointMatrices.size();
+            skinInstances.push_back({glTFnode.skin,newNode.transformIndex,(uint32_t)jointOffset});
+            jointMatrices.resize(jointMatrices.size()+skins[glTFnode.skin].joints.size(),glm::mat4(1.0f));
+        }
+        newNode.mesh = loadMesh(glTFmesh,index,jointOffset,weightOffset);
     }
+    newNode.firstChild = nodeChildren.size();
+    newNode.childCount = glTFnode.children.size();
     for(int node:glTFnode.children){
-        Node* childNode = loadNode(glTFmodel.nodes[node],newNode);
-        newNode->children.push_back(childNode);
+        nodeChildren.push() = node;
+    }
+    for(int node:glTFnode.children){
+        loadNode(glTFmodel.nodes[node],node,index);
     }
-    return newNode;
 }
 
-Mesh* Scene::loadMesh(tinygltf::Mesh &glTFmesh,Node* parent)
+MeshHandle Scene::loadMesh(glTF::Mesh &glTFmesh,int node,int jointOffset,int weightOffset)
 {   
-    Mesh* newMesh = new Mesh();
-    newMesh->parent = parent;
+    MeshHandle meshHandle = meshes.create();
+    Mesh& newMesh = *meshes.get(meshHandle);
+    newMesh.node = node;
+    newMesh.firstPrimitive = primitives.size();
+    newMesh.primitiveCount = glTFmesh.primitives.size();
     if(glTFmesh.primitives.size()){
         //a new modelMat is need
+        //filled by updateTransforms once every node is loaded
         int modelMatID = modelMats.size();
-        modelMats.push_back({parent->global_transform});
+        newMesh.modelMatID = modelMatID;
+        modelMats.push_back({glm::mat4(1.0f)});
+        modelMatNodes.push_back(nodes[node].transformIndex);
         for(auto& glTFprimitive:glTFmesh.primitives){
-            Primitive* primitive = loadPrimitive(glTFprimitive,modelMatID);
-            newMesh->primitives.push_back(primitive);
+            loadPrimitive(glTFprimitive,modelMatID,jointOffset,weightOffset);
         }
     }
-    return newMesh;
+    return meshHandle;
 }
 
-Primitive* Scene::loadPrimitive(tinygltf::Primitive &glTFprimitive,int modelMatID)
+void Scene::loadPrimitive(glTF::Primitive &glTFprimitive,int modelMatID,int jointOffset,int weightOffset)
 {
     //load all vertices
-    Primitive* newPrimitive = new Primitive();
+    Primitive* newPrimitive = &primitives.push();
     int vertexStart = vertices.size();
     int newVertexCount;
     if(glTFprimitive.attributes.find("POSITION")!=glTFprimitive.attributes.end()){
-        tinygltf::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.attributes["POSITION"]];
-        tinygltf::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
-        tinygltf::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
+        glTF::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.attributes["POSITION"]];
+        glTF::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
+        glTF::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
         newVertexCount = glTFaccessor.count;
         int byteStride = glTFaccessor.ByteStride(glTFbufferView);
         int byteOffset = glTFaccessor.byteOffset + glTFbufferView.byteOffset;
         for(int i=0;i<newVertexCount;++i){
             Vertex newVertex;
             newVertex.modelMatID = modelMatID;
-            newVertex.materialID = glTFprimitive.material;
+            //shaders index materials by descriptor slot
+            newVertex.materialID = glTFprimitive.material>-1?(int)glTFMaterials[glTFprimitive.material].index:-1;
             newVertex.position = glm::make_vec3(reinterpret_cast<float*>(glTFbuffer.data.data()+byteOffset+byteStride*i));
             vertices.push_back(newVertex);
+            newPrimitive->boundsMin = i?glm::min(newPrimitive->boundsMin,newVertex.position):newVertex.position;
+            newPrimitive->boundsMax = i?glm::max(newPrimitive->boundsMax,newVertex.position):newVertex.position;
         }
     }
     else{
@@ -286,9 +774,9 @@ Primitive* Scene::loadPrimitive(tinygltf::Primitive &glTFprimitive,int modelMatI
     }
 
     if(glTFprimitive.attributes.find("NORMAL")!=glTFprimitive.attributes.end()){
-        tinygltf::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.attributes["NORMAL"]];
-        tinygltf::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
-        tinygltf::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
+        glTF::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.attributes["NORMAL"]];
+        glTF::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
+        glTF::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
         newVertexCount = glTFaccessor.count;
         int byteStride = glTFaccessor.ByteStride(glTFbufferView);
         int byteOffset = glTFaccessor.byteOffset + glTFbufferView.byteOffset;
@@ -298,9 +786,9 @@ Primitive* Scene::loadPrimitive(tinygltf::Primitive &glTFprimitive,int modelMatI
     }
 
     if(glTFprimitive.attributes.find("TANGENT")!=glTFprimitive.attributes.end()){
-        tinygltf::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.attributes["TANGENT"]];
-        tinygltf::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
-        tinygltf::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
+        glTF::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.attributes["TANGENT"]];
+        glTF::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
+        glTF::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
         newVertexCount = glTFaccessor.count;
         int byteStride = glTFaccessor.ByteStride(glTFbufferView);
         int byteOffset = glTFaccessor.byteOffset + glTFbufferView.byteOffset;
@@ -310,9 +798,9 @@ Primitive* Scene::loadPrimitive(tinygltf::Primitive &glTFprimitive,int modelMatI
     }
 
     if(glTFprimitive.attributes.find("TEXCOORD_0")!=glTFprimitive.attributes.end()){
-        tinygltf::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.attributes["TEXCOORD_0"]];
-        tinygltf::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
-        tinygltf::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
+        glTF::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.attributes["TEXCOORD_0"]];
+        glTF::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
+        glTF::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
         newVertexCount = glTFaccessor.count;
         int byteStride = glTFaccessor.ByteStride(glTFbufferView);
         int byteOffset = glTFaccessor.byteOffset + glTFbufferView.byteOffset;
@@ -322,9 +810,9 @@ Primitive* Scene::loadPrimitive(tinygltf::Primitive &glTFprimitive,int modelMatI
     }
 
     if(glTFprimitive.attributes.find("TEXCOORD_1")!=glTFprimitive.attributes.end()){
-        tinygltf::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.attributes["TEXCOORD_1"]];
-        tinygltf::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
-        tinygltf::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
+        glTF::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.attributes["TEXCOORD_1"]];
+        glTF::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
+        glTF::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
         newVertexCount = glTFaccessor.count;
         int byteStride = glTFaccessor.ByteStride(glTFbufferView);
         int byteOffset = glTFaccessor.byteOffset + glTFbufferView.byteOffset;
@@ -333,14 +821,88 @@ Primitive* Scene::loadPrimitive(tinygltf::Primitive &glTFprimitive,int modelMatI
         }
     }
 
+    bool skinned = jointOffset>-1&&glTFprimitive.attributes.find("JOINTS_0")!=glTFprimitive.attributes.end()
+    &&glTFprimitive.attributes.find("WEIGHTS_0")!=glTFprimitive.attributes.end();
+    bool morphed = weightOffset>-1&&glTFprimitive.targets.size();
+    if(skinned||morphed){
+        int deformStart = deformVertices.size();
+        for(int i=0;i<newVertexCount;++i){
+            DeformVertex deformVertex;
+            deformVertex.vertexIndex = vertexStart+i;
+            deformVertices.push_back(deformVertex);
+        }
+        if(skinned){
+            glTF::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.attributes["JOINTS_0"]];
+            glTF::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
+            glTF::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
+            int byteStride = glTFaccessor.ByteStride(glTFbufferView);
+            int byteOffset = glTFaccessor.byteOffset + glTFbufferView.byteOffset;
+            std::vector<float> weights;
+            readAccessorFloats(glTFmodel,glTFprimitive.attributes["WEIGHTS_0"],4,weights);
+            for(int i=0;i<newVertexCount;++i){
+                uint32_t joints[4];
+                unsigned char* element = glTFbuffer.data.data()+byteOffset+byteStride*i;
+                for(int j=0;j<4;++j){
+                    if(glTFaccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE){
+                        joints[j] = element[j];
+                    }
+                    else if(glTFaccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT){
+                        joints[j] = reinterpret_cast<unsigned short*>(element)[j];
+                    }
+                    else{
+                        throw std::runtime_error("bad joint index type!");
+                    }
+                    joints[j] += jointOffset;
+                }
+                DeformVertex& deformVertex = deformVertices[deformStart+i];
+                deformVertex.joints = glm::uvec4(joints[0],joints[1],joints[2],joints[3]);
+                deformVertex.weights = glm::make_vec4(weights.data()+4*i);
+            }
+        }
+        if(morphed){
+            //targets are read whole,then only the deltas that move a vertex are kept
+            std::vector<std::vector<float>> positionDeltas(glTFprimitive.targets.size());
+            std::vector<std::vector<float>> normalDeltas(glTFprimitive.targets.size());
+            for(int t=0;t<glTFprimitive.targets.size();++t){
+                auto& target = glTFprimitive.targets[t];
+                if(target.find("POSITION")!=target.end()){
+                    readAccessorFloats(glTFmodel,target["POSITION"],4,positionDeltas[t]);
+                }
+                if(target.find("NORMAL")!=target.end()){
+                    readAccessorFloats(glTFmodel,target["NORMAL"],4,normalDeltas[t]);
+                }
+                positionDeltas[t].resize(newVertexCount*4,0.0f);
+                normalDeltas[t].resize(newVertexCount*4,0.0f);
+            }
+            for(int i=0;i<newVertexCount;++i){
+                DeformVertex& deformVertex = deformVertices[deformStart+i];
+                deformVertex.morphOffset = morphDeltas.size();
+                for(int t=0;t<glTFprimitive.targets.size();++t){
+                    const float* p = positionDeltas[t].data()+4*i;
+                    const float* n = normalDeltas[t].data()+4*i;
+                    if(p[0]==0&&p[1]==0&&p[2]==0&&n[0]==0&&n[1]==0&&n[2]==0){
+                        continue;
+                    }
+                    MorphDelta delta;
+                    delta.weightIndex = weightOffset+t;
+                    delta.positionXY = glm::packHalf2x16(glm::vec2(p[0],p[1]));
+                    delta.positionZNormalX = glm::packHalf2x16(glm::vec2(p[2],n[0]));
+                    delta.normalYZ = glm::packHalf2x16(glm::vec2(n[1],n[2]));
+                    morphDeltas.push_back(delta);
+                }
+                deformVertex.morphCount = morphDeltas.size()-deformVertex.morphOffset;
+            }
+        }
+    }
+
     newPrimitive->vertexStart = vertexStart;
     newPrimitive->verexCount = newVertexCount;
     //load indices if exist
     if(glTFprimitive.indices>-1){
         newPrimitive->useIndex = true;
-        tinygltf::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.indices];
-        tinygltf::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
-        tinygltf::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
+        glTF::Accessor& glTFaccessor = glTFmodel.accessors[glTFprimitive.indices];
+        glTF::BufferView&  glTFbufferView = glTFmodel.bufferViews[glTFaccessor.bufferView];
+        glTF::Buffer& glTFbuffer = glTFmodel.buffers[glTFbufferView.buffer];
         int indexStart = indexs.size();
         int newIndexCount = glTFaccessor.count;
         int byteStride = glTFaccessor.ByteStride(glTFbufferView);
@@ -360,103 +922,113 @@ Primitive* Scene::loadPrimitive(tinygltf::Primitive &glTFprimitive,int modelMatI
         }
         newPrimitive->indexCount = newIndexCount;
         newPrimitive->indexStart = indexStart;
+
+        DrawInstance drawInstance;
+        drawInstance.boundsMin = newPrimitive->boundsMin;
+        drawInstance.boundsMax = newPrimitive->boundsMax;
+        drawInstance.indexStart = indexStart;
+        drawInstance.indexCount = newIndexCount;
+        drawInstance.modelMatID = modelMatID;
+        drawInstance.flags = skinned||morphed?DRAW_INSTANCE_NEVER_CULL:0;
+        drawInstances.push_back(drawInstance);
+        MaterialHandle material = glTFprimitive.material>-1?glTFMaterials[glTFprimitive.material]:MaterialHandle();
+        int materialSlot = glTFprimitive.material>-1?(int)material.index:-1;
+        drawInstanceKeys.push_back((uint64_t)getPipelineVariant(material)<<32|(uint32_t)(materialSlot+1));
+    }
+    if(glTFprimitive.material>-1){
+        newPrimitive->material = glTFMaterials[glTFprimitive.material];
     }
-    newPrimitive->material = materials[glTFprimitive.material];
-    return newPrimitive;
 }
 
-Material* Scene::loadMaterial(tinygltf::Material &glTFmaterial,int index)
+void Scene::loadMaterial(glTF::Material &glTFmaterial,int index)
 {
-    Material* newMaterial = new Material();
-    newMaterial->index = index;
+    MaterialHandle handle = materials.create();
+    if(handle.index>=MAX_MATERIAL_COUNT){
+        throw std::runtime_error("too many materials!");
+    }
+    glTFMaterials[index] = handle;
+    Material* newMaterial = materials.get(handle);
+    newMaterial->index = handle.index;
     newMaterial->properties.basColorFactor = glm::make_vec4(glTFmaterial.pbrMetallicRoughness.baseColorFactor.data());
     newMaterial->properties.emissiveFactor = glm::make_vec3(glTFmaterial.emissiveFactor.data());
     newMaterial->properties.metallicFactor = glTFmaterial.pbrMetallicRoughness.metallicFactor;
     newMaterial->properties.normalScale = glTFmaterial.normalTexture.scale;
     newMaterial->properties.occlusionStength = glTFmaterial.occlusionTexture.strength;
     newMaterial->properties.roughnessFactor = glTFmaterial.pbrMetallicRoughness.roughnessFactor;
+    newMaterial->properties.alphaCutoff = glTFmaterial.alphaCutoff;
+    newMaterial->doubleSided = glTFmaterial.doubleSided;
+    if(glTFmaterial.alphaMode=="MASK"){
+        newMaterial->alphaMode = AlphaMode::eMask;
+    }
+    else if(glTFmaterial.alphaMode=="BLEND"){
+        newMaterial->alphaMode = AlphaMode::eBlend;
+    }
     
     if(glTFmaterial.pbrMetallicRoughness.baseColorTexture.index>-1){
         newMaterial->properties.texCoord_baseColor = glTFmaterial.pbrMetallicRoughness.baseColorTexture.texCoord;
-        newMaterial->baseColorTexture = textures[glTFmaterial.pbrMetallicRoughness.baseColorTexture.index];
+        newMaterial->baseColorTexture = glTFTextures[glTFmaterial.pbrMetallicRoughness.baseColorTexture.index];
         vk::WriteDescriptorSet write;
-        write.setImageInfo(newMaterial->baseColorTexture->desriptorImageInfo);
+        write.setImageInfo(textures.get(newMaterial->baseColorTexture)->desriptorImageInfo);
         write.setDescriptorCount(1);
         write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
         write.setDstBinding(1);
         write.setDstSet(materialDescriptorSet);
-        write.setDstArrayElement(index);
+        write.setDstArrayElement(newMaterial->index);
         renderer->lDevice.updateDescriptorSets(1,&write,0,nullptr);
     }
     if(glTFmaterial.emissiveTexture.index>-1){
         newMaterial->properties.texCoord_emissive = glTFmaterial.emissiveTexture.texCoord;
-        newMaterial->emissiveTexture = textures[glTFmaterial.emissiveTexture.index];
+        newMaterial->emissiveTexture = glTFTextures[glTFmaterial.emissiveTexture.index];
         vk::WriteDescriptorSet write;
-        write.setImageInfo(newMaterial->emissiveTexture->desriptorImageInfo);
+        write.setImageInfo(textures.get(newMaterial->emissiveTexture)->desriptorImageInfo);
         write.setDescriptorCount(1);
         write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
         write.setDstBinding(2);
         write.setDstSet(materialDescriptorSet);
-        write.setDstArrayElement(index);
+        write.setDstArrayElement(newMaterial->index);
         renderer->lDevice.updateDescriptorSets(1,&write,0,nullptr);
     }
     if(glTFmaterial.pbrMetallicRoughness.metallicRoughnessTexture.index>-1){
         newMaterial->properties.texCoord_metallicRoughness = glTFmaterial.pbrMetallicRoughness.metallicRoughnessTexture.texCoord;
-        newMaterial->metallicRoughnessTexture = textures[glTFmaterial.pbrMetallicRoughness.metallicRoughnessTexture.index];
+        newMaterial->metallicRoughnessTexture = glTFTextures[glTFmaterial.pbrMetallicRoughness.metallicRoughnessTexture.index];
         vk::WriteDescriptorSet write;
-        write.setImageInfo(newMaterial->metallicRoughnessTexture->desriptorImageInfo);
+        write.setImageInfo(textures.get(newMaterial->metallicRoughnessTexture)->desriptorImageInfo);
         write.setDescriptorCount(1);
         write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
         write.setDstBinding(3);
         write.setDstSet(materialDescriptorSet);
-        write.setDstArrayElement(index);
+        write.setDstArrayElement(newMaterial->index);
         renderer->lDevice.updateDescriptorSets(1,&write,0,nullptr);
     }
     if(glTFmaterial.normalTexture.index>-1){
         newMaterial->properties.texCoord_normal = glTFmaterial.normalTexture.texCoord;
-        newMaterial->normalTexture = textures[glTFmaterial.normalTexture.index];
+        newMaterial->normalTexture = glTFTextures[glTFmaterial.normalTexture.index];
         vk::WriteDescriptorSet write;
-        write.setImageInfo(newMaterial->normalTexture->desriptorImageInfo);
+        write.setImageInfo(textures.get(newMaterial->normalTexture)->desriptorImageInfo);
         write.setDescriptorCount(1);
         write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
         write.setDstBinding(4);
         write.setDstSet(materialDescriptorSet);
-        write.setDstArrayElement(index);
+        write.setDstArrayElement(newMaterial->index);
         renderer->lDevice.updateDescriptorSets(1,&write,0,nullptr);
     }
     if(glTFmaterial.occlusionTexture.index>-1){
         newMaterial->properties.texCoord_occlusion = glTFmaterial.occlusionTexture.texCoord;
-        newMaterial->occlusionTexture = textures[glTFmaterial.occlusionTexture.index];
+        newMaterial->occlusionTexture = glTFTextures[glTFmaterial.occlusionTexture.index];
         vk::WriteDescriptorSet write;
-        write.setImageInfo(newMaterial->occlusionTexture->desriptorImageInfo);
+        write.setImageInfo(textures.get(newMaterial->occlusionTexture)->desriptorImageInfo);
         write.setDescriptorCount(1);
         write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
         write.setDstBinding(5);
         write.setDstSet(materialDescriptorSet);
-        write.setDstArrayElement(index);
+        write.setDstArrayElement(newMaterial->index);
         renderer->lDevice.updateDescriptorSets(1,&write,0,nullptr);
     }
 
     int size = sizeof(MaterialProperties);
     renderer->createBuffer(newMaterial->uniformMaterialBuffer,newMaterial->uniformMaterialBufferMemory,size,
     vk::BufferUsageFlagBits::eUniformBuffer|vk::BufferUsageFlagBits::eTransferDst,vk::MemoryPropertyFlagBits::eDeviceLocal);
-    vk::Buffer stagingBuffer;
-    vk::DeviceMemory stagingMemory;
-    renderer->createBuffer(stagingBuffer,stagingMemory,size,
-    vk::BufferUsageFlagBits::eTransferSrc,vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
-    void* data = renderer->lDevice.mapMemory(stagingMemory,0,size);
-    memcpy(data,&newMaterial->properties,size);
-    vk::CommandBuffer cb = renderer->startOneShotCommandBuffer(renderer->graphicCommandPool);
-    vk::BufferCopy region;
-    region.setSize(size);
-    region.setSrcOffset(0);
-    region.setDstOffset(0);
-    cb.copyBuffer(stagingBuffer,newMaterial->uniformMaterialBuffer,region);
-    renderer->finishOneShotCommandBuffer(renderer->graphicCommandPool,cb,renderer->graphicQueue);
-    renderer->lDevice.waitIdle();
-    renderer->lDevice.unmapMemory(stagingMemory);
-    renderer->lDevice.destroyBuffer(stagingBuffer);
-    renderer->lDevice.freeMemory(stagingMemory);
+    uploadMaterialProperties(*newMaterial);
     newMaterial->descriptorBufferInfo.setBuffer(newMaterial->uniformMaterialBuffer);
     newMaterial->descriptorBufferInfo.setOffset(0);
     newMaterial->descriptorBufferInfo.setRange(size);
@@ -467,19 +1039,82 @@ Material* Scene::loadMaterial(tinygltf::Material &glTFmaterial,int index)
         write.setDescriptorType(vk::DescriptorType::eUniformBuffer);
         write.setDstBinding(0);
         write.setDstSet(materialDescriptorSet);
-        write.setDstArrayElement(index);
+        write.setDstArrayElement(newMaterial->index);
         renderer->lDevice.updateDescriptorSets(1,&write,0,nullptr);
     }
+}
 
-    return newMaterial;
+uint32_t Scene::getPipelineVariant(MaterialHandle handle)
+{
+    //glTF's default material is opaque and single sided
+    Material* material = materials.get(handle);
+    if(!material){
+        return 0;
+    }
+    uint32_t variant = material->doubleSided?PIPELINE_VARIANT_DOUBLE_SIDED:0;
+    if(material->baseColorTexture.valid()){
+        variant |= PIPELINE_VARIANT_BASE_COLOR_TEXTURE;
+    }
+    variant |= (uint32_t)material->alphaMode<<PIPELINE_VARIANT_ALPHA_SHIFT;
+    return variant;
 }
 
-Texture* Scene::loadTexture(tinygltf::Texture &glTFtexture,int index)
+void Scene::buildDrawBuckets()
 {
-    Texture* newTexture = new Texture();
-    newTexture->index = index;
+    std::vector<uint32_t> order(drawInstances.size());
+    for(uint32_t i=0;i<order.size();++i){
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(),order.end(),[&](uint32_t a,uint32_t b){
+        return drawInstanceKeys[a]<drawInstanceKeys[b];
+    });
+    std::vector<DrawInstance> sorted(drawInstances.size());
+    drawBuckets.clear();
+    for(uint32_t i=0;i<order.size();++i){
+        uint32_t variant = (uint32_t)(drawInstanceKeys[order[i]]>>32);
+        if(drawBuckets.empty()||drawBuckets.back().pipelineVariant!=variant){
+            DrawBucket bucket;
+            bucket.pipelineVariant = variant;
+            bucket.firstInstance = i;
+            drawBuckets.push_back(bucket);
+        }
+        DrawBucket& bucket = drawBuckets.back();
+        ++bucket.instanceCount;
+        sorted[i] = drawInstances[order[i]];
+        sorted[i].bucket = drawBuckets.size()-1;
+        sorted[i].bucketStart = bucket.firstInstance;
+    }
+    drawInstances.swap(sorted);
+    std::vector<uint64_t>().swap(drawInstanceKeys);
+}
 
-    tinygltf::Image& glTFimage = glTFmodel.images[glTFtexture.source];
+void Scene::uploadMaterialProperties(Material& material)
+{
+    int size = sizeof(MaterialProperties);
+    vk::Buffer stagingBuffer;
+    GpuAllocation stagingMemory;
+    renderer->createBuffer(stagingBuffer,stagingMemory,size,
+    vk::BufferUsageFlagBits::eTransferSrc,vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
+    void* data = stagingMemory.mapped;
+    memcpy(data,&material.properties,size);
+    vk::CommandBuffer cb = renderer->startOneShotCommandBuffer(renderer->graphicCommandPool);
+    vk::BufferCopy region;
+    region.setSize(size);
+    region.setSrcOffset(0);
+    region.setDstOffset(0);
+    cb.copyBuffer(stagingBuffer,material.uniformMaterialBuffer,region);
+    renderer->finishOneShotCommandBuffer(renderer->graphicCommandPool,cb,renderer->graphicQueue);
+    renderer->destroyBuffer(stagingBuffer,stagingMemory);
+}
+
+void Scene::loadTexture(glTF::Texture &glTFtexture,int index)
+{
+    TextureHandle handle = textures.create();
+    glTFTextures[index] = handle;
+    Texture* newTexture = textures.get(handle);
+    newTexture->index = handle.index;
+
+    glTF::Image& glTFimage = glTFmodel.images[glTFtexture.source];
     int width = glTFimage.width;
     int height = glTFimage.height;
     newTexture->width = width;
@@ -509,11 +1144,11 @@ Texture* Scene::loadTexture(tinygltf::Texture &glTFtexture,int index)
     vk::ImageUsageFlagBits::eTransferDst|vk::ImageUsageFlagBits::eSampled,vk::MemoryPropertyFlagBits::eDeviceLocal);
 
     vk::Buffer stagingBuffer;
-    vk::DeviceMemory stagingMemory;
+    GpuAllocation stagingMemory;
 
     renderer->createBuffer(stagingBuffer,stagingMemory,pixelCount*4,vk::BufferUsageFlagBits::eTransferSrc,vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
 
-    void* data = renderer->lDevice.mapMemory(stagingMemory,0,pixelCount*4);
+    void* data = stagingMemory.mapped;
     memcpy(data,buffer,pixelCount*4);
 
     vk::CommandBuffer cb = renderer->startOneShotCommandBuffer(renderer->graphicCommandPool);
@@ -558,22 +1193,6 @@ Texture* Scene::loadTexture(tinygltf::Texture &glTFtexture,int index)
     newTexture->desriptorImageInfo.setImageView(newTexture->textureImageView);
     newTexture->desriptorImageInfo.setSampler(newTexture->imageSampler);
 
-    renderer->lDevice.unmapMemory(stagingMemory);
-    renderer->lDevice.destroyBuffer(stagingBuffer);
-    renderer->lDevice.freeMemory(stagingMemory);
-    return newTexture;
-}
-Mesh::~Mesh()
-{
-    for(int i=0;i<primitives.size();++i){
-        delete primitives[i];
-    }
-}
-Node::~Node()
-{
-    delete mesh;
-    for(int i=0;i<children.size();++i){
-        delete children[i];
-    }
+    renderer->destroyBuffer(stagingBuffer,stagingMemory);
 }
 }